@@ -0,0 +1,133 @@
+"""
+BUILD REPORT
+
+PlatformIO post-build script. Prints how much of the ESP32's
+instruction RAM the firmware uses and which of our functions
+live there, so IRAM placement can be kept within budget. Then
+breaks our own static RAM and flash down by subsystem, so the
+heap left for the Bluetooth stack can be kept in view.
+"""
+
+import re
+import subprocess
+
+Import("env")
+
+# IRAM0 segment from the ESP-IDF linker script
+IRAM_START = 0x40080000
+IRAM_SIZE = 0x20000
+
+# Data RAM (.data and .bss), and flash mapped for rodata and code
+DRAM_START, DRAM_END = 0x3FFAE000, 0x40000000
+DROM_START, DROM_END = 0x3F400000, 0x3F800000
+IROM_START, IROM_END = 0x400C2000, 0x40C00000
+
+# First match wins. Patterns are searched in the demangled name,
+# so template instances and member functions match too.
+SUBSYSTEMS = [
+    ("boot", r"\b(boot_|Boot_|checkpoint|Checkpoint|Warm_|warm_state|reset_names|Init_Task|init_done|heap_after_setup|setup\(|Soft_Start|soft_start|servo_start_order|joints_attached|joint_attach_ms)"),
+    ("joints", r"\b(servo_pwm|Servo_|servo_class_names|servo_source_names|servo_pins|joint_cmd|joint_out|joints|Joint|Commit_Joints|s_(rs|rb|ls|lb|w|rh|rf|lh|lf)\b)"),
+    ("params", r"\b(params|default_params|param_defs|Params|Param_|Load_Params|Save_Params|Apply_Params|Find_Param|Print_Param|prefs)"),
+    ("battery", r"\b(battery_mon|Battery_|Sample_Battery)"),
+    ("display", r"\b(lcd|display_busy|Waiting_To_Pair|hud_|Hud_)"),
+    ("leds", r"\b(leds|Led_|Glow_|\w+_Led\b)"),
+    ("combos", r"\b(combo|Combo|Compile_Combos|Start_Combo|Run_Combo)"),
+    ("recorder", r"\b(recorder_|Recorder_|Record_Tick|Play_Recording|Toggle_Recording|Toggle_Playback|Pack_Buttons|Motion_Log)"),
+    ("deadlines", r"\b(deadlines|Deadline_|safe_|Safe_|Enter_Safe_Pose|last_input|tick_last_us)"),
+    ("balance", r"\b(balance\b|Balance_|bal_sin_lut|Bal_)"),
+    ("sticks", r"\b(shaper|Shape_Sticks|Stick_|Report_Sticks)"),
+    ("link", r"\b(link_|Link_|On_Connect|On_Disconnect|Pairing_Step)"),
+    ("telemetry", r"\b(telemetry|Telemetry_|Send_Telemetry|Send_Profile|profile|Profile_|Cobs_|notify_us|loop_us)"),
+    ("trace", r"\b(trace_|Trace_)"),
+    ("packs", r"\b(motion_pack|Motion_Pack|pack_active|pack_start|Pack_|Load_Motion_Pack|Run_Pack_Move|Report_Pack|In_Use_Pack)"),
+    ("dispatch", r"\b(dispatch\b|Dispatch_|Compile_Dispatch|Run_Action|Restart_Action|Adjust_Timeouts|Bindable|Bind_|Parse_Bind|Report_Binds|stick_rules)"),
+    ("bench", r"\b(bench\b|bench_|Bench_|Run_Bench)"),
+    ("console", r"\b(console_|Console_|Poll_Console|Report_)"),
+    ("control", r"\b(control_lock|control_task|control_rate|Control_|rate_|Rate_|notify\(|loop\(|action\b|timers|crouched)"),
+    ("gaits", r"\b(Gait_|Run_Gait|Turn_Gait|Sidestep_Gait)"),
+    ("actions", r"."),
+]
+
+
+def tool(name):
+    size_tool = env.subst("$SIZETOOL")
+    return size_tool[: -len("size")] + name
+
+
+def symbols(elf):
+    """Yield (address, size, type, name) for every sized symbol."""
+    out = subprocess.run(
+        [tool("nm"), "-S", "-C", "--size-sort", elf],
+        capture_output=True, text=True, check=True
+    ).stdout
+    for line in out.splitlines():
+        parts = line.split(None, 3)
+        if len(parts) == 4:
+            yield int(parts[0], 16), int(parts[1], 16), parts[2], parts[3]
+
+
+def iram_report(source, target, env):
+    elf = str(target[0])
+    in_iram = [
+        (size, name) for addr, size, _, name in symbols(elf)
+        if IRAM_START <= addr < IRAM_START + IRAM_SIZE
+    ]
+    used = sum(size for size, _ in in_iram)
+
+    # Our own control path, as opposed to SDK and BT stack code
+    main_syms = subprocess.run(
+        [tool("nm"), "-C", "--defined-only", env.subst("$BUILD_DIR/src/main.cpp.o")],
+        capture_output=True, text=True
+    ).stdout
+    ours = {line.split(None, 2)[-1] for line in main_syms.splitlines() if line.strip()}
+    control = sorted(((size, name) for size, name in in_iram if name in ours), reverse=True)
+
+    print("")
+    print("IRAM: %d / %d bytes used (%.1f%%), %d bytes free" % (used, IRAM_SIZE, 100.0 * used / IRAM_SIZE, IRAM_SIZE - used))
+    print("Control path in IRAM: %d bytes in %d functions" % (sum(s for s, _ in control), len(control)))
+    for size, name in control:
+        print("  %6d  %s" % (size, name))
+
+
+def subsystem_report(source, target, env):
+    elf = str(target[0])
+
+    main_syms = subprocess.run(
+        [tool("nm"), "-C", "--defined-only", env.subst("$BUILD_DIR/src/main.cpp.o")],
+        capture_output=True, text=True
+    ).stdout
+    ours = {line.split(None, 2)[-1] for line in main_syms.splitlines() if line.strip()}
+
+    rules = [(name, re.compile(pattern)) for name, pattern in SUBSYSTEMS]
+    totals = {name: [0, 0, 0] for name, _ in SUBSYSTEMS}
+    dram_used = 0
+    for addr, size, _, name in symbols(elf):
+        in_dram = DRAM_START <= addr < DRAM_END
+        if in_dram:
+            dram_used += size
+        if name not in ours:
+            continue
+        column = (0 if in_dram
+                  else 1 if IRAM_START <= addr < IRAM_START + IRAM_SIZE
+                  else 2 if DROM_START <= addr < DROM_END or IROM_START <= addr < IROM_END
+                  else None)
+        if column is None:
+            continue
+        subsystem = next(n for n, rule in rules if rule.search(name))
+        totals[subsystem][column] += size
+
+    print("")
+    print("Static RAM and flash by subsystem (bytes):")
+    print("  %-10s %8s %8s %8s" % ("", "DRAM", "IRAM", "flash"))
+    for name, _ in SUBSYSTEMS:
+        dram, iram, flash = totals[name]
+        if dram or iram or flash:
+            print("  %-10s %8d %8d %8d" % (name, dram, iram, flash))
+    ours_dram = sum(t[0] for t in totals.values())
+    print("  %-10s %8d %8d %8d" % ("total", ours_dram, sum(t[1] for t in totals.values()), sum(t[2] for t in totals.values())))
+    print("DRAM: %d bytes static in all, %d of them ours. Check the runtime" % (dram_used, ours_dram))
+    print("heap low-water with the 'memory' console command.")
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", iram_report)
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", subsystem_report)
@@ -0,0 +1,60 @@
+#ifndef ACTIONS_H
+#define ACTIONS_H
+
+/*
+  ACTION IDS
+
+  Shared between the firmware and the host tools so that
+  logged action ids decode to the same names on both sides.
+*/
+
+enum Action {
+  ACT_IDLE,
+  ACT_FORWARD,
+  ACT_BACKWARD,
+  ACT_LEFT,
+  ACT_RIGHT,
+  ACT_SIDESTEP_LEFT,
+  ACT_SIDESTEP_RIGHT,
+  ACT_RIGHT_SWEEP,
+  ACT_LEFT_SWEEP,
+  ACT_RIGHT_HOOK,
+  ACT_LEFT_HOOK,
+  ACT_RIGHT_SHOT,
+  ACT_LEFT_SHOT,
+  ACT_WARMING_UP,
+  ACT_BEHOLD,
+  ACT_DUST_OFF,
+  ACT_GIVE_IT_YOUR_ALL,
+  ACT_BACK_RECOVERY,
+  ACT_FRONT_RECOVERY,
+  ACT_SAFE_POSE,
+  ACT_PACK_MOVE,
+  ACT_COUNT
+};
+
+static const char* const action_names[ACT_COUNT] = {
+  "Idle",
+  "Forward",
+  "Backward",
+  "Left",
+  "Right",
+  "Sidestep_Left",
+  "Sidestep_Right",
+  "Right_Sweep",
+  "Left_Sweep",
+  "Right_Hook",
+  "Left_Hook",
+  "Right_Shot",
+  "Left_Shot",
+  "WARMING_UP",
+  "BEHOLD",
+  "DUST_OFF",
+  "GIVE_IT_YOUR_ALL",
+  "Back_Recovery",
+  "Front_Recovery",
+  "Safe_Pose",
+  "Pack_Move"
+};
+
+#endif
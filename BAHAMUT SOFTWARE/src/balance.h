@@ -0,0 +1,189 @@
+#ifndef BALANCE_H
+#define BALANCE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <gait.h>
+
+/*
+  BALANCE
+
+  Fixed-point forward kinematics of the body, just enough to put
+  the center of mass over the ground. Every angle is taken as an
+  offset from a reference pose (the standing pose), written so
+  that positive is forward, outward or to the left per side:
+
+    lean    mean of both feet, rolls the legs and shifts the
+            pelvis sideways, positive to the left.
+    pitch   the feet's lift less the hips' take-up, tips the
+            torso forward. Hips and feet moving together
+            (crouch, gaucho) keep the torso upright.
+    yaw     waist, turns the torso and arms.
+    arms    shoulder pitch from hanging straight down, elbow
+            bend on top of it, in the sagittal plane.
+
+  Positions are 1/16 mm, trig is a quarter-wave sine table in
+  Q14 indexed by whole degrees, so a full estimate is a handful
+  of table lookups and integer multiplies.
+
+  The support polygon is the box around both foot pads. The
+  geometry and masses below are estimates from the build and
+  are meant to be refined by weighing and measuring the robot.
+
+  Shared with the host tools.
+*/
+
+#define BAL_Q 14
+#define BAL_MM 16                 // position units per mm
+
+// Geometry, mm
+#define BAL_FOOT_SPAN 90          // between foot centers
+#define BAL_FOOT_LENGTH 50
+#define BAL_FOOT_WIDTH 30
+#define BAL_LEG 70                // foot to pelvis
+#define BAL_TORSO_COM 30          // pelvis to torso center of mass
+#define BAL_SHOULDER_HEIGHT 70    // pelvis to shoulders
+#define BAL_SHOULDER_HALF 40      // body center to each shoulder
+#define BAL_UPPER_ARM 40
+#define BAL_FOREARM 50
+
+// Masses, g
+#define BAL_M_LEG 55
+#define BAL_M_TORSO 200
+#define BAL_M_UPPER_ARM 20
+#define BAL_M_FOREARM 25
+#define BAL_M_TOTAL (2 * BAL_M_LEG + BAL_M_TORSO + 2 * (BAL_M_UPPER_ARM + BAL_M_FOREARM))
+
+// sin(0..90 deg) in Q14
+static const int16_t bal_sin_lut[91] = {
+  0, 286, 572, 857, 1143, 1428, 1713, 1997, 2280, 2563,
+  2845, 3126, 3406, 3686, 3964, 4240, 4516, 4790, 5063, 5334,
+  5604, 5872, 6138, 6402, 6664, 6924, 7182, 7438, 7692, 7943,
+  8192, 8438, 8682, 8923, 9162, 9397, 9630, 9860, 10087, 10311,
+  10531, 10749, 10963, 11174, 11381, 11585, 11786, 11982, 12176, 12365,
+  12551, 12733, 12911, 13085, 13255, 13421, 13583, 13741, 13894, 14044,
+  14189, 14330, 14466, 14598, 14726, 14849, 14968, 15082, 15191, 15296,
+  15396, 15491, 15582, 15668, 15749, 15826, 15897, 15964, 16026, 16083,
+  16135, 16182, 16225, 16262, 16294, 16322, 16344, 16362, 16374, 16382,
+  16384
+};
+
+/**
+ * @brief Ground projection of the center of mass, 1/16 mm.
+ *
+ * x forward, y to the left, from the middle of the feet.
+*/
+struct Bal_Point {
+  int32_t x;
+  int32_t y;
+};
+
+/**
+ * @brief sin of a whole number of degrees, Q14.
+*/
+static inline int32_t Bal_Sin(int deg) {
+  deg %= 360;
+  if (deg < 0) deg += 360;
+  if (deg <= 90) return bal_sin_lut[deg];
+  if (deg <= 180) return bal_sin_lut[180 - deg];
+  if (deg <= 270) return -bal_sin_lut[deg - 180];
+  return -bal_sin_lut[360 - deg];
+}
+
+/**
+ * @brief cos of a whole number of degrees, Q14.
+*/
+static inline int32_t Bal_Cos(int deg) {
+  return Bal_Sin(deg + 90);
+}
+
+/**
+ * @brief Scale a length by a Q14 ratio.
+*/
+static inline int32_t Bal_Mul(int32_t len, int32_t q) {
+  return (int32_t)(((int64_t)len * q) >> BAL_Q);
+}
+
+/**
+ * @brief Add one arm's moments in the torso frame.
+ *
+ * @param side +1 left, -1 right.
+ * @param shoulder pitch from hanging down, positive forward.
+ * @param elbow bend on top of the shoulder, positive forward.
+ * @param mx, my, mz sums of mass times position.
+*/
+static inline void Bal_Arm(int side, int shoulder, int elbow, int32_t& mx, int32_t& my, int32_t& mz) {
+  int32_t sy = side * BAL_SHOULDER_HALF * BAL_MM;
+  int32_t sz = BAL_SHOULDER_HEIGHT * BAL_MM;
+  int32_t ux = Bal_Sin(shoulder);
+  int32_t uz = -Bal_Cos(shoulder);
+  int32_t fx = Bal_Sin(shoulder + elbow);
+  int32_t fz = -Bal_Cos(shoulder + elbow);
+
+  int32_t upper = BAL_UPPER_ARM * BAL_MM;
+  int32_t fore = BAL_FOREARM * BAL_MM;
+
+  // Upper arm and forearm centers, halfway along each
+  int32_t ax = Bal_Mul(upper / 2, ux);
+  int32_t az = sz + Bal_Mul(upper / 2, uz);
+  int32_t bx = Bal_Mul(upper, ux) + Bal_Mul(fore / 2, fx);
+  int32_t bz = sz + Bal_Mul(upper, uz) + Bal_Mul(fore / 2, fz);
+
+  mx += BAL_M_UPPER_ARM * ax + BAL_M_FOREARM * bx;
+  my += (BAL_M_UPPER_ARM + BAL_M_FOREARM) * sy;
+  mz += BAL_M_UPPER_ARM * az + BAL_M_FOREARM * bz;
+}
+
+/**
+ * @brief Center of mass of a pose.
+ *
+ * @param pose 9 joint angles.
+ * @param ref reference pose the model is measured from.
+*/
+static inline Bal_Point Balance_Com(const int16_t* pose, const int* ref) {
+  int d[GAIT_JOINTS];
+  for (int j = 0; j < GAIT_JOINTS; j++) d[j] = pose[j] - ref[j];
+
+  int lean = (d[GAIT_LF] + d[GAIT_RF]) / 2;
+  int pitch = (d[GAIT_RF] - d[GAIT_LF]) / 2 - (d[GAIT_RH] - d[GAIT_LH]) / 2;
+  int yaw = d[GAIT_W];
+
+  // Upper body in the torso frame, relative to the pelvis
+  int32_t mx = 0;
+  int32_t my = 0;
+  int32_t mz = BAL_M_TORSO * BAL_TORSO_COM * BAL_MM;
+  Bal_Arm(-1, d[GAIT_RS], -d[GAIT_RB], mx, my, mz);
+  Bal_Arm(+1, -d[GAIT_LS], d[GAIT_LB], mx, my, mz);
+
+  // Waist, then the torso's pitch
+  int32_t c = Bal_Cos(yaw);
+  int32_t s = Bal_Sin(yaw);
+  int32_t tx = Bal_Mul(mx, c) - Bal_Mul(my, s);
+  int32_t ty = Bal_Mul(mx, s) + Bal_Mul(my, c);
+  tx = Bal_Mul(tx, Bal_Cos(pitch)) + Bal_Mul(mz, Bal_Sin(pitch));
+
+  // Pelvis shift, the legs' centers move half as far
+  const int32_t upper = BAL_M_TORSO + 2 * (BAL_M_UPPER_ARM + BAL_M_FOREARM);
+  int32_t pelvis = Bal_Mul(BAL_LEG * BAL_MM, Bal_Sin(lean));
+
+  Bal_Point com;
+  com.x = tx / BAL_M_TOTAL;
+  com.y = (ty + (upper + BAL_M_LEG) * pelvis) / BAL_M_TOTAL;
+  return com;
+}
+
+/**
+ * @brief How far a center of mass is outside the support polygon.
+ *
+ * @param margin keep-out band inside the edge, mm.
+ * @return distance outside in 1/16 mm, summed over both axes, 0 inside.
+*/
+static inline int32_t Balance_Excess(Bal_Point com, int margin) {
+  int32_t hx = (BAL_FOOT_LENGTH / 2 - margin) * BAL_MM;
+  int32_t hy = (BAL_FOOT_SPAN / 2 + BAL_FOOT_WIDTH / 2 - margin) * BAL_MM;
+  int32_t ex = abs(com.x) - hx;
+  int32_t ey = abs(com.y) - hy;
+  return (ex > 0 ? ex : 0) + (ey > 0 ? ey : 0);
+}
+
+#endif
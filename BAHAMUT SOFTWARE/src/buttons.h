@@ -0,0 +1,39 @@
+#ifndef BUTTONS_H
+#define BUTTONS_H
+
+/*
+  PACKED BUTTON BITS
+
+  One bit per PS3 button, used wherever button state is
+  stored or compared as a single integer.
+*/
+
+#define BTN_SELECT   (1UL << 0)
+#define BTN_L3       (1UL << 1)
+#define BTN_R3       (1UL << 2)
+#define BTN_START    (1UL << 3)
+#define BTN_UP       (1UL << 4)
+#define BTN_RIGHT    (1UL << 5)
+#define BTN_DOWN     (1UL << 6)
+#define BTN_LEFT     (1UL << 7)
+#define BTN_L2       (1UL << 8)
+#define BTN_R2       (1UL << 9)
+#define BTN_L1       (1UL << 10)
+#define BTN_R1       (1UL << 11)
+#define BTN_TRIANGLE (1UL << 12)
+#define BTN_CIRCLE   (1UL << 13)
+#define BTN_CROSS    (1UL << 14)
+#define BTN_SQUARE   (1UL << 15)
+#define BTN_PS       (1UL << 16)
+
+#define BTN_COUNT 17
+
+static const char* const button_names[BTN_COUNT] = {
+  "select", "l3", "r3", "start",
+  "up", "right", "down", "left",
+  "l2", "r2", "l1", "r1",
+  "triangle", "circle", "cross", "square",
+  "ps"
+};
+
+#endif
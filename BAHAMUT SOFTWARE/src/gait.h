@@ -0,0 +1,154 @@
+#ifndef GAIT_H
+#define GAIT_H
+
+#include <stdint.h>
+
+/*
+  GAIT SHAPES
+
+  Every locomotion gait is a two beat pattern on top of a base
+  pose: for the first split % of each period one set of joint
+  offsets is held, for the rest of the period another. A gait is
+  therefore fully described by its period, its split and the two
+  offset rows, which the firmware evaluates against the live pose
+  tables and the host gait optimizer evaluates against its body
+  model, so both run the exact same motion.
+
+  Offsets are written from the right side's point of view.
+  Gait_Pose<true>() runs the left side's version, remapping each
+  joint to its counterpart and flipping every offset at compile
+  time, the same as Side<true> does for the attacks.
+
+  Shared with the host tools.
+*/
+
+// Joint indices, same order as the servo tables
+enum Gait_Joint {
+  GAIT_RS, GAIT_RB,
+  GAIT_LS, GAIT_LB,
+  GAIT_W,
+  GAIT_RH, GAIT_RF,
+  GAIT_LH, GAIT_LF,
+  GAIT_JOINTS
+};
+
+// Default pose tables
+#define GAIT_STD_POSE    { 20, 145, 160, 35, 95, 60, 40, 130, 130 }
+#define GAIT_GAUCHO_POSE { 20, 145, 160, 35, 95, 80, 60, 100, 100 }
+#define GAIT_CROUCH_POSE { 20, 145, 160, 35, 95, 135, 115, 45, 45 }
+
+/**
+ * @brief One gait cycle.
+ *
+ * period in ms, split is the first beat's share of the period
+ * in %, offset[beat][joint] in degrees from the base pose.
+*/
+struct Gait_Shape {
+  uint16_t period;
+  uint8_t split;
+  int8_t offset[2][GAIT_JOINTS];
+};
+
+/**
+ * @brief Counterpart of a joint on the other side, the waist is its own.
+*/
+static constexpr int Gait_Mirror_Joint(int j) {
+  return (j == GAIT_RS) ? GAIT_LS : (j == GAIT_LS) ? GAIT_RS :
+         (j == GAIT_RB) ? GAIT_LB : (j == GAIT_LB) ? GAIT_RB :
+         (j == GAIT_RH) ? GAIT_LH : (j == GAIT_LH) ? GAIT_RH :
+         (j == GAIT_RF) ? GAIT_LF : (j == GAIT_LF) ? GAIT_RF : j;
+}
+
+/**
+ * @brief Empty gait, both beats hold the base pose.
+*/
+static inline Gait_Shape Gait_Blank(int period, int split) {
+  Gait_Shape g;
+  g.period = period > 1 ? period : 1;
+  g.split = split;
+  for (int b = 0; b < 2; b++) {
+    for (int j = 0; j < GAIT_JOINTS; j++) g.offset[b][j] = 0;
+  }
+  return g;
+}
+
+/**
+ * @brief Walk, shifting mass with the feet and stepping with the waist.
+ *
+ * First beat shifts the center of mass left and rotates the waist
+ * left, second beat the same to the right. Turning the waist
+ * towards the loaded foot walks forward, away from it backward.
+ *
+ * @param dir +1 forward, -1 backward.
+*/
+static inline Gait_Shape Gait_Walk(int period, int split, int foot, int waist, int dir) {
+  Gait_Shape g = Gait_Blank(period, split);
+  g.offset[0][GAIT_LF] = +foot;
+  g.offset[0][GAIT_RF] = +foot;
+  g.offset[0][GAIT_W] = +waist * dir;
+  g.offset[1][GAIT_LF] = -foot;
+  g.offset[1][GAIT_RF] = -foot;
+  g.offset[1][GAIT_W] = -waist * dir;
+  return g;
+}
+
+/**
+ * @brief Turn right in place.
+ *
+ * First beat raises the body via the feet and returns the waist,
+ * second beat lowers the body while turning the waist right.
+*/
+static inline Gait_Shape Gait_Turn(int period, int split, int lift, int waist) {
+  Gait_Shape g = Gait_Blank(period, split);
+  g.offset[0][GAIT_LF] = -lift;
+  g.offset[0][GAIT_RF] = +lift;
+  g.offset[1][GAIT_W] = -waist;
+  return g;
+}
+
+/**
+ * @brief Sidestep right.
+ *
+ * First beat thrusts with the left hip and foot while the right
+ * ones reach out to catch the body, second beat resets.
+*/
+static inline Gait_Shape Gait_Sidestep(int period, int split, int reach) {
+  Gait_Shape g = Gait_Blank(period, split);
+  g.offset[0][GAIT_LH] = -reach;
+  g.offset[0][GAIT_LF] = +reach;
+  g.offset[0][GAIT_RH] = +reach;
+  g.offset[0][GAIT_RF] = +reach;
+  return g;
+}
+
+/**
+ * @brief Beat running at time t.
+ *
+ * @param t_ms any free running ms clock.
+ * @return 0 for the first beat, 1 for the second.
+*/
+static inline int Gait_Beat(const Gait_Shape& g, uint32_t t_ms) {
+  uint32_t delta = t_ms % g.period;
+  return delta < (uint32_t)g.period * g.split / 100 ? 0 : 1;
+}
+
+/**
+ * @brief Joint targets of a gait at time t.
+ *
+ * MIRRORED performs the gait towards the left. The joint and sign
+ * remap is resolved at compile time, the gait itself is the same
+ * runtime shape either way.
+ *
+ * @param base pose the offsets apply to.
+ * @param out 9 target angles.
+*/
+template <bool MIRRORED = false>
+static inline void Gait_Pose(const Gait_Shape& g, const int* base, uint32_t t_ms, int* out) {
+  const int8_t* row = g.offset[Gait_Beat(g, t_ms)];
+  for (int j = 0; j < GAIT_JOINTS; j++) {
+    int m = MIRRORED ? Gait_Mirror_Joint(j) : j;
+    out[m] = base[m] + (MIRRORED ? -row[j] : row[j]);
+  }
+}
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef GAIT_TABLES_H
+#define GAIT_TABLES_H
+
+/*
+  GAIT TABLES
+
+  Hand-tuned values, scored on the body model by
+  tools/gait_opt.cpp --baseline. A search run rewrites them.
+
+  Model rates:
+    walk         82.3 mm/s,   28.8 mm per cycle
+    turn        103.7 deg/s,   36.3 deg per cycle
+    sidestep  not modelled
+*/
+
+#define GAIT_WALK_PERIOD 350
+#define GAIT_WALK_SPLIT 50
+#define GAIT_WALK_FOOT 25
+#define GAIT_WALK_WAIST 45
+
+#define GAIT_TURN_PERIOD 350
+#define GAIT_TURN_SPLIT 50
+#define GAIT_TURN_LIFT 20
+#define GAIT_TURN_WAIST 80
+
+#define GAIT_SIDESTEP_PERIOD 250
+#define GAIT_SIDESTEP_SPLIT 50
+#define GAIT_SIDESTEP_REACH 20
+
+#endif
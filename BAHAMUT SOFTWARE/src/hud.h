@@ -0,0 +1,218 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+  TEXT HUD
+
+  Fixed-width text drawn straight into an SSD1306 framebuffer.
+  The controller stores the 128x64 display as 8 pages of 128
+  bytes, each byte one column of 8 vertical pixels, LSB on top.
+  A 5x7 glyph is therefore 5 bytes copied into one page, plus a
+  blank spacing column, so the screen is a 21x8 grid of cells.
+
+  Text lives in fields. Setting a field only blits the cells
+  whose character changed and widens that page's dirty column
+  range, so a changing number costs a few bytes of framebuffer
+  and bus traffic rather than a full 1 KB redraw.
+*/
+
+#define HUD_WIDTH 128
+#define HUD_PAGES 8
+#define HUD_GLYPH 5
+#define HUD_CELL 6
+#define HUD_COLS (HUD_WIDTH / HUD_CELL)
+
+#define HUD_FIRST_CHAR 0x20
+#define HUD_LAST_CHAR 0x7E
+
+// 5x7 ASCII font, one byte per column, printable range only
+static const uint8_t hud_font[HUD_LAST_CHAR - HUD_FIRST_CHAR + 1][HUD_GLYPH] = {
+  { 0x00, 0x00, 0x00, 0x00, 0x00 }, // ' '
+  { 0x00, 0x00, 0x5F, 0x00, 0x00 }, // !
+  { 0x00, 0x07, 0x00, 0x07, 0x00 }, // "
+  { 0x14, 0x7F, 0x14, 0x7F, 0x14 }, // #
+  { 0x24, 0x2A, 0x7F, 0x2A, 0x12 }, // $
+  { 0x23, 0x13, 0x08, 0x64, 0x62 }, // %
+  { 0x36, 0x49, 0x55, 0x22, 0x50 }, // &
+  { 0x00, 0x05, 0x03, 0x00, 0x00 }, // '
+  { 0x00, 0x1C, 0x22, 0x41, 0x00 }, // (
+  { 0x00, 0x41, 0x22, 0x1C, 0x00 }, // )
+  { 0x08, 0x2A, 0x1C, 0x2A, 0x08 }, // *
+  { 0x08, 0x08, 0x3E, 0x08, 0x08 }, // +
+  { 0x00, 0x50, 0x30, 0x00, 0x00 }, // ,
+  { 0x08, 0x08, 0x08, 0x08, 0x08 }, // -
+  { 0x00, 0x60, 0x60, 0x00, 0x00 }, // .
+  { 0x20, 0x10, 0x08, 0x04, 0x02 }, // /
+  { 0x3E, 0x51, 0x49, 0x45, 0x3E }, // 0
+  { 0x00, 0x42, 0x7F, 0x40, 0x00 }, // 1
+  { 0x42, 0x61, 0x51, 0x49, 0x46 }, // 2
+  { 0x21, 0x41, 0x45, 0x4B, 0x31 }, // 3
+  { 0x18, 0x14, 0x12, 0x7F, 0x10 }, // 4
+  { 0x27, 0x45, 0x45, 0x45, 0x39 }, // 5
+  { 0x3C, 0x4A, 0x49, 0x49, 0x30 }, // 6
+  { 0x01, 0x71, 0x09, 0x05, 0x03 }, // 7
+  { 0x36, 0x49, 0x49, 0x49, 0x36 }, // 8
+  { 0x06, 0x49, 0x49, 0x29, 0x1E }, // 9
+  { 0x00, 0x36, 0x36, 0x00, 0x00 }, // :
+  { 0x00, 0x56, 0x36, 0x00, 0x00 }, // ;
+  { 0x08, 0x14, 0x22, 0x41, 0x00 }, // <
+  { 0x14, 0x14, 0x14, 0x14, 0x14 }, // =
+  { 0x00, 0x41, 0x22, 0x14, 0x08 }, // >
+  { 0x02, 0x01, 0x51, 0x09, 0x06 }, // ?
+  { 0x32, 0x49, 0x79, 0x41, 0x3E }, // @
+  { 0x7E, 0x11, 0x11, 0x11, 0x7E }, // A
+  { 0x7F, 0x49, 0x49, 0x49, 0x36 }, // B
+  { 0x3E, 0x41, 0x41, 0x41, 0x22 }, // C
+  { 0x7F, 0x41, 0x41, 0x22, 0x1C }, // D
+  { 0x7F, 0x49, 0x49, 0x49, 0x41 }, // E
+  { 0x7F, 0x09, 0x09, 0x01, 0x01 }, // F
+  { 0x3E, 0x41, 0x41, 0x51, 0x32 }, // G
+  { 0x7F, 0x08, 0x08, 0x08, 0x7F }, // H
+  { 0x00, 0x41, 0x7F, 0x41, 0x00 }, // I
+  { 0x20, 0x40, 0x41, 0x3F, 0x01 }, // J
+  { 0x7F, 0x08, 0x14, 0x22, 0x41 }, // K
+  { 0x7F, 0x40, 0x40, 0x40, 0x40 }, // L
+  { 0x7F, 0x02, 0x04, 0x02, 0x7F }, // M
+  { 0x7F, 0x04, 0x08, 0x10, 0x7F }, // N
+  { 0x3E, 0x41, 0x41, 0x41, 0x3E }, // O
+  { 0x7F, 0x09, 0x09, 0x09, 0x06 }, // P
+  { 0x3E, 0x41, 0x51, 0x21, 0x5E }, // Q
+  { 0x7F, 0x09, 0x19, 0x29, 0x46 }, // R
+  { 0x46, 0x49, 0x49, 0x49, 0x31 }, // S
+  { 0x01, 0x01, 0x7F, 0x01, 0x01 }, // T
+  { 0x3F, 0x40, 0x40, 0x40, 0x3F }, // U
+  { 0x1F, 0x20, 0x40, 0x20, 0x1F }, // V
+  { 0x7F, 0x20, 0x18, 0x20, 0x7F }, // W
+  { 0x63, 0x14, 0x08, 0x14, 0x63 }, // X
+  { 0x03, 0x04, 0x78, 0x04, 0x03 }, // Y
+  { 0x61, 0x51, 0x49, 0x45, 0x43 }, // Z
+  { 0x00, 0x7F, 0x41, 0x41, 0x00 }, // [
+  { 0x02, 0x04, 0x08, 0x10, 0x20 }, // backslash
+  { 0x00, 0x41, 0x41, 0x7F, 0x00 }, // ]
+  { 0x04, 0x02, 0x01, 0x02, 0x04 }, // ^
+  { 0x40, 0x40, 0x40, 0x40, 0x40 }, // _
+  { 0x00, 0x01, 0x02, 0x04, 0x00 }, // `
+  { 0x20, 0x54, 0x54, 0x54, 0x78 }, // a
+  { 0x7F, 0x48, 0x44, 0x44, 0x38 }, // b
+  { 0x38, 0x44, 0x44, 0x44, 0x20 }, // c
+  { 0x38, 0x44, 0x44, 0x48, 0x7F }, // d
+  { 0x38, 0x54, 0x54, 0x54, 0x18 }, // e
+  { 0x08, 0x7E, 0x09, 0x01, 0x02 }, // f
+  { 0x08, 0x14, 0x54, 0x54, 0x3C }, // g
+  { 0x7F, 0x08, 0x04, 0x04, 0x78 }, // h
+  { 0x00, 0x44, 0x7D, 0x40, 0x00 }, // i
+  { 0x20, 0x40, 0x44, 0x3D, 0x00 }, // j
+  { 0x00, 0x7F, 0x10, 0x28, 0x44 }, // k
+  { 0x00, 0x41, 0x7F, 0x40, 0x00 }, // l
+  { 0x7C, 0x04, 0x18, 0x04, 0x78 }, // m
+  { 0x7C, 0x08, 0x04, 0x04, 0x78 }, // n
+  { 0x38, 0x44, 0x44, 0x44, 0x38 }, // o
+  { 0x7C, 0x14, 0x14, 0x14, 0x08 }, // p
+  { 0x08, 0x14, 0x14, 0x18, 0x7C }, // q
+  { 0x7C, 0x08, 0x04, 0x04, 0x08 }, // r
+  { 0x48, 0x54, 0x54, 0x54, 0x20 }, // s
+  { 0x04, 0x3F, 0x44, 0x40, 0x20 }, // t
+  { 0x3C, 0x40, 0x40, 0x20, 0x7C }, // u
+  { 0x1C, 0x20, 0x40, 0x20, 0x1C }, // v
+  { 0x3C, 0x40, 0x30, 0x40, 0x3C }, // w
+  { 0x44, 0x28, 0x10, 0x28, 0x44 }, // x
+  { 0x0C, 0x50, 0x50, 0x50, 0x3C }, // y
+  { 0x44, 0x64, 0x54, 0x4C, 0x44 }, // z
+  { 0x00, 0x08, 0x36, 0x41, 0x00 }, // {
+  { 0x00, 0x00, 0x7F, 0x00, 0x00 }, // |
+  { 0x00, 0x41, 0x36, 0x08, 0x00 }, // }
+  { 0x02, 0x01, 0x02, 0x04, 0x02 }, // ~
+};
+
+/**
+ * @brief Column range per page that differs from the panel.
+ *
+ * A page is clean when lo > hi.
+*/
+struct Hud_Dirty {
+  uint8_t lo[HUD_PAGES];
+  uint8_t hi[HUD_PAGES];
+};
+
+/**
+ * @brief A run of cells on one page holding a piece of text.
+ *
+ * text mirrors what is currently in the framebuffer, so that
+ * setting a field can tell which cells changed.
+*/
+struct Hud_Field {
+  uint8_t page;
+  uint8_t col;
+  uint8_t width;
+  char text[HUD_COLS + 1];
+};
+
+/**
+ * @brief Mark every page clean.
+*/
+static inline void Hud_Clean(Hud_Dirty& dirty) {
+  for (int p = 0; p < HUD_PAGES; p++) {
+    dirty.lo[p] = HUD_WIDTH - 1;
+    dirty.hi[p] = 0;
+  }
+}
+
+/**
+ * @brief Widen a page's dirty range to cover columns x0..x1.
+*/
+static inline void Hud_Mark(Hud_Dirty& dirty, int page, int x0, int x1) {
+  if (x0 < dirty.lo[page]) dirty.lo[page] = x0;
+  if (x1 > dirty.hi[page]) dirty.hi[page] = x1;
+}
+
+/**
+ * @brief Copy one glyph and its spacing column into a cell.
+ *
+ * @param fb framebuffer in SSD1306 page order.
+ * @param page page, 0-7 from the top.
+ * @param cell character cell, 0-20 from the left.
+ * @param c character, anything unprintable draws as a space.
+*/
+static inline void Hud_Blit(uint8_t* fb, int page, int cell, char c) {
+  if (c < HUD_FIRST_CHAR || c > HUD_LAST_CHAR) c = ' ';
+  const uint8_t* glyph = hud_font[c - HUD_FIRST_CHAR];
+  uint8_t* dst = fb + page * HUD_WIDTH + cell * HUD_CELL;
+  for (int x = 0; x < HUD_GLYPH; x++) dst[x] = glyph[x];
+  dst[HUD_GLYPH] = 0;
+}
+
+/**
+ * @brief Set a field's text, redrawing only the cells that changed.
+ *
+ * Text shorter than the field is padded with spaces, longer text
+ * is cut off.
+ *
+ * @return number of cells redrawn.
+*/
+static inline int Hud_Set(uint8_t* fb, Hud_Dirty& dirty, Hud_Field& field, const char* text) {
+  int changed = 0;
+  bool ended = false;
+  for (int i = 0; i < field.width; i++) {
+    if (!ended && text[i] == '\0') ended = true;
+    char c = ended ? ' ' : text[i];
+    if (field.text[i] == c) continue;
+    field.text[i] = c;
+    int cell = field.col + i;
+    Hud_Blit(fb, field.page, cell, c);
+    Hud_Mark(dirty, field.page, cell * HUD_CELL, cell * HUD_CELL + HUD_CELL - 1);
+    changed++;
+  }
+  return changed;
+}
+
+/**
+ * @brief Forget what a field shows, so the next set redraws all of it.
+*/
+static inline void Hud_Invalidate(Hud_Field& field) {
+  for (int i = 0; i < field.width; i++) field.text[i] = '\0';
+}
+
+#endif
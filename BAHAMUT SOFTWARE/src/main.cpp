@@ -1,10 +1,118 @@
-#include <battery_graphics.h>
 #include <SPI.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_SSD1306.h>
-#include <Servo.h>
 #include <Ps3Controller.h>
 #include <Ramp.h>
+#include <LittleFS.h>
+#include <Preferences.h>
+#include <esp_task_wdt.h>
+#include <actions.h>
+#include <buttons.h>
+#include <telemetry.h>
+#include <motion_log.h>
+#include <hud.h>
+#include <sticks.h>
+#include <gait.h>
+#include <gait_tables.h>
+#include <balance.h>
+#include <trace.h>
+#include <motion_pack.h>
+#include <esp_partition.h>
+#include <driver/ledc.h>
+
+/*
+  CONTROL PATH PLACEMENT
+*/
+
+// With CONTROL_IN_IRAM set (see platformio.ini) input decode, action
+// evaluation and servo commit run from IRAM, so flash cache misses
+// caused by the BT stack or the display cannot stall notify().
+#ifdef CONTROL_IN_IRAM
+#define CONTROL_ATTR IRAM_ATTR
+#else
+#define CONTROL_ATTR
+#endif
+
+/*
+  TRACE VARIABLES
+*/
+
+// Events kept per core, the newest overwrite the oldest
+#define TRACE_EVENTS 512
+// Take a new sync pair once a core's counter has moved this far
+#define TRACE_RESYNC_CYCLES (1UL << 30)
+
+/**
+ * @brief One core's event ring.
+ *
+ * Any task on the core may write: a slot is claimed with an atomic
+ * add on head, so a task preempted mid-event only leaves its own
+ * slot half written and nobody ever waits.
+*/
+struct Trace_Ring {
+  // Events ever claimed, only ever increases
+  volatile uint32_t head;
+  bool synced;
+  uint32_t sync_cycles;
+  uint32_t sync_us;
+  Trace_Event events[TRACE_EVENTS];
+};
+
+Trace_Ring trace_rings[2];
+volatile bool trace_on = false;
+
+// Dump in progress, sent a few frames per loop()
+struct Trace_Dump {
+  int core;     // -1 when idle
+  uint32_t next;
+  uint32_t sent;
+};
+
+Trace_Dump trace_dump = { -1 };
+
+/*
+  TRACE FUNCTIONS
+*/
+
+/**
+ * @brief Log one event on the calling core.
+ *
+ * Costs a branch while tracing is off. The cycle counter is per
+ * core, so each ring keeps its own (cycles, micros) pair to line
+ * the cores up on the host, taken with interrupts off so the two
+ * halves agree.
+*/
+void CONTROL_ATTR Trace_Write(uint8_t kind, uint8_t id, uint16_t arg) {
+  if (!trace_on) return;
+  uint32_t cycles = ESP.getCycleCount();
+  Trace_Ring& ring = trace_rings[xPortGetCoreID()];
+  if (!ring.synced || cycles - ring.sync_cycles >= TRACE_RESYNC_CYCLES) {
+    portDISABLE_INTERRUPTS();
+    ring.sync_cycles = ESP.getCycleCount();
+    ring.sync_us = micros();
+    ring.synced = true;
+    portENABLE_INTERRUPTS();
+  }
+
+  uint32_t slot = __atomic_fetch_add(&ring.head, 1, __ATOMIC_RELAXED) % TRACE_EVENTS;
+  Trace_Event& e = ring.events[slot];
+  e.cycles = cycles;
+  e.kind = kind;
+  e.id = id;
+  e.arg = arg;
+}
+
+void CONTROL_ATTR Trace_Begin(uint8_t id) {
+  Trace_Write(TRACE_BEGIN, id, 0);
+}
+
+void CONTROL_ATTR Trace_End(uint8_t id) {
+  Trace_Write(TRACE_END, id, 0);
+}
+
+void CONTROL_ATTR Trace_Instant(uint8_t id, uint16_t arg) {
+  Trace_Write(TRACE_INSTANT, id, arg);
+}
 
 /*
   LED VARIABLES
@@ -45,21 +153,40 @@ enum Led_State led_state = IDLE;
 
 int servo_pins[] = { 13, 12, 14, 27, 26, 25, 33, 15, 2 };
 
-Servo s_rs;
-Servo s_rb;
+// Commanded angle per joint for the current tick
+int16_t joint_cmd[9];
+// Last angle written to each servo (-1 until first commit)
+int16_t joint_out[9] = { -1, -1, -1, -1, -1, -1, -1, -1, -1 };
+// Servo writes since boot
+uint32_t joint_writes = 0;
+
+/**
+ * @brief Handle to a single joint.
+ * 
+ * Actions write target angles through these handles, which
+ * only record the target in joint_cmd. Commit_Joints() then
+ * pushes the targets out to the servos once per tick.
+*/
+struct Joint {
+  int idx;
+  void write(int angle) { joint_cmd[idx] = angle; }
+};
 
-Servo s_ls;
-Servo s_lb;
+Joint s_rs = { rs };
+Joint s_rb = { rb };
 
-Servo s_w;
+Joint s_ls = { ls };
+Joint s_lb = { lb };
 
-Servo s_rh;
-Servo s_rf;
+Joint s_w = { w };
 
-Servo s_lh;
-Servo s_lf;
+Joint s_rh = { rh };
+Joint s_rf = { rf };
 
-Servo joints[] = {
+Joint s_lh = { lh };
+Joint s_lf = { lf };
+
+Joint joints[] = {
     s_rs, s_rb,
     s_ls, s_lb,
     s_w,
@@ -67,956 +194,4650 @@ Servo joints[] = {
     s_lh, s_lf
 };
 
-int std_pos[] = { 20, 145, 160, 35, 95, 60, 40, 130, 130 };
-int gaucho_pos[] = { 20, 145, 160, 35, 95, 80, 60, 100, 100 };
-int crouch_pos[] = { 20, 145, 160, 35, 95, 135, 115, 45, 45 };
-
 /*
-  BATTERY MONITORING VARIABLES
+  PARAMETER VARIABLES
 */
 
-#define battery 35
-#define K 100
+#define PARAMS_VERSION 7
+
+// Input binding values besides an Action
+#define BIND_NONE -1
+// Held, the button keeps the joints where they are
+#define BIND_HOLD ACT_COUNT
+// Stick rules, one per gait, see stick_rules
+#define STICK_RULES 3
+
+/**
+ * @brief Every runtime-tunable value, in one flat struct.
+ * 
+ * The control path reads fields directly, so tuning costs
+ * nothing per tick. The serial console edits them through
+ * param_defs and they persist to NVS as a single blob.
+*/
+struct Params {
+  int version;
+
+  // Gait periods in ms
+  int forward_spd;
+  int backward_spd;
+  int turn_spd;
+  int sidestep_spd;
+  int back_recovery_spd;
+  int front_recovery_spd;
+
+  // Gait offsets in degrees
+  int forward_foot;
+  int forward_waist;
+  int turn_lift;
+  int turn_waist;
+  int sidestep_reach;
 
-float readings[K];
-int reading_idx = 0;
+  // First beat's share of each gait period in %
+  int forward_split;
+  int turn_split;
+  int sidestep_split;
 
-Adafruit_SSD1306 lcd(128, 64, &Wire, -1);
+  // Per-side waist trim for the sweep, { right, left }.
+  // The left sweep swings 10 degrees further than the mirror of the right.
+  int sweep_w_trim[2];
+
+  // Stick shaping, see sticks.h
+  int stick_deadzone;
+  int stick_expo;
+  int stick_filter;
+  int gait_hysteresis;
+
+  // Balance check, see balance.h. Margin in mm inside the feet.
+  int balance;
+  int balance_margin;
+
+  // Battery threshold
+  int low_battery;
+
+  int telemetry;
+
+  // Dispatch attack edges on the fast path in notify()
+  int fast_attacks;
+
+  // Input bindings, see Compile_Dispatch(). Action per button,
+  // BIND_NONE or BIND_HOLD, and its priority when several are held.
+  int bind[BTN_COUNT];
+  int bind_priority[BTN_COUNT];
+  // Action per gait and stick direction, see stick_rules
+  int stick_bind[STICK_RULES][2];
+
+  // Servo PWM, see Servo_Configure(). Joints flagged digital run
+  // at a servo_frame ms frame, the rest at the standard 20 ms.
+  int servo_digital[9];
+  int servo_frame;
+
+  // Pose tables
+  int std_pos[9];
+  int gaucho_pos[9];
+  int crouch_pos[9];
+};
+
+const Params default_params = {
+  PARAMS_VERSION,
+  GAIT_WALK_PERIOD, GAIT_WALK_PERIOD, GAIT_TURN_PERIOD, GAIT_SIDESTEP_PERIOD, 2100, 2100,
+  GAIT_WALK_FOOT, GAIT_WALK_WAIST, GAIT_TURN_LIFT, GAIT_TURN_WAIST, GAIT_SIDESTEP_REACH,
+  GAIT_WALK_SPLIT, GAIT_TURN_SPLIT, GAIT_SIDESTEP_SPLIT,
+  { 0, -10 },
+  10, 0, 192, 8,
+  1, 5,
+  2550,
+  1,
+  1,
+  // select l3 r3 start up right down left l2 r2 l1 r1 triangle circle cross square ps
+  { ACT_BACK_RECOVERY, BIND_NONE, BIND_NONE, ACT_FRONT_RECOVERY,
+    ACT_WARMING_UP, ACT_BEHOLD, ACT_DUST_OFF, ACT_GIVE_IT_YOUR_ALL,
+    ACT_LEFT_SWEEP, ACT_RIGHT_SWEEP, ACT_LEFT_HOOK, ACT_RIGHT_HOOK,
+    BIND_NONE, ACT_RIGHT_SHOT, BIND_HOLD, ACT_LEFT_SHOT, BIND_NONE },
+  { 11, 0, 0, 12, 1, 2, 3, 4, 8, 7, 6, 5, 0, 9, 0, 10, 0 },
+  { { ACT_FORWARD, ACT_BACKWARD }, { ACT_RIGHT, ACT_LEFT }, { ACT_SIDESTEP_LEFT, ACT_SIDESTEP_RIGHT } },
+  { 0, 0, 0, 0, 0, 0, 0, 0, 0 },
+  5,
+  GAIT_STD_POSE,
+  GAIT_GAUCHO_POSE,
+  GAIT_CROUCH_POSE
+};
+
+Params params = default_params;
+
+// Held by whoever is evaluating actions, committing joints or
+// changing params
+SemaphoreHandle_t control_lock = NULL;
 
 /*
-  BATTERY DISPLAY FUNCTIONS
+  SERVO PWM VARIABLES
 */
 
-/**
- * @brief Displays current voltage on connected OLED display.
- * 
- * Reads the current voltage of the battery
- * and depending on which bin it lands in, displays a graphic
- * corresponding to charge on the OLED display.
- * [3050, 4095]: full charge graphic,
- * [2800, 3050): two bar charge graphic,
- * [2550, 2800): one bar charge graphic (blinking),
- * [0, 2550): empty charge graphic (blinking).
- * Filtering of size K is used, such that readings are 
- * stored on an array of size K and the average of the
- * array is taken as the output value.
-*/
-void Display_Voltage() {
-  readings[reading_idx] = analogRead(battery);
-  float voltage = 0;
-  for (int i = 0; i < K; i++) voltage += readings[i];
-  voltage /= K;
+// Pulse range the Servo library used, so angles keep their pulses
+#define SERVO_MIN_US 544
+#define SERVO_MAX_US 2400
+#define SERVO_ANALOG_FRAME 20
+// Counter bits. With 14 of them every whole ms frame has an exact
+// APB divider, so frames keep step with the FreeRTOS tick.
+#define SERVO_BITS 14
+// Digital frames start at least this far into a millisecond of the
+// tick grid once aligned, leaving a tick on it time to commit before
+// the duty latches, in us
+#define SERVO_ALIGN_US 250
 
-  lcd.clearDisplay();
+enum Servo_Class {
+  SERVO_ANALOG,
+  SERVO_DIGITAL,
+  SERVO_CLASS_COUNT
+};
 
-  if (voltage >= 3050) lcd.drawBitmap(0, 0, full_charge, 128, 64, 1);
-  else if (voltage >= 2800) lcd.drawBitmap(0, 0, two_bar_charge, 128, 64, 1);
-  else if (voltage >= 2550) {
-    if (millis() % 2000 < 1000) lcd.drawBitmap(0, 0, one_bar_charge, 128, 64, 1);
-  }
-  else {
-    if (millis() % 2000 < 1000) lcd.drawBitmap(0, 0, empty_charge, 128, 64, 1);
-  }
+const char* const servo_class_names[SERVO_CLASS_COUNT] = { "analog", "digital" };
 
-  lcd.display();
+// What committed a write, only control ticks can be aligned
+enum Servo_Source {
+  SERVO_PACKET,
+  SERVO_TICK,
+  SERVO_SOURCE_COUNT
+};
 
-  reading_idx = (reading_idx + 1) % K;
-}
+const char* const servo_source_names[SERVO_SOURCE_COUNT] = { "packet", "tick" };
+
+struct Servo_Delay {
+  uint32_t n;
+  uint64_t sum_us;
+  uint32_t max_us;
+};
 
 /**
- * @brief Animate pairing message on connected OLED display.
- * 
- * Prints to the OLED display "Waiting to pair"
- * followed by an amount of periods equal to the passed in 
- * phase value.
+ * @brief LEDC output for the joints.
  * 
- * @param phase The input phase (0-3)
+ * Joints 0-7 take high speed channels 0-7 and joint 8 low speed
+ * channel 0; analogWrite() hands the LEDs low speed channels from
+ * the top down. Both speed modes run timer 0 for analog joints and
+ * timer 1 for digital ones. A new duty only takes effect when its
+ * timer next wraps, so the time to that wrap is the command's wait
+ * before the servo sees it.
 */
-void Waiting_To_Pair(int phase) {
-	lcd.clearDisplay();
-	lcd.setCursor(0, 54);
-	switch (phase) {
-		case 0:
-			lcd.print("Waiting to pair");
-			break;
-		case 1:
-			lcd.print("Waiting to pair.");
-			break;
-		case 2:
-			lcd.print("Waiting to pair..");
-			break;
-		case 3:
-			lcd.print("Waiting to pair...");
-			break;
-	}
-	lcd.display();
-}
+struct Servo_Pwm {
+  uint8_t joint_class[9];
+  // Angle each attached channel is driving, -1 while detached
+  int16_t angle[9];
+  uint8_t frame_ms[SERVO_CLASS_COUNT];
+  // micros() at which each class's timers last wrapped
+  uint32_t start_us[SERVO_CLASS_COUNT];
+  // Digital frames start at least SERVO_ALIGN_US into align_tick,
+  // see Servo_Align()
+  bool aligned;
+  TickType_t align_tick;
+  // Ticks the control task slept past its period to stay on the
+  // frame grid, see Servo_Frame_Lock()
+  uint8_t slip_ms;
+  // Set by the control task while it commits, under the control lock
+  uint8_t source;
+  // Command to pulse delay per class and source
+  Servo_Delay delay[SERVO_CLASS_COUNT][SERVO_SOURCE_COUNT];
+};
+
+Servo_Pwm servo_pwm = { {}, { -1, -1, -1, -1, -1, -1, -1, -1, -1 } };
 
 /*
-  ANIMATIONS FUNCTIONS
+  SERVO PWM FUNCTIONS
 */
 
-// Movement States
-bool crouched = false;
+ledc_mode_t CONTROL_ATTR Servo_Mode(int i) {
+  return i < 8 ? LEDC_HIGH_SPEED_MODE : LEDC_LOW_SPEED_MODE;
+}
 
-// Locomotion Functions
+ledc_channel_t CONTROL_ATTR Servo_Channel(int i) {
+  return (ledc_channel_t)(i < 8 ? i : 0);
+}
 
 /**
- * @brief Turn left via legs.
- * 
- * Turn in place left via a two beat pattern. 
- * 
- * First beat raises the body via the feet 
- * and returns the waist to the original 
- * position. 
- * 
- * Second beat lowers the body to the default
- * position while turning the waist left.
- * 
- * @param spd The speed in milliseconds to cycle 
- * through all the phases.
+ * @brief Duty for an angle, mapped over the pulse range as the
+ * Servo library did.
 */
-void Left(int spd) {
-  unsigned long delta = millis() % spd;
-  if (delta < spd/2) {
-    // Raise Body and Reorient
-    s_lf.write(gaucho_pos[lf]-20);
-    s_rf.write(gaucho_pos[rf]+20);
-    s_w.write(gaucho_pos[w]);
-  }
-  else {
-    // Lower Body and Turn Left
-    s_lf.write(gaucho_pos[lf]);
-    s_rf.write(gaucho_pos[rf]);
-    s_w.write(gaucho_pos[w]+80);
-  }
-
-  // Fix Rest of Body
-  for (int i = 0; i < 9; i++) {
-    if (i != lf && i != rf && i != w) joints[i].write(gaucho_pos[i]);
-  }
+uint32_t CONTROL_ATTR Servo_Duty(int angle, uint8_t frame_ms) {
+  uint32_t us = SERVO_MIN_US + (uint32_t)constrain(angle, 0, 180) * (SERVO_MAX_US - SERVO_MIN_US) / 180;
+  return (us << SERVO_BITS) / (frame_ms * 1000UL);
 }
 
 /**
- * @brief Turn right via legs.
+ * @brief Set up and restart a class's timer in both speed modes.
  * 
- * Turn in place right via a two beat pattern. 
- * 
- * First beat raises the body via the feet 
- * and returns the waist to the original 
- * position. 
- * 
- * Second beat lowers the body to the default
- * position while turning the waist right.
- * 
- * @param spd The speed in milliseconds to cycle 
- * through all the phases.
+ * The divider has 8 fractional bits: 80 MHz x frame / 2^14 is
+ * exactly 1250 per ms of frame.
 */
-void Right(int spd) {
-  unsigned long delta = millis() % spd;
-  if (delta < spd/2) {
-    // Raise Body and Reorient
-    s_lf.write(gaucho_pos[lf]-20);
-    s_rf.write(gaucho_pos[rf]+20);
-    s_w.write(gaucho_pos[w]);
-  }
-  else {
-    // Lower Body and Turn Right
-    s_lf.write(gaucho_pos[lf]);
-    s_rf.write(gaucho_pos[rf]);
-    s_w.write(gaucho_pos[w]-80);
-  }
-
-  // Fix Rest of Body
-  for (int i = 0; i < 9; i++) {
-    if (i != lf && i != rf && i != w) joints[i].write(gaucho_pos[i]);
+void Servo_Timer(int c) {
+  for (int m = 0; m < LEDC_SPEED_MODE_MAX; m++) {
+    ledc_timer_config_t t;
+    memset(&t, 0, sizeof(t));
+    t.speed_mode = (ledc_mode_t)m;
+    t.duty_resolution = (ledc_timer_bit_t)SERVO_BITS;
+    t.timer_num = (ledc_timer_t)c;
+    t.freq_hz = 1000 / servo_pwm.frame_ms[c];
+    t.clk_cfg = LEDC_USE_APB_CLK;
+    ledc_timer_config(&t);
+    ledc_timer_set((ledc_mode_t)m, (ledc_timer_t)c, 1250UL * servo_pwm.frame_ms[c], SERVO_BITS, LEDC_APB_CLK);
+    ledc_timer_rst((ledc_mode_t)m, (ledc_timer_t)c);
   }
+  servo_pwm.start_us[c] = micros();
 }
 
 /**
- * @brief Move left via legs.
- * 
- * Move left via a two beat pattern.
+ * @brief Start driving a joint's pin.
  * 
- * First beat moves the right hip and foot
- * outward and upward, thrusting the body in
- * the left direction. The left hip and foot
- * are extended outward as well but to stabilize
- * the body.
- * 
- * Second beat returns the body to default position.
+ * @param angle pulse to start on.
+*/
+void Servo_Attach(int i, int angle) {
+  uint8_t c = servo_pwm.joint_class[i];
+  ledc_channel_config_t ch;
+  memset(&ch, 0, sizeof(ch));
+  ch.gpio_num = servo_pins[i];
+  ch.speed_mode = Servo_Mode(i);
+  ch.channel = Servo_Channel(i);
+  ch.intr_type = LEDC_INTR_DISABLE;
+  ch.timer_sel = (ledc_timer_t)c;
+  ch.duty = Servo_Duty(angle, servo_pwm.frame_ms[c]);
+  ch.hpoint = 0;
+  ledc_channel_config(&ch);
+  servo_pwm.angle[i] = angle;
+}
+
+/**
+ * @brief Command a joint and account the wait until its pulse.
  * 
- * @param spd The speed in milliseconds to cycle 
- * through all the phases.
+ * Digital writes from ticks before Servo_Align() has run, soft
+ * start's among them, are left out: they say nothing about how
+ * well aligned ticks meet the latch.
 */
-void Sidestep_Left(int spd) {
-  unsigned long delta = millis() % spd;
-  if (delta < spd/2) {
-    // Thrust
-    s_rh.write(std_pos[rh]+20);
-    s_rf.write(std_pos[rf]-20);
-    // Catch
-    s_lh.write(std_pos[lh]-20);
-    s_lf.write(std_pos[lf]-20);
-  }
-  else {
-    // Reset
-    s_lh.write(std_pos[lh]);
-    s_lf.write(std_pos[lf]);
-    s_rh.write(std_pos[rh]);
-    s_rf.write(std_pos[rf]);
-  }
+void CONTROL_ATTR Servo_Write(int i, int angle) {
+  uint8_t c = servo_pwm.joint_class[i];
+  ledc_mode_t m = Servo_Mode(i);
+  ledc_set_duty(m, Servo_Channel(i), Servo_Duty(angle, servo_pwm.frame_ms[c]));
+  ledc_update_duty(m, Servo_Channel(i));
+  servo_pwm.angle[i] = angle;
 
-  // Fix Rest of Body
-  for (int i = 0; i < 9; i++) {
-    if (i != rh && i != rf && i != lh && i != lf) joints[i].write(std_pos[i]);
-  }
+  if (c == SERVO_DIGITAL && servo_pwm.source == SERVO_TICK && !servo_pwm.aligned) return;
+  uint32_t frame_us = servo_pwm.frame_ms[c] * 1000UL;
+  uint32_t wait = frame_us - (micros() - servo_pwm.start_us[c]) % frame_us;
+  Servo_Delay& d = servo_pwm.delay[c][servo_pwm.source];
+  d.n++;
+  d.sum_us += wait;
+  if (wait > d.max_us) d.max_us = wait;
 }
 
 /**
- * @brief Move right via legs.
- * 
- * Move right via a two beat pattern.
- * 
- * First beat moves the left hip and foot
- * outward and upward, thrusting the body in
- * the right direction. The right hip and foot
- * are extended outward as well but to stabilize
- * the body.
+ * @brief Bring the timers in line with the servo parameters.
  * 
- * Second beat returns the body to default position.
- * 
- * @param spd The speed in milliseconds to cycle 
- * through all the phases.
+ * Called at boot and whenever the parameters change, under the
+ * control lock. Attached joints that change class or frame get
+ * their pulse rewritten for the new frame. A new digital frame
+ * has to be aligned again.
 */
-void Sidestep_Right(int spd) {
-  unsigned long delta = millis() % spd;
-  if (delta < spd/2) {
-    // Thrust
-    s_lh.write(std_pos[lh]-20);
-    s_lf.write(std_pos[lf]+20);
-    // Catch
-    s_rh.write(std_pos[rh]+20);
-    s_rf.write(std_pos[rf]+20);
+void Servo_Configure() {
+  if (servo_pwm.frame_ms[SERVO_ANALOG] == 0) {
+    servo_pwm.frame_ms[SERVO_ANALOG] = SERVO_ANALOG_FRAME;
+    Servo_Timer(SERVO_ANALOG);
   }
-  else {
-    // Reset
-    s_lh.write(std_pos[lh]);
-    s_lf.write(std_pos[lf]);
-    s_rh.write(std_pos[rh]);
-    s_rf.write(std_pos[rf]);
+  bool new_frame = servo_pwm.frame_ms[SERVO_DIGITAL] != params.servo_frame;
+  if (new_frame) {
+    servo_pwm.frame_ms[SERVO_DIGITAL] = params.servo_frame;
+    Servo_Timer(SERVO_DIGITAL);
+    servo_pwm.aligned = false;
   }
-
-  // Fix Rest of Body
   for (int i = 0; i < 9; i++) {
-    if (i != rh && i != rf && i != lh && i != lf) joints[i].write(std_pos[i]);
+    uint8_t c = params.servo_digital[i] ? SERVO_DIGITAL : SERVO_ANALOG;
+    if (c == servo_pwm.joint_class[i] && !(new_frame && c == SERVO_DIGITAL)) continue;
+    servo_pwm.joint_class[i] = c;
+    if (servo_pwm.angle[i] >= 0) {
+      ledc_bind_channel_timer(Servo_Mode(i), Servo_Channel(i), (ledc_timer_t)c);
+      Servo_Write(i, servo_pwm.angle[i]);
+    }
   }
 }
 
 /**
- * @brief Move forward via legs.
- * 
- * Move forward via a two beat pattern.
- * 
- * First beat shifts the center of mass towards the left
- * via the feet, then rotates the waist left.
- * 
- * Second beat shifts the center of mass towards the right
- * via the feet,  then rotates the waist right.
- * 
- * Thus forward movement is achieved by turning the waist
- * towards where the center of mass is currently shifted to.
- * 
- * @param spd The speed in milliseconds to cycle 
- * through all the phases.
+ * @brief Whether any joint runs a digital frame.
 */
-void Forward(int spd) {
-  unsigned long delta = millis() % spd;
-
-  if (delta < spd/2) {
-    // Shift Mass Left and Rotate Left
-    s_lf.write(std_pos[lf]+25);
-    s_rf.write(std_pos[rf]+25);
-    s_w.write(std_pos[w]+45);
-  }
-  else {
-    // Shift Mass Right and Rotate Right
-    s_lf.write(std_pos[lf]-25);
-    s_rf.write(std_pos[rf]-25);
-    s_w.write(std_pos[w]-45);
-  }
-
-  // Fix Rest of Body
+bool CONTROL_ATTR Servo_Any_Digital() {
   for (int i = 0; i < 9; i++) {
-    if (i != rf && i != lf && i != w) joints[i].write(std_pos[i]);
+    if (servo_pwm.joint_class[i] == SERVO_DIGITAL) return true;
   }
+  return false;
 }
 
 /**
- * @brief Move backward via legs.
- * 
- * Move backward via a two beat pattern.
- * 
- * First beat shifts the center of mass towards the left
- * via the feet, then rotates the waist right.
+ * @brief Restart the digital frames at least SERVO_ALIGN_US into a
+ * millisecond of the tick grid.
  * 
- * Second beat shifts the center of mass towards the right
- * via the feet,  then rotates the waist left.
+ * Any later tick a whole number of frames away then commits just
+ * ahead of the latch instead of up to a frame behind it. The
+ * restart busy-waits for the current pulses to end, so none is cut
+ * short, then on to SERVO_ALIGN_US into the millisecond. The gap
+ * after the longest pulse is at least 500 us in a 3 ms frame and
+ * always holds such a point, so one tick is enough. The wait is
+ * under a frame and SERVO_ALIGN_US, once per new frame.
  * 
- * Thus backward movement is achieved by turning the waist
- * away from where the center of mass is currently shifted to.
+ * The wait runs without the control lock, so packets are not held
+ * up behind it. Apply_Params() may reconfigure the frame meanwhile,
+ * so the restart is only committed, under the lock, if the frame
+ * it waited on is still the one running. Otherwise the next tick
+ * tries again.
  * 
- * @param spd The speed in milliseconds to cycle 
- * through all the phases.
+ * @param tick_us micros() at the start of the tick.
 */
-void Backward(int spd) {
-  unsigned long delta = millis() % spd;
-
-  if (delta < spd/2) {
-    // Shift Mass Left and Rotate Right
-    s_lf.write(std_pos[lf]+25);
-    s_rf.write(std_pos[rf]+25);
-    s_w.write(std_pos[w]-45);
-  }
-  else {
-    // Shift Mass Right and Rotate Left
-    s_lf.write(std_pos[lf]-25);
-    s_rf.write(std_pos[rf]-25);
-    s_w.write(std_pos[w]+45);
+void CONTROL_ATTR Servo_Align(uint32_t tick_us) {
+  uint8_t frame_ms = servo_pwm.frame_ms[SERVO_DIGITAL];
+  uint32_t start_us = servo_pwm.start_us[SERVO_DIGITAL];
+  uint32_t frame_us = frame_ms * 1000UL;
+  uint32_t at = micros();
+  for (;;) {
+    uint32_t phase = (at - start_us) % frame_us;
+    if (phase < SERVO_MAX_US + 100) {
+      at += SERVO_MAX_US + 100 - phase;
+      continue;
+    }
+    uint32_t into = (at - tick_us) % 1000;
+    if (into >= SERVO_ALIGN_US) break;
+    // May run into the next frame's pulses, then waits those out too
+    at += SERVO_ALIGN_US - into;
   }
+  while ((int32_t)(at - micros()) > 0) delayMicroseconds(at - micros());
 
-  // Fix Rest of Body
-  for (int i = 0; i < 9; i++) {
-    if (i != rf && i != lf && i != w) joints[i].write(std_pos[i]);
+  xSemaphoreTake(control_lock, portMAX_DELAY);
+  if (!servo_pwm.aligned && Servo_Any_Digital() &&
+      servo_pwm.frame_ms[SERVO_DIGITAL] == frame_ms && servo_pwm.start_us[SERVO_DIGITAL] == start_us) {
+    for (int m = 0; m < LEDC_SPEED_MODE_MAX; m++) ledc_timer_rst((ledc_mode_t)m, (ledc_timer_t)SERVO_DIGITAL);
+    servo_pwm.start_us[SERVO_DIGITAL] = micros();
+    servo_pwm.align_tick = xTaskGetTickCount();
+    servo_pwm.aligned = true;
   }
+  xSemaphoreGive(control_lock);
 }
 
 /**
- * @brief Fix the rest of body excluding used servos.
+ * @brief Extra sleep that puts the next control tick on the frame grid.
  * 
- * Takes a In_Use function, which checks if the currently
- * accessed servo is a used servo, if so returns true.
+ * Ticks are held to the finest grid that both the period and the
+ * digital frame step on, their greatest common divisor, so as many
+ * ticks as the two allow land just ahead of a latch: all of them
+ * when the period is whole frames, every other one at the 2 ms
+ * fast rate under a 4 ms frame. Coprime pairs are left alone, so
+ * odd frames get no tick alignment at the fast rate, and the slip
+ * is never more than a grid step. Deadline_Tick()
+ * discounts it.
  * 
- * @param In_Use function to check if servo is in use.
+ * @param target tick the task would wake at.
+ * @param period ticks it is sleeping for.
+ * @return ticks to add to period.
 */
-void Fix_Rest(bool (*In_Use)(int)) {
-  if (crouched) {
-			for (int i = 0; i < 9; i++) { 
-        if (!In_Use(i)) joints[i].write(crouch_pos[i]);
-      }
-  }
-  else {
-    for (int i = 0; i < 9; i++) {
-      if (!In_Use(i)) joints[i].write(gaucho_pos[i]);
-    }
+TickType_t Servo_Frame_Lock(TickType_t target, TickType_t period) {
+  servo_pwm.slip_ms = 0;
+  if (!servo_pwm.aligned || period == 0 || !Servo_Any_Digital()) return 0;
+  TickType_t grid = period;
+  TickType_t rest = pdMS_TO_TICKS(servo_pwm.frame_ms[SERVO_DIGITAL]);
+  while (rest) {
+    TickType_t r = grid % rest;
+    grid = rest;
+    rest = r;
   }
+  if (grid == 1) return 0;
+  TickType_t slip = (grid - (target - servo_pwm.align_tick) % grid) % grid;
+  servo_pwm.slip_ms = slip;
+  return slip;
 }
 
-bool In_Use_Idle(int i) { return false; }
+/*
+  BOOT VARIABLES
+*/
+
+enum Boot_Phase {
+  BOOT_SETUP,
+  BOOT_PARAMS,
+  BOOT_CONTROL,
+  BOOT_DISPLAY,
+  BOOT_FS,
+  BOOT_BLUETOOTH,
+  BOOT_READY,
+  BOOT_SERVOS,
+  BOOT_CONNECT,
+  BOOT_COUNT
+};
+
+const char* boot_phase_names[BOOT_COUNT] = { "setup", "params", "control", "display", "fs", "bluetooth", "ready", "servos", "connect" };
+
+// micros() since reset at which each phase completed, 0 until it has
+volatile uint32_t boot_us[BOOT_COUNT];
+bool boot_reported = false;
+
+// Free heap when setup() returned. Nothing of ours allocates after
+// that, so any later drop in the low-water mark is the Bluetooth
+// stack's and the headroom it has left is what "memory" reports.
+uint32_t heap_after_setup = 0;
+
+// Attach one servo every SERVO_STAGGER ms, each then ramps from
+// the attach pulse to its command over SOFT_START_MS
+#define SERVO_STAGGER 40
+#define SOFT_START_MS 300
+#define SERVO_CENTER 90
+
+// Legs first, so the robot is standing before the arms move
+const int servo_start_order[] = { rh, lh, rf, lf, w, rs, ls, rb, lb };
+
+bool soft_start = true;
+uint8_t joints_attached = 0;
+uint32_t joint_attach_ms[9];
+
 /**
- * @brief Idle body
- * 
- * Set joints to resting position (depends on if crouched or not).
+ * @brief Mark a boot phase as complete.
 */
-void Idle() { Fix_Rest(In_Use_Idle); }
+void Boot_Mark(Boot_Phase phase) {
+  // 0 stands for not yet, even on a clock that starts at reset
+  boot_us[phase] = max(micros(), 1UL);
+}
 
-rampInt br_rs;
-rampInt br_ls;
-rampInt br_rb;
-rampInt br_lb;
-rampInt br_rh;
-rampInt br_lh;
-rampInt br_rf;
-rampInt br_lf;
-unsigned long back_recovery_start = 0;
 /**
- * @brief Stand back up from lying on back
- * 
- * Four beat motion to stand up from.
- * 
- * First beat orients legs in a split.
- * 
- * Second beat swings biceps backward to push body forward.
- * 
- * Third beat brings arms down to further push body forward.
- * 
- * Final beat resets body to idle position.
+ * @brief Commit joints while servos are still being brought up.
  * 
- * @param spd The speed in milliseconds to complete the motion.
+ * Unattached joints are skipped. An attached joint ramps linearly
+ * from SERVO_CENTER, where Soft_Start_Tick() attaches it,
+ * to its command, so at most one servo is ever slewing from rest
+ * at full current. Ends soft start once every ramp is done.
 */
-void Back_Recovery(int spd) {
-  unsigned long curr_time = millis();
-  // Orient
-  if (curr_time < back_recovery_start + (1*spd/4)) {
-    // Reset ramps
-    br_rs.go(gaucho_pos[rs]+30);
-    br_ls.go(gaucho_pos[ls]-30);
-    br_rb.go(gaucho_pos[rb]-145);
-    br_lb.go(gaucho_pos[lb]+145);
-    br_rh.go(gaucho_pos[rh]+50);
-    br_lh.go(gaucho_pos[lh]-50);
-    br_rf.go(gaucho_pos[rf]-80);
-    br_lf.go(gaucho_pos[lf]+80);
-
-    s_rs.write(gaucho_pos[rs]+105);
-    s_ls.write(gaucho_pos[ls]-105);
-    s_rf.write(gaucho_pos[rf]-80);
-    s_lf.write(gaucho_pos[lf]+80);
-    s_rh.write(gaucho_pos[rh]+50);
-    s_lh.write(gaucho_pos[lh]-50);
-    for (int i = 0; i < 9; i++) {
-      if (i != rs && i != ls && i != rf && i != lf && i != rh && i != lh) joints[i].write(gaucho_pos[i]);
+void Soft_Start_Commit() {
+  unsigned long now = millis();
+  bool done = joints_attached == 9;
+  for (int n = 0; n < joints_attached; n++) {
+    int i = servo_start_order[n];
+    unsigned long elapsed = now - joint_attach_ms[i];
+    int angle = joint_cmd[i];
+    if (elapsed < SOFT_START_MS) {
+      angle = SERVO_CENTER + (joint_cmd[i] - SERVO_CENTER) * (long)elapsed / SOFT_START_MS;
+      done = false;
+    }
+    if (angle != joint_out[i]) {
+      Servo_Write(i, angle);
+      joint_out[i] = angle;
     }
   }
-  // Swing biceps back
-  else if (curr_time < back_recovery_start + (2*spd/4)) {
-    s_rs.write(gaucho_pos[rs]+105);
-    s_ls.write(gaucho_pos[ls]-105);
-    s_rb.write(gaucho_pos[rb]-145);
-    s_lb.write(gaucho_pos[lb]+145);
-
-    s_rs.write(gaucho_pos[rs]+105);
-    s_ls.write(gaucho_pos[ls]-105);
-    s_rf.write(gaucho_pos[rf]-80);
-    s_lf.write(gaucho_pos[lf]+80);
-    s_rh.write(gaucho_pos[rh]+50);
-    s_lh.write(gaucho_pos[lh]-50);
+  if (done) {
+    soft_start = false;
+    Boot_Mark(BOOT_SERVOS);
+  }
+}
+
+/*
+  BATTERY MONITORING VARIABLES
+*/
+
+#define battery 35
+#define K 100
+
+// Raw 12-bit ADC samples, filtered by Battery_Voltage()
+struct Battery_Monitor {
+  uint16_t readings[K];
+  uint8_t idx;
+  // Running sum of readings, kept by Sample_Battery()
+  uint32_t sum;
+  // Last Battery_Voltage(), refreshed every sample
+  uint16_t average;
+};
+
+Battery_Monitor battery_mon;
+
+// Action currently driving the joints
+enum Action action = ACT_IDLE;
+
+/*
+  ENERGY VARIABLES
+*/
+
+// Charge model: every joint draws a holding current, moving one
+// costs a fixed charge per degree. Rough figures for 9 g class
+// servos, good for ranking moves rather than for absolute mAh.
+#define SERVO_HOLD_MA 10
+#define SERVO_UAS_PER_DEG 400
+// Pack millivolts at an ADC reading of 4095, from HUD_BATTERY_FULL
+// being a full 2S pack (8.4 V at 3150 counts)
+#define BATTERY_FULL_SCALE_MV 10920
+
+/**
+ * @brief What one action has cost since the last reset.
+*/
+struct Action_Energy {
+  uint64_t active_us;
+  uint32_t commits;
+  uint32_t commands;
+  uint32_t travel[9];
+  // Travel and time, each weighted by the battery reading
+  uint64_t travel_counts;
+  uint64_t counts_us;
+};
+
+Action_Energy energy[ACT_COUNT];
+uint32_t energy_last_us = 0;
+
+/*
+  BALANCE VARIABLES
+*/
+
+struct Balance_State {
+  // Center of mass of the last committed pose, 1/16 mm
+  Bal_Point com;
+  // Commands pulled back towards the last pose, or held at it
+  uint32_t softened;
+  uint32_t held;
+  // Slowest check, us
+  uint32_t max_us;
+};
+
+Balance_State balance;
+
+/*
+  BALANCE FUNCTIONS
+*/
+
+/**
+ * @brief Whether an action is exempt from the balance check.
+ * 
+ * Recoveries start from the ground, so the standing model does
+ * not apply, and the safe pose must never be second-guessed.
+*/
+bool CONTROL_ATTR Balance_Exempt() {
+  return action == ACT_BACK_RECOVERY || action == ACT_FRONT_RECOVERY || action == ACT_SAFE_POSE;
+}
+
+/**
+ * @brief Pull a command that leaves the support polygon back in.
+ * 
+ * Estimates the center of mass of joint_cmd. If it falls outside
+ * the feet by more than the margin allows, the command is blended
+ * back towards the last committed pose, 3/4, 1/2 then 1/4 of the
+ * way, and the first blend that stands is committed instead. When
+ * none does, whichever of them is least outside wins, so a pose
+ * that is already off balance is never made worse.
+*/
+void CONTROL_ATTR Balance_Soften() {
+  uint32_t start = micros();
+  Bal_Point com = Balance_Com(joint_cmd, params.std_pos);
+  int32_t excess = Balance_Excess(com, params.balance_margin);
+
+  if (excess > 0) {
+    int16_t best[9];
+    memcpy(best, joint_cmd, sizeof(best));
+    int best_quarters = 4;
+    for (int q = 3; q >= 0 && excess > 0; q--) {
+      int16_t blend[9];
+      for (int i = 0; i < 9; i++) blend[i] = joint_out[i] + (joint_cmd[i] - joint_out[i]) * q / 4;
+      Bal_Point c = Balance_Com(blend, params.std_pos);
+      int32_t e = Balance_Excess(c, params.balance_margin);
+      if (e < excess) {
+        memcpy(best, blend, sizeof(best));
+        best_quarters = q;
+        excess = e;
+        com = c;
+      }
+    }
+    if (best_quarters < 4) {
+      memcpy(joint_cmd, best, sizeof(best));
+      if (best_quarters == 0) balance.held++;
+      else balance.softened++;
+    }
+  }
+
+  balance.com = com;
+  uint32_t elapsed = micros() - start;
+  if (elapsed > balance.max_us) balance.max_us = elapsed;
+}
+
+/**
+ * @brief Push commanded angles out to the servos.
+ * 
+ * Commands that would tip the body are softened first, see
+ * Balance_Soften(). Only joints whose command changed since
+ * the last commit are written. Each commit is charged to the
+ * running action in energy[].
+*/
+void CONTROL_ATTR Commit_Joints() {
+  if (soft_start) {
+    Soft_Start_Commit();
+    return;
+  }
+  if (params.balance && !Balance_Exempt()) Balance_Soften();
+
+  // Charge the time since the last commit and this commit's
+  // travel to the action now driving the joints
+  Action_Energy& e = energy[action];
+  uint32_t now = micros();
+  uint32_t elapsed = energy_last_us ? now - energy_last_us : 0;
+  energy_last_us = now;
+  uint32_t travel = 0;
+  uint16_t written = 0;
+
+  for (int i = 0; i < 9; i++) {
+    if (joint_cmd[i] != joint_out[i]) {
+      Servo_Write(i, joint_cmd[i]);
+      uint32_t d = abs(joint_cmd[i] - joint_out[i]);
+      e.travel[i] += d;
+      travel += d;
+      written++;
+      joint_out[i] = joint_cmd[i];
+    }
+  }
+  Trace_Instant(TRACE_COMMIT, written);
+
+  joint_writes += written;
+  e.commands += written;
+
+  e.commits++;
+  e.active_us += elapsed;
+  e.travel_counts += (uint64_t)travel * battery_mon.average;
+  e.counts_us += (uint64_t)elapsed * battery_mon.average;
+}
+
+/*
+  DISPLAY VARIABLES
+*/
+
+// 400 kHz during and after transfers, so the HUD's own partial
+// writes run at full speed too
+Adafruit_SSD1306 lcd(128, 64, &Wire, -1, 400000, 400000);
+// Set while the display is being flushed
+volatile bool display_busy = false;
+// Dots on the pairing screen last drawn, -1 when it has to be redrawn
+int pairing_phase = -1;
+
+/**
+ * @brief Filtered battery reading.
+ * 
+ * Constant time, the sum is kept as samples come in.
+ * 
+ * @return average of the last K battery samples in ADC counts.
+*/
+float CONTROL_ATTR Battery_Voltage() {
+  return (float)battery_mon.sum / K;
+}
+
+/*
+  BATTERY MONITORING FUNCTIONS
+*/
+
+/**
+ * @brief Take one battery sample.
+ * 
+ * Filtering of size K is used, such that readings are 
+ * stored on an array of size K and the average of the
+ * array is taken as the output value.
+ * 
+ * @return the raw reading.
+*/
+uint16_t Sample_Battery() {
+  uint16_t reading = analogRead(battery);
+  battery_mon.sum += reading - battery_mon.readings[battery_mon.idx];
+  battery_mon.readings[battery_mon.idx] = reading;
+  battery_mon.idx = (battery_mon.idx + 1) % K;
+  battery_mon.average = Battery_Voltage();
+  return reading;
+}
+
+/**
+ * @brief Animate pairing message on connected OLED display.
+ * 
+ * Prints to the OLED display "Waiting to pair"
+ * followed by an amount of periods equal to the passed in 
+ * phase value.
+ * 
+ * @param phase The input phase (0-3)
+*/
+void Waiting_To_Pair(int phase) {
+	lcd.clearDisplay();
+	lcd.setCursor(0, 54);
+	switch (phase) {
+		case 0:
+			lcd.print("Waiting to pair");
+			break;
+		case 1:
+			lcd.print("Waiting to pair.");
+			break;
+		case 2:
+			lcd.print("Waiting to pair..");
+			break;
+		case 3:
+			lcd.print("Waiting to pair...");
+			break;
+	}
+  display_busy = true;
+	Trace_Begin(TRACE_DISPLAY);
+	lcd.display();
+	Trace_End(TRACE_DISPLAY);
+  display_busy = false;
+}
+
+/*
+  ANIMATIONS FUNCTIONS
+*/
+
+// Movement States
+bool crouched = false;
+
+// Start times of the multi-beat actions, in millis()
+struct Action_Timers {
+  uint32_t back_recovery;
+  uint32_t front_recovery;
+  uint32_t behold;
+  uint32_t dust_off;
+};
+
+Action_Timers timers;
+
+// Mirroring
+
+/**
+ * @brief Map a joint to its counterpart on the other side.
+*/
+constexpr int Mirror_Joint(int j) {
+  return (j == rs) ? ls : (j == ls) ? rs :
+         (j == rb) ? lb : (j == lb) ? rb :
+         (j == rh) ? lh : (j == lh) ? rh :
+         (j == rf) ? lf : (j == lf) ? rf : j;
+}
+
+/**
+ * @brief Compile-time side selector for mirrored actions.
+ * 
+ * Mirrored actions are written once from the right side's
+ * point of view. Side<true> remaps every joint to its left
+ * counterpart and flips the sign of every offset, since the
+ * left servos (and the waist direction) are mirrored.
+ * 
+ * TRIM indexes the per-side trim tables, { right, left }, for
+ * the few moves that are deliberately asymmetric.
+*/
+template <bool MIRRORED>
+struct Side {
+  static constexpr bool MIRROR = MIRRORED;
+  static constexpr int J(int j) { return MIRRORED ? Mirror_Joint(j) : j; }
+  static constexpr int D(int d) { return MIRRORED ? -d : d; }
+  static constexpr int TRIM = MIRRORED ? 1 : 0;
+};
+
+typedef Side<false> Right_Side;
+typedef Side<true> Left_Side;
+
+/**
+ * @brief Write a pose offset through a side's mirroring.
+ * 
+ * @param pose base pose table.
+ * @param j joint, as seen from the right side.
+ * @param d offset, as seen from the right side.
+*/
+template <class S>
+inline void CONTROL_ATTR Write_Offset(const int* pose, int j, int d) {
+  joints[S::J(j)].write(pose[S::J(j)] + S::D(d));
+}
+
+// Locomotion Functions
+
+/**
+ * @brief Run one tick of a gait through a side's mirroring.
+ * 
+ * Writes every joint, the gait's offsets on top of the base pose
+ * and the base pose for the rest of the body. See gait.h.
+ * 
+ * @param g gait shape, as seen from the right side.
+ * @param base pose table the gait runs on.
+*/
+template <class S>
+void CONTROL_ATTR Run_Gait(const Gait_Shape& g, const int* base) {
+  int pose[9];
+  Gait_Pose<S::MIRROR>(g, base, millis(), pose);
+  for (int i = 0; i < 9; i++) joints[i].write(pose[i]);
+}
+
+/**
+ * @brief Turn in place via legs.
+ * 
+ * Turn in place via a two beat pattern. 
+ * 
+ * First beat raises the body via the feet 
+ * and returns the waist to the original 
+ * position. 
+ * 
+ * Second beat lowers the body to the default
+ * position while turning the waist towards
+ * the side.
+ * 
+ * @param spd The speed in milliseconds to cycle 
+ * through all the phases.
+*/
+template <class S>
+void CONTROL_ATTR Turn(int spd) {
+  Run_Gait<S>(Gait_Turn(spd, params.turn_split, params.turn_lift, params.turn_waist), params.gaucho_pos);
+}
+
+/**
+ * @brief Turn left via legs.
+ * 
+ * @param spd The speed in milliseconds to cycle 
+ * through all the phases.
+*/
+void CONTROL_ATTR Left(int spd) {
+  action = ACT_LEFT;
+  Turn<Left_Side>(spd);
+}
+
+/**
+ * @brief Turn right via legs.
+ * 
+ * @param spd The speed in milliseconds to cycle 
+ * through all the phases.
+*/
+void CONTROL_ATTR Right(int spd) {
+  action = ACT_RIGHT;
+  Turn<Right_Side>(spd);
+}
+
+/**
+ * @brief Move sideways via legs.
+ * 
+ * Move towards the side via a two beat pattern.
+ * 
+ * First beat moves the opposite hip and foot
+ * outward and upward, thrusting the body towards
+ * the side. The near hip and foot are extended
+ * outward as well but to stabilize the body.
+ * 
+ * Second beat returns the body to default position.
+ * 
+ * @param spd The speed in milliseconds to cycle 
+ * through all the phases.
+*/
+template <class S>
+void CONTROL_ATTR Sidestep(int spd) {
+  Run_Gait<S>(Gait_Sidestep(spd, params.sidestep_split, params.sidestep_reach), params.std_pos);
+}
+
+/**
+ * @brief Move left via legs.
+ * 
+ * @param spd The speed in milliseconds to cycle 
+ * through all the phases.
+*/
+void CONTROL_ATTR Sidestep_Left(int spd) {
+  action = ACT_SIDESTEP_LEFT;
+  Sidestep<Left_Side>(spd);
+}
+
+/**
+ * @brief Move right via legs.
+ * 
+ * @param spd The speed in milliseconds to cycle 
+ * through all the phases.
+*/
+void CONTROL_ATTR Sidestep_Right(int spd) {
+  action = ACT_SIDESTEP_RIGHT;
+  Sidestep<Right_Side>(spd);
+}
+
+/**
+ * @brief Move forward via legs.
+ * 
+ * Move forward via a two beat pattern.
+ * 
+ * First beat shifts the center of mass towards the left
+ * via the feet, then rotates the waist left.
+ * 
+ * Second beat shifts the center of mass towards the right
+ * via the feet,  then rotates the waist right.
+ * 
+ * Thus forward movement is achieved by turning the waist
+ * towards where the center of mass is currently shifted to.
+ * 
+ * @param spd The speed in milliseconds to cycle 
+ * through all the phases.
+*/
+void CONTROL_ATTR Forward(int spd) {
+  action = ACT_FORWARD;
+  Run_Gait<Right_Side>(Gait_Walk(spd, params.forward_split, params.forward_foot, params.forward_waist, +1), params.std_pos);
+}
+
+/**
+ * @brief Move backward via legs.
+ * 
+ * Move backward via a two beat pattern.
+ * 
+ * First beat shifts the center of mass towards the left
+ * via the feet, then rotates the waist right.
+ * 
+ * Second beat shifts the center of mass towards the right
+ * via the feet,  then rotates the waist left.
+ * 
+ * Thus backward movement is achieved by turning the waist
+ * away from where the center of mass is currently shifted to.
+ * 
+ * @param spd The speed in milliseconds to cycle 
+ * through all the phases.
+*/
+void CONTROL_ATTR Backward(int spd) {
+  action = ACT_BACKWARD;
+  Run_Gait<Right_Side>(Gait_Walk(spd, params.forward_split, params.forward_foot, params.forward_waist, -1), params.std_pos);
+}
+
+/**
+ * @brief Fix the rest of body excluding used servos.
+ * 
+ * Takes a In_Use function, which checks if the currently
+ * accessed servo is a used servo, if so returns true.
+ * 
+ * @param In_Use function to check if servo is in use.
+*/
+void CONTROL_ATTR Fix_Rest(bool (*In_Use)(int)) {
+  if (crouched) {
+			for (int i = 0; i < 9; i++) { 
+        if (!In_Use(i)) joints[i].write(params.crouch_pos[i]);
+      }
+  }
+  else {
+    for (int i = 0; i < 9; i++) {
+      if (!In_Use(i)) joints[i].write(params.gaucho_pos[i]);
+    }
+  }
+}
+
+bool CONTROL_ATTR In_Use_Idle(int i) { return false; }
+/**
+ * @brief Idle body
+ * 
+ * Set joints to resting position (depends on if crouched or not).
+*/
+void CONTROL_ATTR Idle() {
+  action = ACT_IDLE;
+  Fix_Rest(In_Use_Idle);
+}
+
+rampInt br_rs;
+rampInt br_ls;
+rampInt br_rb;
+rampInt br_lb;
+rampInt br_rh;
+rampInt br_lh;
+rampInt br_rf;
+rampInt br_lf;
+
+/**
+ * @brief Stand back up from lying on back
+ * 
+ * Four beat motion to stand up from.
+ * 
+ * First beat orients legs in a split.
+ * 
+ * Second beat swings biceps backward to push body forward.
+ * 
+ * Third beat brings arms down to further push body forward.
+ * 
+ * Final beat resets body to idle position.
+ * 
+ * @param spd The speed in milliseconds to complete the motion.
+*/
+void CONTROL_ATTR Back_Recovery(int spd) {
+  action = ACT_BACK_RECOVERY;
+  unsigned long curr_time = millis();
+  // Orient
+  if (curr_time < timers.back_recovery + (1*spd/4)) {
+    // Reset ramps
+    br_rs.go(params.gaucho_pos[rs]+30);
+    br_ls.go(params.gaucho_pos[ls]-30);
+    br_rb.go(params.gaucho_pos[rb]-145);
+    br_lb.go(params.gaucho_pos[lb]+145);
+    br_rh.go(params.gaucho_pos[rh]+50);
+    br_lh.go(params.gaucho_pos[lh]-50);
+    br_rf.go(params.gaucho_pos[rf]-80);
+    br_lf.go(params.gaucho_pos[lf]+80);
+
+    s_rs.write(params.gaucho_pos[rs]+105);
+    s_ls.write(params.gaucho_pos[ls]-105);
+    s_rf.write(params.gaucho_pos[rf]-80);
+    s_lf.write(params.gaucho_pos[lf]+80);
+    s_rh.write(params.gaucho_pos[rh]+50);
+    s_lh.write(params.gaucho_pos[lh]-50);
+    for (int i = 0; i < 9; i++) {
+      if (i != rs && i != ls && i != rf && i != lf && i != rh && i != lh) joints[i].write(params.gaucho_pos[i]);
+    }
+  }
+  // Swing biceps back
+  else if (curr_time < timers.back_recovery + (2*spd/4)) {
+    s_rs.write(params.gaucho_pos[rs]+105);
+    s_ls.write(params.gaucho_pos[ls]-105);
+    s_rb.write(params.gaucho_pos[rb]-145);
+    s_lb.write(params.gaucho_pos[lb]+145);
+
+    s_rs.write(params.gaucho_pos[rs]+105);
+    s_ls.write(params.gaucho_pos[ls]-105);
+    s_rf.write(params.gaucho_pos[rf]-80);
+    s_lf.write(params.gaucho_pos[lf]+80);
+    s_rh.write(params.gaucho_pos[rh]+50);
+    s_lh.write(params.gaucho_pos[lh]-50);
     
-    s_w.write(gaucho_pos[w]);
+    s_w.write(params.gaucho_pos[w]);
+  }
+  // Swing shoulders down
+  else if (curr_time < timers.back_recovery + (3*spd/4)) {
+    // Set ramp targets
+    br_rs.go(params.gaucho_pos[rs], 1000, LINEAR);
+    br_ls.go(params.gaucho_pos[ls], 1000, LINEAR);
+    br_rb.go(params.gaucho_pos[rb], 1000, LINEAR);
+    br_lb.go(params.gaucho_pos[lb], 1000, LINEAR);
+    br_rh.go(params.gaucho_pos[rh], 1000, LINEAR);
+    br_lh.go(params.gaucho_pos[lh], 1000, LINEAR);
+    br_rf.go(params.gaucho_pos[rf], 1000, LINEAR);
+    br_lf.go(params.gaucho_pos[lf], 1000, LINEAR);
+
+    s_rs.write(params.gaucho_pos[rs]+30);
+    s_ls.write(params.gaucho_pos[ls]-30);
+    s_rb.write(params.gaucho_pos[rb]-145);
+    s_lb.write(params.gaucho_pos[lb]+145);
+    
+    s_rs.write(params.gaucho_pos[rs]+105);
+    s_ls.write(params.gaucho_pos[ls]-105);
+    s_rf.write(params.gaucho_pos[rf]-80);
+    s_lf.write(params.gaucho_pos[lf]+80);
+    s_rh.write(params.gaucho_pos[rh]+50);
+    s_lh.write(params.gaucho_pos[lh]-50);
+    
+    s_w.write(params.gaucho_pos[w]);
+  }
+  // Ease into default stance
+  else {
+    s_rs.write(br_rs.update());
+    s_ls.write(br_ls.update());
+    s_rb.write(br_rb.update());
+    s_lb.write(br_lb.update());
+
+
+    s_rf.write(br_rf.update());
+    s_lf.write(br_lf.update());
+    s_rh.write(br_rh.update());
+    s_lh.write(br_lh.update());
+    
+    s_w.write(params.gaucho_pos[w]);
+  }
+}
+
+/**
+ * @brief Stand back up from lying on front
+ * 
+ * Four beat motion to stand up from.
+ * 
+ * First beat orients legs in a split.
+ * 
+ * Second beat swings biceps backward to push body backward.
+ * 
+ * Third beat brings arms down to further push body backward.
+ * 
+ * Final beat resets body to crouch position.
+ * 
+ * @param spd The speed in milliseconds to complete the motion.
+*/
+void CONTROL_ATTR Front_Recovery(int spd) {
+  action = ACT_FRONT_RECOVERY;
+  unsigned long curr_time = millis();
+  // Orient
+  if (curr_time < timers.front_recovery + (1*spd/4)) {
+    s_rs.write(params.gaucho_pos[rs]+105);
+    s_ls.write(params.gaucho_pos[ls]-105);
+    s_rf.write(params.gaucho_pos[rf]-80);
+    s_lf.write(params.gaucho_pos[lf]+80);
+    for (int i = 0; i < 9; i++) {
+      if (i != rs && i != ls && i != rf && i != lf) joints[i].write(params.gaucho_pos[i]);
+    }
+  }
+  // Swing biceps forward
+  else if (curr_time < timers.front_recovery + (2*spd/4)) {
+    s_rs.write(params.gaucho_pos[rs]+105);
+    s_ls.write(params.gaucho_pos[ls]-105);
+    s_rb.write(params.gaucho_pos[rb]+35);
+    s_lb.write(params.gaucho_pos[lb]-35);
+    for (int i = 0; i < 9; i++) {
+      if (i != rs && i != ls && i != rb && i != lb) joints[i].write(params.gaucho_pos[i]);
+    }
+  }
+  // Swing shoulders down
+  else if (curr_time < timers.front_recovery + (3*spd/4)) {
+    s_rs.write(params.gaucho_pos[rs]+30);
+    s_ls.write(params.gaucho_pos[ls]-30);
+    s_rb.write(params.gaucho_pos[rb]+35);
+    s_lb.write(params.gaucho_pos[lb]-35);
+    for (int i = 0; i < 9; i++) {
+      if (i != rs && i != ls && i != rb && i != lb) joints[i].write(params.gaucho_pos[i]);
+    }
+  }
+  // Return to crouch stance
+  else {
+    for (int i = 0; i < 9; i++) joints[i].write(params.crouch_pos[i]);
+  }
+}
+
+// Attacks
+
+template <class S>
+bool CONTROL_ATTR In_Use_Atk(int i) { return (i == S::J(rs) || i == S::J(rb) || i == w); }
+
+/**
+ * @brief Wide attack.
+ * 
+ * Extends arm out and swing it.
+*/
+template <class S>
+void CONTROL_ATTR Sweep() {
+  Write_Offset<S>(params.gaucho_pos, rs, +70);
+  Write_Offset<S>(params.gaucho_pos, rb, -55);
+  joints[w].write(params.gaucho_pos[w] + S::D(85) + params.sweep_w_trim[S::TRIM]);
+  Fix_Rest(In_Use_Atk<S>);
+}
+
+/**
+ * @brief Wide right attack.
+*/
+void CONTROL_ATTR Right_Sweep() {
+  action = ACT_RIGHT_SWEEP;
+  Sweep<Right_Side>();
+}
+
+/**
+ * @brief Wide left attack.
+*/
+void CONTROL_ATTR Left_Sweep() {
+  action = ACT_LEFT_SWEEP;
+  Sweep<Left_Side>();
+}
+
+/**
+ * @brief Low attack.
+ * 
+ * Swing arm outward (half of sweep) and arc it in a 90 degree angle.
+*/
+template <class S>
+void CONTROL_ATTR Hook() {
+  Write_Offset<S>(params.gaucho_pos, rs, +30);
+  Write_Offset<S>(params.gaucho_pos, rb, +35);
+  Write_Offset<S>(params.gaucho_pos, w, +90);
+  Fix_Rest(In_Use_Atk<S>);
+}
+
+/**
+ * @brief Low right attack.
+*/
+void CONTROL_ATTR Right_Hook() {
+  action = ACT_RIGHT_HOOK;
+  Hook<Right_Side>();
+}
+
+/**
+ * @brief Low left attack.
+*/
+void CONTROL_ATTR Left_Hook() {
+  action = ACT_LEFT_HOOK;
+  Hook<Left_Side>();
+}
+
+template <class S>
+bool CONTROL_ATTR In_Use_Shot(int i) { return (i == S::J(rs) || i == S::J(rb) || i == S::J(lb)); }
+
+/**
+ * @brief Side attack.
+ * 
+ * Extend arm out and swing it to the side, bracing with the other bicep.
+*/
+template <class S>
+void CONTROL_ATTR Shot() {
+  Write_Offset<S>(params.gaucho_pos, rs, +70);
+  Write_Offset<S>(params.gaucho_pos, rb, -55);
+  Write_Offset<S>(params.gaucho_pos, lb, -35);
+  Fix_Rest(In_Use_Shot<S>);
+}
+
+/**
+ * @brief Right side attack.
+*/
+void CONTROL_ATTR Right_Shot() {
+  action = ACT_RIGHT_SHOT;
+  Shot<Right_Side>();
+}
+
+/**
+ * @brief Left side attack.
+*/
+void CONTROL_ATTR Left_Shot() {
+  action = ACT_LEFT_SHOT;
+  Shot<Left_Side>();
+}
+
+// Taunts
+rampInt t1_rs;
+rampInt t1_rb;
+rampInt t1_ls;
+rampInt t1_lb;
+bool CONTROL_ATTR In_Use_t1(int i) { return (i == rs || i == rb || i == ls || i == lb); }
+/**
+ * @brief Taunt 1
+ * 
+ * Stretch arms, warming up for a battle.
+ * Blinks led blue.
+ * Toggles off crouch.
+*/
+void CONTROL_ATTR WARMING_UP() {
+  action = ACT_WARMING_UP;
+  crouched = false;
+  led_state = BLUE;
+  s_rs.write(t1_rs.update());
+  s_rb.write(t1_rb.update());
+  s_ls.write(t1_ls.update());
+  s_lb.write(t1_lb.update());
+  Fix_Rest(In_Use_t1);
+}
+
+rampInt t2_w;
+bool CONTROL_ATTR In_Use_t2_p1(int i) { return (i == rf || i == lf || i == rs || i == ls || i == rb || i == lb); }
+bool CONTROL_ATTR In_Use_t2_p2(int i) { return (i == rs || i == ls || i == w); }
+/**
+ * @brief Taunt 2
+ * 
+ * Raises body in the air before crashing down
+ * and stretching out arms while rotating waist 
+ * back and forth.
+ * Blinks led red
+ * Toggles off crouch.
+*/
+void CONTROL_ATTR BEHOLD() {
+  action = ACT_BEHOLD;
+  crouched = false;
+  led_state = RED;
+  if (millis() < timers.behold + 350) {
+    s_rf.write(params.gaucho_pos[rf]+20);
+    s_lf.write(params.gaucho_pos[lf]-20);
+    s_rs.write(params.gaucho_pos[rs]+70);
+    s_ls.write(params.gaucho_pos[ls]-70);
+    s_rb.write(params.gaucho_pos[rb]-55);
+    s_lb.write(params.gaucho_pos[lb]+55);
+    Fix_Rest(In_Use_t2_p1);
+  }
+  else {
+    s_rs.write(params.gaucho_pos[rs]+50);
+    s_ls.write(params.gaucho_pos[ls]-50);
+    s_w.write(t2_w.update());
+    Fix_Rest(In_Use_t2_p2);
+  }
+}
+
+rampInt t3_rb;
+rampInt t3_lb;
+bool CONTROL_ATTR In_Use_t3(int i) { return (i == rb || i == lb); }
+/**
+ * @brief Taunt 3
+ * 
+ * Raise fists up slowly then quickly shift them down.
+ * Turns led orange.
+ * Toggles off crouch.
+*/
+void CONTROL_ATTR DUST_OFF() {
+  action = ACT_DUST_OFF;
+  crouched = false;
+  led_state = ALL;
+  if (millis() < timers.dust_off + 500) {
+    s_rb.write(t3_rb.update());
+    s_lb.write(t3_lb.update());
+  }
+  else {
+    s_rb.write(params.gaucho_pos[rb]);
+    s_lb.write(params.gaucho_pos[lb]);
+  }
+  Fix_Rest(In_Use_t3);
+}
+
+bool CONTROL_ATTR In_Use_t4(int i) { return (i == rs || i == ls || i == rb || i == lb || i == w); }
+/**
+ * @brief Taunt 4
+ * 
+ * Beckon the opponent forward for a fight.
+ * Turns led turquoise.
+*/
+void CONTROL_ATTR GIVE_IT_YOUR_ALL() {
+  action = ACT_GIVE_IT_YOUR_ALL;
+  led_state = TURQUOISE;
+  s_rs.write(params.gaucho_pos[rs]+70);
+  s_ls.write(params.gaucho_pos[ls]-70);
+  s_rb.write(params.gaucho_pos[rb]-55);
+  s_lb.write(params.gaucho_pos[lb]-35);
+  s_w.write(params.gaucho_pos[w]+85);
+  Fix_Rest(In_Use_t4);
+}
+
+// LED Animations
+/**
+ * @brief Set led to purple.
+*/
+void Idle_Led() {
+  analogWrite(R, 255);
+  analogWrite(G, 0);
+  analogWrite(B, 255);
+}
+
+/**
+ * @brief Turn off led
+*/
+void Close_Led() {
+  analogWrite(R, 0);
+  analogWrite(G, 0);
+  analogWrite(B, 0);
+}
+
+/**
+ * @brief Glow animation state for one led color.
+ * 
+ * Each channel counts 0..2*max and back to 0, the output
+ * rising then falling over that cycle.
+*/
+struct Led_Glow {
+  uint32_t timeout;
+  uint16_t r;
+  uint16_t g;
+  uint16_t b;
+};
+
+/**
+ * @brief Every led animation's state.
+*/
+struct Led_Animations {
+  Led_Glow atk;
+  Led_Glow blue;
+  Led_Glow all;
+  Led_Glow turquoise;
+  uint32_t red_timeout;
+  uint8_t red_val;
+  uint32_t pairing_timeout;
+  uint16_t pairing_val;
+};
+
+Led_Animations leds = { {}, {}, {}, {}, 0, 255, 0, 0 };
+
+/**
+ * @brief Output level of a glow channel.
+*/
+unsigned Glow_Level(uint16_t val, unsigned max) {
+  return (val < max) ? val : ((max-1)*2)-val;
+}
+
+/**
+ * @brief Glows led a certain value.
+ * 
+ * @param glow animation state.
+ * @param r_max max value for R led [0,256], 0 leaves R off.
+ * @param g_max max value for G led [0,256], 0 leaves G off.
+ * @param b_max max value for B led [0,256], 0 leaves B off.
+*/
+void Glow_Led(Led_Glow& glow, unsigned r_max, unsigned g_max, unsigned b_max) {
+  unsigned long ms = millis();
+  if (ms > glow.timeout + 1) {
+    if (r_max) glow.r = (glow.r+1)%((r_max*2)+1);
+    if (g_max) glow.g = (glow.g+1)%((g_max*2)+1);
+    if (b_max) glow.b = (glow.b+1)%((b_max*2)+1);
+  }
+  analogWrite(R, r_max ? Glow_Level(glow.r, r_max) : 0);
+  analogWrite(G, g_max ? Glow_Level(glow.g, g_max) : 0);
+  analogWrite(B, b_max ? Glow_Level(glow.b, b_max) : 0);
+}
+
+/**
+ * @brief Glow led purple.
+*/
+void Atk_Led() { Glow_Led(leds.atk, 256, 0, 256); }
+
+/**
+ * @brief Glow led blue.
+*/
+void Blue_Led() { Glow_Led(leds.blue, 0, 0, 256); }
+
+/**
+ * @brief Blink led red.
+*/
+void Red_Led() {
+  unsigned long ms = millis();
+  if (ms > leds.red_timeout + 50) {
+    leds.red_val = 0;
+    leds.red_timeout = ms;
+  }
+  else leds.red_val = 255;
+  analogWrite(R, leds.red_val);
+  analogWrite(G, 0);
+  analogWrite(B, 0);
+}
+
+/**
+ * @brief Glow all colors of led.
+*/
+void All_Led() { Glow_Led(leds.all, 256, 256, 256); }
+
+/**
+ * @brief Glow led turquoise.
+ * 
+ * Green glows over blue held fully on, as it always has.
+*/
+void Turquoise_Led() {
+  Led_Glow& glow = leds.turquoise;
+  if (millis() > glow.timeout + 1) glow.g = (glow.g+1)%((256*2)+1);
+  analogWrite(R, 0);
+  analogWrite(G, Glow_Level(glow.g, 256));
+  analogWrite(B, 255);
+}
+
+/*
+  COMBO VARIABLES
+*/
+
+#define COMBO_MAX_INPUTS 4
+#define COMBO_MAX_STEPS 6
+#define COMBO_MAX_STATES 24
+// Button-down edges this close together form one chord
+#define COMBO_CHORD 40
+// The automaton forgets partial matches after this much silence
+#define COMBO_TIMEOUT 1000
+
+struct Combo_Step {
+  void (*act)();
+  uint16_t ms;
+};
+
+/**
+ * @brief A timed input sequence bound to a multi-step attack.
+ * 
+ * Each input is a chord of BTN_* bits that must go down together.
+ * The whole sequence has to be entered within window ms, after
+ * which the steps run back to back, each for its own duration.
+*/
+struct Combo {
+  const char* name;
+  uint32_t inputs[COMBO_MAX_INPUTS];
+  uint8_t input_count;
+  uint16_t window;
+  Combo_Step steps[COMBO_MAX_STEPS];
+  uint8_t step_count;
+};
+
+Combo combos[] = {
+  { "Triple_Strike", { BTN_R1, BTN_R1, BTN_R2 }, 3, 300,
+    { { Right_Hook, 120 }, { Left_Hook, 120 }, { Right_Sweep, 250 } }, 3 },
+  { "Mirror_Strike", { BTN_L1, BTN_L1, BTN_L2 }, 3, 300,
+    { { Left_Hook, 120 }, { Right_Hook, 120 }, { Left_Sweep, 250 } }, 3 },
+  { "Whirlwind", { BTN_R2, BTN_L2 }, 2, 250,
+    { { Right_Sweep, 200 }, { Left_Sweep, 200 }, { Right_Sweep, 200 } }, 3 },
+  { "Cross_Fire", { BTN_CIRCLE | BTN_SQUARE }, 1, COMBO_CHORD,
+    { { Right_Shot, 150 }, { Left_Shot, 150 }, { Right_Shot, 150 }, { Left_Shot, 150 } }, 4 }
+};
+
+#define COMBO_COUNT (sizeof(combos) / sizeof(combos[0]))
+
+// Trie over combo inputs with failure links, built by Compile_Combos().
+// State 0 is the root. Each state stores the edge that leads into it.
+uint8_t combo_state_count = 1;
+uint32_t combo_edge_symbol[COMBO_MAX_STATES];
+uint8_t combo_edge_parent[COMBO_MAX_STATES];
+uint8_t combo_depth[COMBO_MAX_STATES];
+uint8_t combo_fail[COMBO_MAX_STATES];
+int8_t combo_accept[COMBO_MAX_STATES];
+
+// Matcher state
+uint8_t combo_state = 0;
+uint8_t combo_prev_state = 0;
+uint32_t combo_last_symbol = 0;
+unsigned long combo_last_input = 0;
+unsigned long combo_input_ms[COMBO_MAX_INPUTS];
+uint8_t combo_input_idx = 0;
+
+// Running combo, -1 if none
+volatile int8_t combo_active = -1;
+unsigned long combo_start = 0;
+uint8_t combo_step = 0;
+
+struct Combo_Stats {
+  uint16_t count;
+  uint16_t last_span;
+  uint16_t min_span;
+  uint16_t max_span;
+  uint16_t max_late;
+};
+
+// Per combo: how many times it fired, the time taken to enter
+// it (first to last input) and the worst step start lateness
+Combo_Stats combo_stats[COMBO_COUNT];
+
+/*
+  COMBO FUNCTIONS
+*/
+
+/**
+ * @brief Follow one symbol through the combo automaton.
+ * 
+ * Falls back along failure links until some state accepts the
+ * symbol, so a mistyped input still leaves the longest usable
+ * suffix of the sequence matched.
+ * 
+ * @param state current state.
+ * @param symbol chord of BTN_* bits.
+ * @return next state.
+*/
+uint8_t CONTROL_ATTR Combo_Next(uint8_t state, uint32_t symbol) {
+  for (;;) {
+    for (uint8_t t = 1; t < combo_state_count; t++) {
+      if (combo_edge_parent[t] == state && combo_edge_symbol[t] == symbol) return t;
+    }
+    if (state == 0) return 0;
+    state = combo_fail[state];
+  }
+}
+
+/**
+ * @brief Build the combo automaton from the combos table.
+ * 
+ * Combos that do not fit in COMBO_MAX_STATES are left out.
+*/
+void Compile_Combos() {
+  combo_state_count = 1;
+  combo_accept[0] = -1;
+  for (uint8_t c = 0; c < COMBO_COUNT; c++) {
+    uint8_t state = 0;
+    for (uint8_t i = 0; i < combos[c].input_count; i++) {
+      uint8_t next = 0;
+      for (uint8_t t = 1; t < combo_state_count && !next; t++) {
+        if (combo_edge_parent[t] == state && combo_edge_symbol[t] == combos[c].inputs[i]) next = t;
+      }
+      if (!next) {
+        if (combo_state_count == COMBO_MAX_STATES) break;
+        next = combo_state_count++;
+        combo_edge_parent[next] = state;
+        combo_edge_symbol[next] = combos[c].inputs[i];
+        combo_depth[next] = i + 1;
+        combo_accept[next] = -1;
+      }
+      state = next;
+    }
+    if (state && combo_depth[state] == combos[c].input_count) combo_accept[state] = c;
+  }
+
+  // Failure links, shallowest states first
+  for (uint8_t d = 1; d <= COMBO_MAX_INPUTS; d++) {
+    for (uint8_t t = 1; t < combo_state_count; t++) {
+      if (combo_depth[t] != d) continue;
+      combo_fail[t] = (d == 1) ? 0 : Combo_Next(combo_fail[combo_edge_parent[t]], combo_edge_symbol[t]);
+    }
+  }
+}
+
+/**
+ * @brief Start running a combo's attack steps.
+ * 
+ * @param c combo index.
+ * @param span ms from the combo's first input to its last.
+*/
+void CONTROL_ATTR Start_Combo(uint8_t c, unsigned long span) {
+  Combo_Stats& stats = combo_stats[c];
+  stats.last_span = span;
+  if (stats.count == 0 || span < stats.min_span) stats.min_span = span;
+  if (span > stats.max_span) stats.max_span = span;
+  stats.count++;
+
+  combo_start = millis();
+  combo_step = 0;
+  combo_active = c;
+}
+
+/**
+ * @brief Feed button-down edges to the combo automaton.
+ * 
+ * Edges arriving within COMBO_CHORD ms of the previous input are
+ * folded into it as a chord. Starts the matched combo, if any.
+ * 
+ * @param pressed BTN_* bits that went down this packet.
+ * @param now current time in ms.
+*/
+void CONTROL_ATTR Combo_Input(uint32_t pressed, unsigned long now) {
+  if (now - combo_last_input > COMBO_TIMEOUT) combo_state = 0;
+
+  if (now - combo_last_input <= COMBO_CHORD && !(pressed & combo_last_symbol)) {
+    combo_last_symbol |= pressed;
+  }
+  else {
+    combo_prev_state = combo_state;
+    combo_last_symbol = pressed;
+    combo_last_input = now;
+    combo_input_ms[combo_input_idx++ % COMBO_MAX_INPUTS] = now;
+  }
+  combo_state = Combo_Next(combo_prev_state, combo_last_symbol);
+
+  for (uint8_t t = combo_state; t != 0; t = combo_fail[t]) {
+    int8_t c = combo_accept[t];
+    if (c < 0) continue;
+    unsigned long first = combo_input_ms[(uint8_t)(combo_input_idx - combos[c].input_count) % COMBO_MAX_INPUTS];
+    if (now - first > combos[c].window) continue;
+    Start_Combo(c, now - first);
+    combo_state = 0;
+    return;
+  }
+}
+
+/**
+ * @brief Drive the joints from the running combo.
+ * 
+ * Picks the step for the time elapsed since the combo started
+ * and ends the combo once every step has run.
+*/
+void CONTROL_ATTR Run_Combo() {
+  const Combo& c = combos[combo_active];
+  unsigned long elapsed = millis() - combo_start;
+  unsigned long step_start = 0;
+  for (uint8_t k = 0; k < c.step_count; k++) {
+    if (elapsed < step_start + c.steps[k].ms) {
+      if (k >= combo_step) {
+        uint16_t late = elapsed - step_start;
+        if (late > combo_stats[combo_active].max_late) combo_stats[combo_active].max_late = late;
+        combo_step = k + 1;
+      }
+      led_state = ATK;
+      c.steps[k].act();
+      return;
+    }
+    step_start += c.steps[k].ms;
+  }
+  combo_active = -1;
+}
+
+/*
+  MOTION PACK VARIABLES
+*/
+
+/**
+ * @brief The motion pack, read in place from the flash mapping.
+ *
+ * Nothing is copied out of flash: moves, keys and poses point
+ * straight into the mapped partition, so a pack costs this
+ * struct's worth of RAM whatever its size.
+*/
+struct Motion_Pack_State {
+  // NULL unless a valid pack is mapped
+  const Motion_Pack_Header* header;
+  const Motion_Pack_Move* moves;
+  const Motion_Pack_Key* keys;
+  const Motion_Pack_Pose* poses;
+  spi_flash_mmap_handle_t map;
+  Motion_Pack_Error status;
+  uint32_t partition_size;
+  // Mapping and validation at boot
+  uint32_t load_us;
+};
+
+Motion_Pack_State motion_pack = { NULL };
+
+// Running pack move, -1 if none
+volatile int16_t pack_active = -1;
+unsigned long pack_start = 0;
+
+/*
+  MOTION PACK FUNCTIONS
+*/
+
+/**
+ * @brief Map the motion partition and validate the pack in it.
+ *
+ * The whole partition is mapped once and stays mapped. A pack that
+ * fails its checks is unmapped again and the robot runs without
+ * one, see motion_pack.status.
+*/
+void Load_Motion_Pack() {
+  uint32_t start = micros();
+  motion_pack.status = MOTION_PACK_MISSING;
+  const esp_partition_t* part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+    (esp_partition_subtype_t)MOTION_PACK_SUBTYPE, MOTION_PACK_PARTITION);
+  const void* data;
+  if (part && esp_partition_mmap(part, 0, part->size, SPI_FLASH_MMAP_DATA, &data, &motion_pack.map) == ESP_OK) {
+    motion_pack.partition_size = part->size;
+    motion_pack.status = Motion_Pack_Check((const uint8_t*)data, part->size);
+    if (motion_pack.status == MOTION_PACK_OK) {
+      motion_pack.header = (const Motion_Pack_Header*)data;
+      motion_pack.moves = Motion_Pack_Moves(motion_pack.header);
+      motion_pack.keys = Motion_Pack_Keys(motion_pack.header);
+      motion_pack.poses = Motion_Pack_Poses(motion_pack.header);
+    }
+    else spi_flash_munmap(motion_pack.map);
+  }
+  motion_pack.load_us = micros() - start;
+}
+
+/**
+ * @brief Start the pack move bound to the chord now held, if any.
+ *
+ * A move starts on the button-down edge that completes its
+ * trigger chord, with nothing else held.
+ *
+ * @param pressed BTN_* bits that went down this packet.
+ * @param held BTN_* bits held this packet.
+*/
+void CONTROL_ATTR Pack_Input(uint32_t pressed, uint32_t held) {
+  if (!motion_pack.header) return;
+  for (int m = 0; m < motion_pack.header->move_count; m++) {
+    uint32_t trigger = motion_pack.moves[m].trigger;
+    if (held == trigger && (pressed & trigger)) {
+      pack_active = m;
+      pack_start = millis();
+      return;
+    }
+  }
+}
+
+/**
+ * @brief Pose table a pack move's offsets apply to.
+*/
+const int* CONTROL_ATTR Pack_Base(uint8_t base) {
+  switch (base) {
+    case MOTION_PACK_STD:
+      return params.std_pos;
+    case MOTION_PACK_GAUCHO:
+      return params.gaucho_pos;
+    case MOTION_PACK_CROUCH:
+      return params.crouch_pos;
+    default:
+      return crouched ? params.crouch_pos : params.gaucho_pos;
+  }
+}
+
+bool CONTROL_ATTR In_Use_Pack(int i) { return (motion_pack.moves[pack_active].mask >> i) & 1; }
+
+/**
+ * @brief Drive the joints from the running pack move.
+ *
+ * Holds the pose of the latest key whose beat has come, or eases
+ * towards the next one if it is flagged MOTION_PACK_LINEAR. Ends
+ * the move at its last key's beat.
+*/
+void CONTROL_ATTR Run_Pack_Move() {
+  const Motion_Pack_Move& move = motion_pack.moves[pack_active];
+  const Motion_Pack_Key* keys = motion_pack.keys + move.first_key;
+  unsigned long t = millis() - pack_start;
+  int last = move.key_count - 1;
+  if (t >= keys[last].ms) {
+    pack_active = -1;
+    return;
+  }
+
+  action = ACT_PACK_MOVE;
+  led_state = ATK;
+  int k = 0;
+  while (k < last && keys[k + 1].ms <= t) k++;
+  const int8_t* from = motion_pack.poses[keys[k].pose].offset;
+  bool ease = k < last && (keys[k + 1].flags & MOTION_PACK_LINEAR);
+  const int8_t* to = ease ? motion_pack.poses[keys[k + 1].pose].offset : from;
+  long span = ease ? keys[k + 1].ms - keys[k].ms : 1;
+  long into = ease ? (long)(t - keys[k].ms) : 0;
+  const int* base = Pack_Base(move.base);
+  for (int i = 0; i < 9; i++) {
+    if ((move.mask >> i) & 1) joints[i].write(base[i] + from[i] + (to[i] - from[i]) * into / span);
+  }
+  Fix_Rest(In_Use_Pack);
+}
+
+/*
+  STICK SHAPING VARIABLES
+*/
+
+struct Stick_Shaper {
+  // Filter state per axis, lx ly rx ry, in 1/256 counts
+  int32_t filter[4];
+  // Per stick, whether it was outside the deadzone last packet
+  bool moving[2];
+  uint8_t gait;
+
+  // Follow latency: how long the shaped gait takes to catch up
+  // with the gait the raw sticks ask for
+  bool pending;
+  uint8_t pending_gait;
+  uint32_t pending_us;
+  uint32_t follows;
+  uint32_t follow_sum_us;
+  uint32_t follow_max_us;
+  // Raw gait flips that reverted before the shaped gait followed
+  uint32_t suppressed;
+};
+
+Stick_Shaper shaper;
+
+/*
+  STICK SHAPING FUNCTIONS
+*/
+
+/**
+ * @brief Filter and shape both sticks and pick the gait.
+ * 
+ * Also times how far the shaped gait lags the unfiltered one,
+ * which is the latency this stage adds.
+ * 
+ * @param out shaped lx, ly, rx, ry.
+ * @param now_us arrival time of the packet.
+ * @return gait to run.
+*/
+uint8_t CONTROL_ATTR Shape_Sticks(int lx, int ly, int rx, int ry, int* out, uint32_t now_us) {
+  const int raw[4] = { lx, ly, rx, ry };
+  int direct[4];
+  int deadzone_sq = params.stick_deadzone * params.stick_deadzone;
+
+  for (int s = 0; s < 2; s++) {
+    int x = raw[2*s];
+    int y = raw[2*s + 1];
+    bool moving = x * x + y * y > deadzone_sq;
+    // At rest and on leaving it the filter follows the stick exactly
+    if (!moving || !shaper.moving[s]) {
+      shaper.filter[2*s] = x * 256;
+      shaper.filter[2*s + 1] = y * 256;
+    }
+    shaper.moving[s] = moving;
+
+    direct[2*s] = x;
+    direct[2*s + 1] = y;
+    Stick_Shape(direct[2*s], direct[2*s + 1], params.stick_deadzone, params.stick_expo);
+
+    out[2*s] = Stick_Filter(shaper.filter[2*s], x, params.stick_filter);
+    out[2*s + 1] = Stick_Filter(shaper.filter[2*s + 1], y, params.stick_filter);
+    Stick_Shape(out[2*s], out[2*s + 1], params.stick_deadzone, params.stick_expo);
+  }
+
+  uint8_t wanted = Stick_Select_Gait(GAIT_NONE, direct[0], direct[1], direct[2], direct[3], 0);
+  uint8_t gait = Stick_Select_Gait(shaper.gait, out[0], out[1], out[2], out[3], params.gait_hysteresis);
+
+  if (wanted != gait) {
+    if (!shaper.pending || shaper.pending_gait != wanted) {
+      shaper.pending = true;
+      shaper.pending_gait = wanted;
+      shaper.pending_us = now_us;
+    }
+  }
+  else if (shaper.pending) {
+    if (gait != shaper.gait) {
+      uint32_t lag = now_us - shaper.pending_us;
+      shaper.follows++;
+      shaper.follow_sum_us += lag;
+      if (lag > shaper.follow_max_us) shaper.follow_max_us = lag;
+    }
+    else shaper.suppressed++;
+    shaper.pending = false;
+  }
+
+  shaper.gait = gait;
+  return gait;
+}
+
+/*
+  CHECKPOINT VARIABLES
+*/
+
+#define CHECKPOINT_MAGIC 0x54504B43UL  // "CKPT"
+// A run that keeps checkpointing this long, in ms, counts as stable.
+// Warm restarts that keep coming back before then fall back to a
+// cold boot after WARM_STREAK_MAX, so a pose that browns the supply
+// out is not resumed forever.
+#define WARM_STABLE_MS 1000
+#define WARM_STREAK_MAX 3
+
+/**
+ * @brief What a warm restart resumes from.
+ * 
+ * RTC slow memory keeps its contents through every reset short of
+ * losing power. The two slots are written in turn and each carries
+ * its own check, so a reset in the middle of a write still leaves
+ * the other one to resume from.
+*/
+struct Checkpoint {
+  uint32_t magic;
+  uint32_t seq;
+  // Angles last written to the servos
+  int16_t pose[9];
+  // Filtered battery reading, ADC counts
+  uint16_t battery_avg;
+  uint8_t action;
+  uint8_t crouched;
+  uint8_t pad_linked;
+  // Warm restarts since the last stable run
+  uint8_t streak;
+  uint32_t warm_boots;
+  uint32_t check;
+};
+
+RTC_NOINIT_ATTR Checkpoint checkpoints[2];
+
+const char* const reset_names[] = { "unknown", "poweron", "ext", "sw", "panic", "int_wdt", "task_wdt", "wdt", "deepsleep", "brownout", "sdio" };
+
+struct Warm_State {
+  // This boot resumed from a checkpoint
+  bool warm;
+  uint8_t reason;
+  // What the checkpoint had running
+  uint8_t from_action;
+  uint8_t from_pad;
+  uint8_t streak;
+  // Sequence number of the next checkpoint
+  uint32_t seq;
+  // Checkpoints written since boot, and when the first one was
+  uint32_t saved;
+  uint32_t first_ms;
+  uint32_t warm_boots;
+};
+
+Warm_State warm_state;
+
+/*
+  CHECKPOINT FUNCTIONS
+*/
+
+/**
+ * @brief Rotate-xor over every word ahead of the check itself.
+*/
+uint32_t CONTROL_ATTR Checkpoint_Check(const Checkpoint& c) {
+  const uint32_t* words = (const uint32_t*)&c;
+  uint32_t sum = 0x9E3779B9UL;
+  for (size_t i = 0; i < offsetof(Checkpoint, check) / 4; i++) sum = ((sum << 5) | (sum >> 27)) ^ words[i];
+  return sum;
+}
+
+/**
+ * @brief Write the state a warm restart resumes from.
+ * 
+ * Called at the end of every control tick, without the control
+ * lock: a pose read half way through a commit is one the servos
+ * pass through anyway. Nothing is saved until soft start is over,
+ * so a brownout while the servos come up boots cold.
+*/
+void CONTROL_ATTR Checkpoint_Save() {
+  if (soft_start) return;
+  Checkpoint& c = checkpoints[warm_state.seq & 1];
+  c.magic = CHECKPOINT_MAGIC;
+  c.seq = warm_state.seq++;
+  for (int i = 0; i < 9; i++) c.pose[i] = joint_out[i];
+  c.battery_avg = battery_mon.average;
+  c.action = action;
+  c.crouched = crouched;
+  c.pad_linked = Ps3.isConnected();
+  uint32_t now = millis();
+  if (!warm_state.saved++) warm_state.first_ms = now;
+  c.streak = now - warm_state.first_ms < WARM_STABLE_MS ? warm_state.streak : 0;
+  c.warm_boots = warm_state.warm_boots;
+  c.check = Checkpoint_Check(c);
+}
+
+/**
+ * @brief Newest checkpoint slot that passes its check.
+ * 
+ * @return the slot, NULL if neither holds a usable checkpoint.
+*/
+const Checkpoint* Checkpoint_Load() {
+  const Checkpoint* best = NULL;
+  for (int s = 0; s < 2; s++) {
+    const Checkpoint& c = checkpoints[s];
+    if (c.magic != CHECKPOINT_MAGIC || c.check != Checkpoint_Check(c) || c.action >= ACT_COUNT) continue;
+    bool in_range = true;
+    for (int i = 0; i < 9; i++) {
+      if (c.pose[i] < 0 || c.pose[i] > 180) in_range = false;
+    }
+    if (in_range && (best == NULL || (int32_t)(c.seq - best->seq) > 0)) best = &c;
+  }
+  return best;
+}
+
+/**
+ * @brief Whether a reset is one to resume from.
+ * 
+ * Brownouts, panics and watchdogs were not asked for. Power-on,
+ * the reset pin and software restarts boot cold.
+*/
+bool Warm_Reset(esp_reset_reason_t reason) {
+  switch (reason) {
+    case ESP_RST_BROWNOUT:
+    case ESP_RST_PANIC:
+    case ESP_RST_INT_WDT:
+    case ESP_RST_TASK_WDT:
+    case ESP_RST_WDT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/**
+ * @brief Resume from the last checkpoint after an unexpected reset.
+ * 
+ * Every servo is attached at once and written the checkpointed
+ * pose, skipping soft start, so the robot holds where it was
+ * instead of slumping and ramping back up from center. Crouch and
+ * the battery filter carry over. A timed action cannot pick up
+ * part way, its timers are gone, so the pose it had reached is held
+ * as idle until the pad is back and the driver takes over.
+ * 
+ * @return whether the boot is warm. A cold boot clears the
+ * checkpoints, which may be left over from an earlier run.
+*/
+bool Warm_Boot() {
+  esp_reset_reason_t reason = esp_reset_reason();
+  warm_state.reason = reason;
+  const Checkpoint* c = Warm_Reset(reason) ? Checkpoint_Load() : NULL;
+  if (c == NULL || c->streak >= WARM_STREAK_MAX) {
+    memset(checkpoints, 0, sizeof(checkpoints));
+    return false;
+  }
+
+  warm_state.warm = true;
+  warm_state.from_action = c->action;
+  warm_state.from_pad = c->pad_linked;
+  warm_state.streak = c->streak + 1;
+  warm_state.warm_boots = c->warm_boots + 1;
+  warm_state.seq = c->seq + 1;
+
+  action = ACT_IDLE;
+  crouched = c->crouched;
+  for (int i = 0; i < K; i++) battery_mon.readings[i] = c->battery_avg;
+  battery_mon.sum = (uint32_t)c->battery_avg * K;
+  battery_mon.average = c->battery_avg;
+  for (int i = 0; i < 9; i++) {
+    joint_cmd[i] = joint_out[i] = c->pose[i];
+    Servo_Attach(i, c->pose[i]);
+  }
+  joints_attached = 9;
+  soft_start = false;
+  Boot_Mark(BOOT_SERVOS);
+  return true;
+}
+
+/*
+  CONTROL TASK VARIABLES
+*/
+
+#define CONTROL_TICK 5
+// Drop to the idle rate after this long with no input, in ms
+#define RATE_IDLE_AFTER 1000
+
+TaskHandle_t control_task = NULL;
+
+enum Control_Rate {
+  RATE_FAST,
+  RATE_NORMAL,
+  RATE_IDLE,
+  RATE_COUNT
+};
+
+const char* const rate_names[RATE_COUNT] = { "fast", "normal", "idle" };
+// Control task period per rate, in ms
+const uint8_t rate_periods[RATE_COUNT] = { 2, CONTROL_TICK, 20 };
+
+/**
+ * @brief Control task cadence.
+ * 
+ * The task picks its own rate every tick. notify() may only
+ * promote it, waking the task at once on an input edge.
+*/
+struct Rate_State {
+  // Rate the task is sleeping at
+  volatile uint8_t rate;
+  // Set by notify(), the next tick comes early
+  volatile bool promoted;
+  // Rate of the tick the current wait started from
+  uint8_t tick_rate;
+  // Last packet with a button held or a stick deflected
+  volatile uint32_t input_ms;
+  uint32_t last_tick_us;
+  uint32_t promotions;
+  uint64_t resident_us[RATE_COUNT];
+  uint32_t ticks[RATE_COUNT];
+  uint64_t tick_cycles[RATE_COUNT];
+};
+
+Rate_State control_rate = { RATE_NORMAL, false, RATE_NORMAL };
+
+/*
+  CONTROL TASK FUNCTIONS
+*/
+
+/*
+  LINK VARIABLES
+*/
+
+
+// Controller drops, timed from the disconnect callback to the first
+// packet handled after reconnecting
+struct Link_Stats {
+  uint32_t drops;
+  uint32_t restores;
+  uint32_t last_us;
+  // Drop to connect callback, for the last drop
+  uint32_t connect_us;
+  uint32_t min_us;
+  uint32_t max_us;
+  // Smoothed interval between controller packets
+  uint32_t interval_us;
+};
+
+Link_Stats link_stats;
+// micros() at the last drop, 0 once control is restored
+volatile uint32_t link_drop_us = 0;
+volatile bool link_report_pending = false;
+// Whether loop() last saw the pad connected
+bool link_up = false;
+
+/*
+  LINK FUNCTIONS
+*/
+
+/**
+ * @brief Close out a drop on the first packet after reconnecting.
+*/
+void Link_Restored(uint32_t now_us) {
+  uint32_t us = now_us - link_drop_us;
+  link_drop_us = 0;
+  link_stats.restores++;
+  link_stats.last_us = us;
+  if (!link_stats.min_us || us < link_stats.min_us) link_stats.min_us = us;
+  if (us > link_stats.max_us) link_stats.max_us = us;
+  link_report_pending = true;
+}
+
+/**
+ * @brief Advance the pairing animation by one step.
+ * 
+ * The leds fade every step. The panel is only redrawn when the
+ * number of dots changes, a full flush costs about 25 ms.
+*/
+void Pairing_Step() {
+  unsigned long ms = millis();
+
+  if (ms > leds.pairing_timeout + 2) {
+    leds.pairing_val = (leds.pairing_val+1)%511;
+    leds.pairing_timeout = ms;
+  }
+
+  unsigned level = (leds.pairing_val < 256) ? leds.pairing_val : 510 - leds.pairing_val;
+  int phase = (level/17) % 4;
+  if (phase != pairing_phase) {
+    pairing_phase = phase;
+    Waiting_To_Pair(phase);
+  }
+  analogWrite(R, level);
+  analogWrite(B, level);
+}
+
+/*
+  DEADLINE MONITOR VARIABLES
+*/
+
+enum Deadline_Id {
+  DEADLINE_TICK,
+  DEADLINE_NOTIFY,
+  DEADLINE_LOOP,
+  DEADLINE_INPUT,
+  DEADLINE_COUNT
+};
+
+// Histogram bucket b counts samples below budget << (b - 2),
+// so buckets 0-3 are on time and 4-7 are overruns of 1x, 2x, 4x
+// and 8x or more the budget
+#define DEADLINE_BUCKETS 8
+
+// Consecutive overruns of a fallback monitor before the safe pose
+#define DEADLINE_SUSTAINED 4
+// No controller packet for this long while connected is starvation
+#define INPUT_TIMEOUT 250
+// Seconds the control task may go unfed before the chip resets
+#define CONTROL_WDT_S 2
+
+struct Deadline_Stats {
+  const char* name;
+  uint32_t budget_us;
+  // Whether a run of overruns here sends the robot to the safe pose
+  bool fallback;
+  uint32_t count;
+  uint32_t overruns;
+  uint32_t streak;
+  uint32_t hist[DEADLINE_BUCKETS];
+  // Worst sample and what the robot was doing when it happened
+  uint32_t max_us;
+  uint32_t max_ms;
+  uint8_t max_action;
+  bool max_display_busy;
+};
+
+// Each monitor has a single writer: the control task, the Bluetooth
+// task (notify and input) or loop()
+Deadline_Stats deadlines[DEADLINE_COUNT] = {
+  { "tick", 1000, true },
+  { "notify", 1000, true },
+  { "loop", 20000, false },
+  { "input", 50000, false },
+};
+
+enum Safe_Reason {
+  SAFE_NONE,
+  SAFE_OVERRUN,
+  SAFE_STARVED,
+  SAFE_DISCONNECTED,
+  SAFE_COUNT
+};
+
+const char* safe_reason_names[SAFE_COUNT] = { "none", "overrun", "starved", "disconnected" };
+
+volatile uint8_t safe_reason = SAFE_NONE;
+uint32_t safe_count[SAFE_COUNT];
+
+volatile unsigned long last_input_ms = 0;
+uint32_t last_input_us = 0;
+uint32_t tick_last_us = 0;
+
+/*
+  DEADLINE MONITOR FUNCTIONS
+*/
+
+/**
+ * @brief Record one sample against a monitor's budget.
+ * 
+ * @param id monitor.
+ * @param us duration, or lateness for the tick monitor.
+*/
+void CONTROL_ATTR Deadline_Record(int id, uint32_t us) {
+  Deadline_Stats& d = deadlines[id];
+  int b = 0;
+  uint32_t limit = d.budget_us >> 3;
+  while (b < DEADLINE_BUCKETS - 1 && us >= limit) {
+    b++;
+    limit <<= 1;
+  }
+  d.hist[b]++;
+  d.count++;
+
+  if (us > d.budget_us) {
+    d.overruns++;
+    d.streak++;
+  }
+  else d.streak = 0;
+
+  if (us > d.max_us) {
+    d.max_us = us;
+    d.max_ms = millis();
+    d.max_action = action;
+    d.max_display_busy = display_busy;
+  }
+}
+
+/**
+ * @brief Whether any fallback monitor is in a run of overruns.
+*/
+bool CONTROL_ATTR Deadline_Sustained() {
+  for (int i = 0; i < DEADLINE_COUNT; i++) {
+    if (deadlines[i].fallback && deadlines[i].streak >= DEADLINE_SUSTAINED) return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Drop everything and command the safe pose.
+ * 
+ * The crouch table is already a complete joint image, so this
+ * is a copy and a commit with no action logic in between.
+ * Caller holds the control lock.
+*/
+void CONTROL_ATTR Enter_Safe_Pose(Safe_Reason reason) {
+  safe_reason = reason;
+  safe_count[reason]++;
+  Trace_Instant(TRACE_SAFE_POSE, reason);
+  combo_active = -1;
+  pack_active = -1;
+  action = ACT_SAFE_POSE;
+  led_state = CLOSED;
+  for (int i = 0; i < 9; i++) joint_cmd[i] = params.crouch_pos[i];
+  Commit_Joints();
+}
+
+/**
+ * @brief Note the arrival of a controller packet.
+*/
+void CONTROL_ATTR Deadline_Input(uint32_t now_us) {
+  if (last_input_us) {
+    uint32_t dt = now_us - last_input_us;
+    Deadline_Record(DEADLINE_INPUT, dt);
+    link_stats.interval_us = (link_stats.interval_us * 7 + dt) / 8;
+  }
+  last_input_us = now_us;
+  last_input_ms = millis();
+}
+
+/**
+ * @brief Per-tick deadline check, run first thing in the control task.
+ * 
+ * Records the tick's deviation from its period, falls back to the
+ * safe pose on sustained overrun, input starvation or a dropped
+ * controller, and feeds
+ * the task watchdog. A control task that stops getting here for
+ * CONTROL_WDT_S seconds resets the chip.
+*/
+void CONTROL_ATTR Deadline_Tick() {
+  uint32_t now = micros();
+  // A promoted tick is early on purpose
+  if (tick_last_us && !control_rate.promoted) {
+    int32_t late = (int32_t)(now - tick_last_us) - (rate_periods[control_rate.tick_rate] + servo_pwm.slip_ms) * 1000;
+    Deadline_Record(DEADLINE_TICK, late < 0 ? -late : late);
+  }
+  tick_last_us = now;
+
+  if (safe_reason == SAFE_NONE) {
+    Safe_Reason reason = SAFE_NONE;
+    if (Deadline_Sustained()) reason = SAFE_OVERRUN;
+    // Once the pad drops, let a running combo or pack move play out first
+    else if (!Ps3.isConnected()) {
+      if (link_drop_us && combo_active < 0 && pack_active < 0) reason = SAFE_DISCONNECTED;
+    }
+    else if (millis() - last_input_ms > INPUT_TIMEOUT) reason = SAFE_STARVED;
+    if (reason != SAFE_NONE) {
+      xSemaphoreTake(control_lock, portMAX_DELAY);
+      servo_pwm.source = SERVO_TICK;
+      Enter_Safe_Pose(reason);
+      servo_pwm.source = SERVO_PACKET;
+      xSemaphoreGive(control_lock);
+    }
+  }
+
+  esp_task_wdt_reset();
+}
+
+/**
+ * @brief Attach the next servo when its slot comes up and advance the ramps.
+*/
+void Soft_Start_Tick() {
+  xSemaphoreTake(control_lock, portMAX_DELAY);
+  unsigned long now = millis();
+  if (joints_attached < 9 && (joints_attached == 0 || now - joint_attach_ms[servo_start_order[joints_attached - 1]] >= SERVO_STAGGER)) {
+    int i = servo_start_order[joints_attached];
+    Servo_Attach(i, SERVO_CENTER);
+    joint_attach_ms[i] = now;
+    joints_attached++;
+  }
+  servo_pwm.source = SERVO_TICK;
+  Commit_Joints();
+  servo_pwm.source = SERVO_PACKET;
+  xSemaphoreGive(control_lock);
+}
+
+/**
+ * @brief Pick the control task's next rate.
+ * 
+ * Fast only while a combo or pack move runs, the only work
+ * Control_Tick() does between packets. Every other action is
+ * evaluated in notify() at the packet rate, so ticking faster
+ * through it would only add wakeups. Idle once the robot has been
+ * idle with no button held and the sticks at rest for
+ * RATE_IDLE_AFTER ms. Normal otherwise.
+*/
+uint8_t CONTROL_ATTR Rate_Select() {
+  uint32_t now = millis();
+  if (soft_start) return RATE_NORMAL;
+  if (combo_active >= 0 || pack_active >= 0) return RATE_FAST;
+  if (action == ACT_IDLE && now - control_rate.input_ms >= RATE_IDLE_AFTER) return RATE_IDLE;
+  return RATE_NORMAL;
+}
+
+/**
+ * @brief Note a controller packet, promoting the rate on an edge.
+ * 
+ * Called from notify(). A button going down, or the sticks leaving
+ * rest while idle, wakes the control task at once instead of
+ * waiting out an idle period, so a combo or pack move the packet
+ * starts gets the fast rate from its first step.
+ * 
+ * @param pressed BTN_* bits that went down this packet.
+ * @param held BTN_* bits held this packet.
+ * @param gait gait the sticks asked for.
+*/
+void CONTROL_ATTR Rate_Input(uint32_t pressed, uint32_t held, uint8_t gait) {
+  bool active = held || gait != GAIT_NONE;
+  if (active) control_rate.input_ms = millis();
+  bool edge = pressed || (active && control_rate.rate == RATE_IDLE);
+  if (!edge || control_rate.rate == RATE_FAST) return;
+  control_rate.rate = RATE_FAST;
+  control_rate.promoted = true;
+  control_rate.promotions++;
+  if (control_task) xTaskNotifyGive(control_task);
+}
+
+/**
+ * @brief Control task period to wait next, in ms.
+ * 
+ * @return 0 when a promotion is pending and the tick is due now.
+*/
+uint32_t Control_Period() {
+  return control_rate.promoted ? 0 : rate_periods[control_rate.rate];
+}
+
+/**
+ * @brief Advance time-driven actions between controller packets.
+ * 
+ * notify() only runs when a packet arrives. Running combos and
+ * pack moves are also advanced here every tick, so their steps
+ * land on time whatever the Bluetooth packet timing. The tick
+ * then picks the period to the next one, see Rate_Select().
+*/
+void CONTROL_ATTR Control_Tick() {
+  Trace_Begin(TRACE_CONTROL_TICK);
+  uint32_t tick_cycles = ESP.getCycleCount();
+  if (!boot_us[BOOT_CONTROL]) Boot_Mark(BOOT_CONTROL);
+  Deadline_Tick();
+  control_rate.promoted = false;
+  if (soft_start) Soft_Start_Tick();
+  else if (!servo_pwm.aligned && Servo_Any_Digital()) Servo_Align(tick_last_us);
+  if (combo_active >= 0 || pack_active >= 0) {
+    Trace_Begin(TRACE_LOCK_WAIT);
+    xSemaphoreTake(control_lock, portMAX_DELAY);
+    Trace_End(TRACE_LOCK_WAIT);
+    servo_pwm.source = SERVO_TICK;
+    if (combo_active >= 0) {
+      Run_Combo();
+      Commit_Joints();
+    }
+    else if (pack_active >= 0) {
+      Run_Pack_Move();
+      Commit_Joints();
+    }
+    servo_pwm.source = SERVO_PACKET;
+    xSemaphoreGive(control_lock);
+  }
+
+  // Time since the last tick belongs to the rate it waited at
+  uint32_t now = micros();
+  uint8_t r = control_rate.tick_rate;
+  if (control_rate.last_tick_us) control_rate.resident_us[r] += now - control_rate.last_tick_us;
+  control_rate.last_tick_us = now;
+  control_rate.ticks[r]++;
+  control_rate.tick_cycles[r] += ESP.getCycleCount() - tick_cycles;
+  control_rate.tick_rate = control_rate.rate = Rate_Select();
+  Checkpoint_Save();
+  Trace_End(TRACE_CONTROL_TICK);
+}
+
+void Control_Task(void* arg) {
+  esp_task_wdt_add(NULL);
+  TickType_t wake = xTaskGetTickCount();
+  for (;;) {
+    TickType_t period = pdMS_TO_TICKS(Control_Period());
+    period += Servo_Frame_Lock(wake + period, period);
+    TickType_t elapsed = xTaskGetTickCount() - wake;
+    // Sleep out the period unless a promotion cuts it short; a
+    // notification left over from a promotion already served is
+    // not one
+    if (elapsed < period && ulTaskNotifyTake(pdTRUE, period - elapsed) && !control_rate.promoted) continue;
+    wake = control_rate.promoted ? xTaskGetTickCount() : wake + period;
+    Control_Tick();
+  }
+}
+
+/*
+  CONTROL PROFILE VARIABLES
+*/
+
+#define PROFILE_PERIOD 1000
+
+// Per profile class, see PROFILE_DISPLAY_IDLE/BUSY
+struct Control_Profile {
+  uint32_t samples[2];
+  uint64_t cycles[2];
+  uint32_t max_cycles[2];
+  uint32_t timeout;
+};
+
+Control_Profile profile;
+
+/**
+ * @brief Account one notify() call to the control profile.
+ * 
+ * @param cycles CPU cycles spent in the call.
+ * @param busy whether the display was being flushed.
+*/
+void CONTROL_ATTR Profile_Control(uint32_t cycles, bool busy) {
+  int c = busy ? PROFILE_DISPLAY_BUSY : PROFILE_DISPLAY_IDLE;
+  if (cycles > profile.max_cycles[c]) profile.max_cycles[c] = cycles;
+  profile.cycles[c] += cycles;
+  profile.samples[c]++;
+}
+
+/*
+  TELEMETRY VARIABLES
+*/
+
+#define TELEMETRY_PERIOD 20
+#define TELEMETRY_TX_BUFFER 1024
+
+struct Telemetry_State {
+  uint32_t timeout;
+  uint16_t seq;
+  // Frames and replies dropped because the TX buffer was full
+  uint32_t dropped;
+};
+
+Telemetry_State telemetry;
+
+// Execution time of the last notify() and loop() calls
+unsigned long notify_us = 0;
+unsigned long loop_us = 0;
+
+/*
+  TELEMETRY FUNCTIONS
+*/
+
+/**
+ * @brief Send one telemetry frame over serial.
+ * 
+ * Packs the current joint outputs, action, led state, filtered
+ * battery and loop timing into a Telemetry_Frame, COBS encodes
+ * it and hands it to the UART driver's TX ring buffer. Never
+ * blocks: if the ring buffer cannot take the whole frame, the
+ * frame is dropped and counted instead.
+*/
+void Send_Telemetry() {
+  Trace_Begin(TRACE_TELEMETRY);
+  Telemetry_Frame frame;
+  frame.type = TELEMETRY_TICK;
+  frame.version = TELEMETRY_VERSION;
+  frame.seq = telemetry.seq++;
+  frame.ms = millis();
+  for (int i = 0; i < 9; i++) frame.joints[i] = joint_out[i];
+  frame.action = action;
+  frame.led_state = led_state;
+  frame.flags = (crouched ? TELEMETRY_CROUCHED : 0) | (Ps3.isConnected() ? TELEMETRY_CONNECTED : 0);
+  frame.battery_avg = Battery_Voltage();
+  frame.loop_us = min(loop_us, 0xFFFFUL);
+  frame.notify_us = min(notify_us, 0xFFFFUL);
+  frame.checksum = Telemetry_Checksum((const uint8_t*)&frame, sizeof(frame) - 1);
+
+  uint8_t encoded[TELEMETRY_MAX_ENCODED];
+  size_t len = Cobs_Encode((const uint8_t*)&frame, sizeof(frame), encoded);
+  if (Serial.availableForWrite() >= (int)len) Serial.write(encoded, len);
+  else telemetry.dropped++;
+  Trace_End(TRACE_TELEMETRY);
+}
+
+/**
+ * @brief Send the control profile over serial and start a new window.
+*/
+void Send_Profile() {
+  Profile_Frame frame;
+  frame.type = TELEMETRY_PROFILE;
+  frame.version = TELEMETRY_VERSION;
+  frame.ms = millis();
+#ifdef CONTROL_IN_IRAM
+  frame.iram = 1;
+#else
+  frame.iram = 0;
+#endif
+  for (int c = 0; c < 2; c++) {
+    frame.samples[c] = profile.samples[c];
+    frame.mean_cycles[c] = profile.samples[c] ? profile.cycles[c] / profile.samples[c] : 0;
+    frame.max_cycles[c] = profile.max_cycles[c];
+    profile.samples[c] = 0;
+    profile.cycles[c] = 0;
+    profile.max_cycles[c] = 0;
+  }
+  frame.checksum = Telemetry_Checksum((const uint8_t*)&frame, sizeof(frame) - 1);
+
+  uint8_t encoded[sizeof(Profile_Frame) + 2];
+  size_t len = Cobs_Encode((const uint8_t*)&frame, sizeof(frame), encoded);
+  if (Serial.availableForWrite() >= (int)len) Serial.write(encoded, len);
+  else telemetry.dropped++;
+}
+
+/*
+  RECORDER VARIABLES
+*/
+
+#define RECORDER_FILE "/match.bml"
+#define RECORDER_BUFFER 8192
+#define RECORDER_BLOCK 4096
+#define RECORDER_POLL 50
+
+enum Recorder_State {
+  REC_OFF,
+  REC_RECORDING,
+  REC_STOPPING,
+  REC_PLAYBACK
+};
+
+volatile enum Recorder_State recorder_state = REC_OFF;
+bool recorder_fs_ok = false;
+TaskHandle_t recorder_task = NULL;
+
+// Single producer (notify) / single consumer (recorder task) ring.
+// Head and tail count bytes and only ever increase.
+uint8_t recorder_ring[RECORDER_BUFFER];
+volatile uint32_t recorder_head = 0;
+volatile uint32_t recorder_tail = 0;
+unsigned long recorder_dropped = 0;
+
+// Encoder state, only touched by the producer
+int16_t recorder_pose[9];
+int8_t recorder_sticks[4];
+unsigned long recorder_last_ms = 0;
+bool recorder_keyframe = true;
+
+/*
+  RECORDER FUNCTIONS
+*/
+
+/**
+ * @brief Pack a PS3 button struct into BTN_* bits.
+ * 
+ * @param b button struct to pack.
+*/
+uint32_t CONTROL_ATTR Pack_Buttons(ps3_button_t b) {
+  uint32_t bits = 0;
+  if (b.select) bits |= BTN_SELECT;
+  if (b.l3) bits |= BTN_L3;
+  if (b.r3) bits |= BTN_R3;
+  if (b.start) bits |= BTN_START;
+  if (b.up) bits |= BTN_UP;
+  if (b.right) bits |= BTN_RIGHT;
+  if (b.down) bits |= BTN_DOWN;
+  if (b.left) bits |= BTN_LEFT;
+  if (b.l2) bits |= BTN_L2;
+  if (b.r2) bits |= BTN_R2;
+  if (b.l1) bits |= BTN_L1;
+  if (b.r1) bits |= BTN_R1;
+  if (b.triangle) bits |= BTN_TRIANGLE;
+  if (b.circle) bits |= BTN_CIRCLE;
+  if (b.cross) bits |= BTN_CROSS;
+  if (b.square) bits |= BTN_SQUARE;
+  if (b.ps) bits |= BTN_PS;
+  return bits;
+}
+
+/*
+  DISPATCH VARIABLES
+*/
+
+// Buttons the recorder owns, they can never be bound
+#define BIND_RESERVED (BTN_TRIANGLE | BTN_PS)
+
+/**
+ * @brief Which stick axis picks between a gait's two actions.
+ * 
+ * stick_bind[r][0] runs on a negative deflection of the axis,
+ * stick_bind[r][1] on a positive one.
+*/
+struct Stick_Rule {
+  uint8_t gait;
+  // Index into the shaped sticks, lx ly rx ry
+  uint8_t axis;
+};
+
+const Stick_Rule stick_rules[STICK_RULES] = {
+  { GAIT_WALK, 1 },
+  { GAIT_TURN, 0 },
+  { GAIT_SIDESTEP, 2 }
+};
+
+/**
+ * @brief Input bindings compiled for notify().
+ * 
+ * Bound buttons are ranked by priority, ties going to the lower
+ * button bit, rank 0 meaning none. lo_rank and hi_rank hold the
+ * best rank among any set of held buttons in the low 9 and high
+ * 8 bits of the mask, so the winning binding for a packet is two
+ * lookups and a max.
+*/
+struct Dispatch_Table {
+  uint8_t lo_rank[1 << 9];
+  uint8_t hi_rank[1 << (BTN_COUNT - 9)];
+  int8_t by_rank[BTN_COUNT + 1];
+  int8_t by_button[BTN_COUNT];
+  // Buttons with a binding
+  uint32_t bound;
+  // Buttons bound to a strike, see Strike_Eligible()
+  uint32_t strike;
+  int8_t stick[GAIT_SIDESTEP + 1][2];
+  uint8_t stick_axis[GAIT_SIDESTEP + 1];
+};
+
+Dispatch_Table dispatch;
+
+/*
+  DISPATCH FUNCTIONS
+*/
+
+/**
+ * @brief Evaluate one action with its configured speed.
+*/
+void CONTROL_ATTR Run_Action(int act) {
+  switch (act) {
+    case ACT_FORWARD: Forward(params.forward_spd); break;
+    case ACT_BACKWARD: Backward(params.backward_spd); break;
+    case ACT_LEFT: Left(params.turn_spd); break;
+    case ACT_RIGHT: Right(params.turn_spd); break;
+    case ACT_SIDESTEP_LEFT: Sidestep_Left(params.sidestep_spd); break;
+    case ACT_SIDESTEP_RIGHT: Sidestep_Right(params.sidestep_spd); break;
+    case ACT_RIGHT_SWEEP: Right_Sweep(); break;
+    case ACT_LEFT_SWEEP: Left_Sweep(); break;
+    case ACT_RIGHT_HOOK: Right_Hook(); break;
+    case ACT_LEFT_HOOK: Left_Hook(); break;
+    case ACT_RIGHT_SHOT: Right_Shot(); break;
+    case ACT_LEFT_SHOT: Left_Shot(); break;
+    case ACT_WARMING_UP: WARMING_UP(); break;
+    case ACT_BEHOLD: BEHOLD(); break;
+    case ACT_DUST_OFF: DUST_OFF(); break;
+    case ACT_GIVE_IT_YOUR_ALL: GIVE_IT_YOUR_ALL(); break;
+    case ACT_BACK_RECOVERY: Back_Recovery(params.back_recovery_spd); break;
+    case ACT_FRONT_RECOVERY: Front_Recovery(params.front_recovery_spd); break;
+    default: Idle(); break;
+  }
+}
+
+/**
+ * @brief Restart a timed action from its first beat.
+*/
+void CONTROL_ATTR Restart_Action(int act) {
+  switch (act) {
+    case ACT_BEHOLD:
+      timers.behold = millis();
+      break;
+    case ACT_DUST_OFF:
+      timers.dust_off = millis();
+      t3_rb.go(params.gaucho_pos[rb]);
+      t3_rb.go(params.gaucho_pos[rb]+35, 500, LINEAR);
+      t3_lb.go(params.gaucho_pos[lb]);
+      t3_lb.go(params.gaucho_pos[lb]-35, 500, LINEAR);
+      break;
+    case ACT_BACK_RECOVERY:
+      timers.back_recovery = millis();
+      break;
+    case ACT_FRONT_RECOVERY:
+      timers.front_recovery = millis();
+      break;
+  }
+}
+
+/**
+ * @brief Whether an action can be bound to an input.
+ * 
+ * The safe pose and pack moves are not driven by input.
+*/
+bool Bindable(int act) {
+  return act >= 0 && act < ACT_COUNT && act != ACT_SAFE_POSE && act != ACT_PACK_MOVE;
+}
+
+/**
+ * @brief Build the dispatch table from the bindings in params.
+ * 
+ * Bindings that are out of range, name an action that cannot be
+ * bound or sit on a reserved button are left out, as if unbound.
+ * Call with control_lock held or before the control task starts.
+*/
+void Compile_Dispatch() {
+  Dispatch_Table& d = dispatch;
+  uint8_t rank[BTN_COUNT] = {};
+  d.bound = 0;
+  d.strike = 0;
+  for (int b = 0; b < BTN_COUNT; b++) {
+    int act = params.bind[b];
+    d.by_button[b] = BIND_NONE;
+    if (((1UL << b) & BIND_RESERVED) || !(Bindable(act) || act == BIND_HOLD)) continue;
+    d.by_button[b] = act;
+    d.bound |= 1UL << b;
+    switch (act) {
+      case ACT_RIGHT_SWEEP:
+      case ACT_LEFT_SWEEP:
+      case ACT_RIGHT_HOOK:
+      case ACT_LEFT_HOOK:
+      case ACT_RIGHT_SHOT:
+      case ACT_LEFT_SHOT:
+        d.strike |= 1UL << b;
+        break;
+    }
+  }
+
+  // Rank = 1 + the bound buttons this one beats
+  d.by_rank[0] = BIND_NONE;
+  for (int b = 0; b < BTN_COUNT; b++) {
+    if (!(d.bound & (1UL << b))) continue;
+    rank[b] = 1;
+    for (int o = 0; o < BTN_COUNT; o++) {
+      if (o == b || !(d.bound & (1UL << o))) continue;
+      int pb = params.bind_priority[b], po = params.bind_priority[o];
+      if (pb > po || (pb == po && b < o)) rank[b]++;
+    }
+    d.by_rank[rank[b]] = d.by_button[b];
+  }
+
+  // Each mask's best is its lowest bit's rank or the rest's best
+  d.lo_rank[0] = 0;
+  for (uint32_t m = 1; m < sizeof(d.lo_rank); m++) {
+    d.lo_rank[m] = max(d.lo_rank[m & (m - 1)], rank[__builtin_ctz(m)]);
+  }
+  d.hi_rank[0] = 0;
+  for (uint32_t m = 1; m < sizeof(d.hi_rank); m++) {
+    d.hi_rank[m] = max(d.hi_rank[m & (m - 1)], rank[9 + __builtin_ctz(m)]);
+  }
+
+  memset(d.stick, ACT_IDLE, sizeof(d.stick));
+  for (int r = 0; r < STICK_RULES; r++) {
+    const Stick_Rule& rule = stick_rules[r];
+    d.stick_axis[rule.gait] = rule.axis;
+    for (int dir = 0; dir < 2; dir++) {
+      int act = params.stick_bind[r][dir];
+      d.stick[rule.gait][dir] = Bindable(act) ? act : ACT_IDLE;
+    }
+  }
+}
+
+/**
+ * @brief Rank of the strongest bound button among some held ones.
+*/
+uint8_t CONTROL_ATTR Dispatch_Rank(uint32_t held) {
+  return max(dispatch.lo_rank[held & 0x1FF], dispatch.hi_rank[(held >> 9) & 0xFF]);
+}
+
+/**
+ * @brief Binding that wins among the held buttons.
+ * 
+ * @param held BTN_* bits held this packet.
+ * @return an Action, BIND_HOLD, or BIND_NONE if no held button is bound.
+*/
+int CONTROL_ATTR Dispatch_Buttons(uint32_t held) {
+  return dispatch.by_rank[Dispatch_Rank(held)];
+}
+
+/**
+ * @brief Action for a gait the sticks asked for.
+ * 
+ * @param gait a gait other than GAIT_NONE.
+ * @param shaped shaped sticks, lx ly rx ry.
+*/
+int CONTROL_ATTR Dispatch_Stick(uint8_t gait, const int* shaped) {
+  return dispatch.stick[gait][shaped[dispatch.stick_axis[gait]] >= 0];
+}
+
+/**
+ * @brief Restart the timed actions whose button just went down.
+ * 
+ * @param pressed BTN_* bits that went down this packet.
+*/
+void CONTROL_ATTR Adjust_Timeouts(uint32_t pressed) {
+  for (uint32_t bits = pressed & dispatch.bound; bits; bits &= bits - 1) {
+    Restart_Action(dispatch.by_button[__builtin_ctz(bits)]);
+  }
+}
+
+/*
+  STRIKE VARIABLES
+*/
+
+enum Strike_Path {
+  STRIKE_FULL,
+  STRIKE_FAST,
+  STRIKE_PATHS
+};
+
+// Cycles from notify() entry until the strike pose is committed
+struct Strike_Latency {
+  uint32_t count;
+  uint64_t cycles;
+  uint32_t max_cycles;
+};
+
+Strike_Latency strike_latency[STRIKE_PATHS];
+
+/*
+  STRIKE FUNCTIONS
+*/
+
+/**
+ * @brief Whether a packet can take the strike fast path.
+ * 
+ * It can when a single button bound to an attack went down with
+ * nothing else held and nothing else owns the joints, which is exactly
+ * when the full path would end up striking with that button.
+ * Call with control_lock held.
+ * 
+ * @param pressed BTN_* bits that went down this packet.
+ * @param held BTN_* bits held this packet.
+*/
+bool CONTROL_ATTR Strike_Eligible(uint32_t pressed, uint32_t held) {
+  return pressed == held && (held & dispatch.strike) && !(held & (held - 1)) &&
+    recorder_state != REC_PLAYBACK && combo_active < 0 && pack_active < 0 &&
+    Battery_Voltage() >= params.low_battery;
+}
+
+/**
+ * @brief Account one strike to a path's latency.
+*/
+void CONTROL_ATTR Strike_Record(int path, uint32_t cycles) {
+  Strike_Latency& l = strike_latency[path];
+  l.count++;
+  l.cycles += cycles;
+  if (cycles > l.max_cycles) l.max_cycles = cycles;
+}
+
+/**
+ * @brief Strike and commit straight away.
+ * 
+ * The combo automaton and the pack's triggers still get the
+ * edge first, so a press that completes a combo or a pack move
+ * starts it just as the full path would. Everything else the
+ * full path does before its dispatch is left for after the
+ * commit. Call with control_lock held, on an eligible packet.
+ * 
+ * @param pressed BTN_* bits that went down this packet.
+ * @param entry_cycles cycle count at notify() entry.
+*/
+void CONTROL_ATTR Strike(uint32_t pressed, uint32_t entry_cycles) {
+  Combo_Input(pressed, millis());
+  if (combo_active < 0) Pack_Input(pressed, pressed);
+  if (combo_active >= 0) Run_Combo();
+  else if (pack_active >= 0) Run_Pack_Move();
+  else {
+    led_state = ATK;
+    Run_Action(dispatch.by_button[__builtin_ctz(pressed)]);
   }
-  // Swing shoulders down
-  else if (curr_time < back_recovery_start + (3*spd/4)) {
-    // Set ramp targets
-    br_rs.go(gaucho_pos[rs], 1000, LINEAR);
-    br_ls.go(gaucho_pos[ls], 1000, LINEAR);
-    br_rb.go(gaucho_pos[rb], 1000, LINEAR);
-    br_lb.go(gaucho_pos[lb], 1000, LINEAR);
-    br_rh.go(gaucho_pos[rh], 1000, LINEAR);
-    br_lh.go(gaucho_pos[lh], 1000, LINEAR);
-    br_rf.go(gaucho_pos[rf], 1000, LINEAR);
-    br_lf.go(gaucho_pos[lf], 1000, LINEAR);
-
-    s_rs.write(gaucho_pos[rs]+30);
-    s_ls.write(gaucho_pos[ls]-30);
-    s_rb.write(gaucho_pos[rb]-145);
-    s_lb.write(gaucho_pos[lb]+145);
-    
-    s_rs.write(gaucho_pos[rs]+105);
-    s_ls.write(gaucho_pos[ls]-105);
-    s_rf.write(gaucho_pos[rf]-80);
-    s_lf.write(gaucho_pos[lf]+80);
-    s_rh.write(gaucho_pos[rh]+50);
-    s_lh.write(gaucho_pos[lh]-50);
-    
-    s_w.write(gaucho_pos[w]);
+  Commit_Joints();
+  Strike_Record(STRIKE_FAST, ESP.getCycleCount() - entry_cycles);
+}
+
+/**
+ * @brief Append bytes to the recorder ring.
+ * 
+ * Never blocks. Fails if the recorder task has fallen behind
+ * and the whole record does not fit.
+ * 
+ * @param data bytes to append.
+ * @param len number of bytes.
+ * @return true if the bytes were appended.
+*/
+bool CONTROL_ATTR Recorder_Push(const uint8_t* data, size_t len) {
+  uint32_t head = recorder_head;
+  if (RECORDER_BUFFER - (head - recorder_tail) < len) return false;
+  for (size_t i = 0; i < len; i++) recorder_ring[(head + i) % RECORDER_BUFFER] = data[i];
+  __sync_synchronize();
+  recorder_head = head + len;
+  return true;
+}
+
+/**
+ * @brief Log the current tick to the recorder.
+ * 
+ * Delta encodes the committed joint outputs plus this tick's
+ * input events into the RAM ring. Ticks where nothing changed
+ * are skipped. A dropped record forces the next one to be a
+ * keyframe so playback can resynchronise.
+ * 
+ * @param buttons packed button-down events of this tick.
+ * @param sticks stick values of this tick (lx, ly, rx, ry).
+*/
+void CONTROL_ATTR Record_Tick(uint32_t buttons, const int8_t* sticks) {
+  if (recorder_state != REC_RECORDING) return;
+
+  int16_t pose[9];
+  bool pose_changed = false;
+  for (int i = 0; i < 9; i++) {
+    pose[i] = constrain(joint_out[i], 0, 180);
+    if (pose[i] != recorder_pose[i]) pose_changed = true;
   }
-  // Ease into default stance
-  else {
-    s_rs.write(br_rs.update());
-    s_ls.write(br_ls.update());
-    s_rb.write(br_rb.update());
-    s_lb.write(br_lb.update());
+  bool sticks_changed = memcmp(sticks, recorder_sticks, sizeof(recorder_sticks)) != 0;
+  if (!recorder_keyframe && !pose_changed && !sticks_changed && !buttons) return;
 
+  // Pad gaps longer than a single record can express
+  uint8_t record[MOTION_LOG_MAX_RECORD];
+  unsigned long ms = millis();
+  while (ms - recorder_last_ms > 255) {
+    const uint8_t pad[] = { 255, 0, 0 };
+    if (!Recorder_Push(pad, sizeof(pad))) {
+      recorder_dropped++;
+      recorder_keyframe = true;
+      return;
+    }
+    recorder_last_ms += 255;
+  }
 
-    s_rf.write(br_rf.update());
-    s_lf.write(br_lf.update());
-    s_rh.write(br_rh.update());
-    s_lh.write(br_lh.update());
-    
-    s_w.write(gaucho_pos[w]);
+  size_t len = Motion_Log_Encode(record, ms - recorder_last_ms, recorder_pose, pose, buttons, sticks_changed ? sticks : NULL, recorder_keyframe);
+  if (!Recorder_Push(record, len)) {
+    recorder_dropped++;
+    recorder_keyframe = true;
+    return;
   }
+  memcpy(recorder_pose, pose, sizeof(recorder_pose));
+  memcpy(recorder_sticks, sticks, sizeof(recorder_sticks));
+  recorder_last_ms = ms;
+  recorder_keyframe = false;
 }
 
-unsigned long front_recovery_start = 0;
 /**
- * @brief Stand back up from lying on front
+ * @brief Write buffered records to the recording file.
  * 
- * Four beat motion to stand up from.
+ * While recording only whole RECORDER_BLOCK sized blocks are
+ * written, so flash sees large sequential writes. When stopping
+ * everything left in the ring is written.
  * 
- * First beat orients legs in a split.
+ * @param file open recording file.
+ * @param all write partial blocks as well.
+*/
+void Recorder_Flush(File& file, bool all) {
+  for (;;) {
+    uint32_t tail = recorder_tail;
+    uint32_t avail = recorder_head - tail;
+    size_t idx = tail % RECORDER_BUFFER;
+    size_t len = min((size_t)avail, RECORDER_BUFFER - idx);
+    if (!all) {
+      if (avail < RECORDER_BLOCK) return;
+      len = RECORDER_BLOCK;
+    }
+    if (len == 0) return;
+    file.write(recorder_ring + idx, len);
+    __sync_synchronize();
+    recorder_tail = tail + len;
+  }
+}
+
+/**
+ * @brief Stream the recording back through the servo output stage.
  * 
- * Second beat swings biceps backward to push body backward.
+ * Reads the file in RECORDER_BLOCK sized blocks, reusing the
+ * recorder ring as the read buffer, and commits each decoded pose
+ * at its recorded time. Returns when the file ends or playback is
+ * cancelled.
+*/
+void Play_Recording() {
+  File file = LittleFS.open(RECORDER_FILE, "r");
+  uint8_t magic[MOTION_LOG_HEADER];
+  if (!file || file.read(magic, MOTION_LOG_HEADER) != MOTION_LOG_HEADER || memcmp(magic, MOTION_LOG_MAGIC, MOTION_LOG_HEADER) != 0) {
+    if (file) file.close();
+    recorder_state = REC_OFF;
+    return;
+  }
+
+  Motion_Log_State state;
+  memset(&state, 0, sizeof(state));
+  uint8_t* buf = recorder_ring;
+  size_t len = 0;
+  size_t pos = 0;
+  unsigned long start = millis();
+
+  while (recorder_state == REC_PLAYBACK) {
+    // Top up the buffer before it can run short of a full record
+    if (len - pos < MOTION_LOG_MAX_RECORD) {
+      memmove(buf, buf + pos, len - pos);
+      len -= pos;
+      pos = 0;
+      int got = file.read(buf + len, RECORDER_BLOCK);
+      if (got > 0) len += got;
+    }
+
+    size_t n = Motion_Log_Decode(buf + pos, len - pos, &state);
+    if (n == 0) break;
+    pos += n;
+
+    long wait = (long)(start + state.ms - millis());
+    if (wait > 0) vTaskDelay(pdMS_TO_TICKS(wait));
+
+    xSemaphoreTake(control_lock, portMAX_DELAY);
+    for (int i = 0; i < 9; i++) joint_cmd[i] = state.pose[i];
+    Commit_Joints();
+    xSemaphoreGive(control_lock);
+  }
+
+  file.close();
+  recorder_state = REC_OFF;
+}
+
+/**
+ * @brief Background task owning the recording file.
  * 
- * Third beat brings arms down to further push body backward.
+ * Runs at low priority so flash writes never hold up notify().
+ * Woken early whenever the recorder state changes.
+*/
+void Recorder_Task(void* arg) {
+  File file;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(RECORDER_POLL));
+
+    if (recorder_state == REC_RECORDING || recorder_state == REC_STOPPING) {
+      if (!file) {
+        file = LittleFS.open(RECORDER_FILE, "w");
+        if (!file) {
+          recorder_state = REC_OFF;
+          continue;
+        }
+        file.write((const uint8_t*)MOTION_LOG_MAGIC, MOTION_LOG_HEADER);
+      }
+      bool stopping = recorder_state == REC_STOPPING;
+      Trace_Begin(TRACE_RECORDER);
+      Recorder_Flush(file, stopping);
+      Trace_End(TRACE_RECORDER);
+      if (stopping) {
+        file.close();
+        recorder_state = REC_OFF;
+      }
+    }
+    else if (recorder_state == REC_PLAYBACK) Play_Recording();
+  }
+}
+
+/**
+ * @brief Start or stop recording.
+*/
+void Toggle_Recording() {
+  if (recorder_state == REC_OFF && recorder_fs_ok) {
+    recorder_head = 0;
+    recorder_tail = 0;
+    recorder_keyframe = true;
+    recorder_last_ms = millis();
+    recorder_state = REC_RECORDING;
+  }
+  else if (recorder_state == REC_RECORDING) recorder_state = REC_STOPPING;
+  else return;
+  xTaskNotifyGive(recorder_task);
+}
+
+/**
+ * @brief Start or stop playback of the last recording.
+*/
+void Toggle_Playback() {
+  if (recorder_state == REC_OFF && recorder_fs_ok) recorder_state = REC_PLAYBACK;
+  else if (recorder_state == REC_PLAYBACK) recorder_state = REC_OFF;
+  else return;
+  xTaskNotifyGive(recorder_task);
+}
+
+/**
+ * @brief Restart the taunt ramps from the current gaucho pose.
+*/
+void Init_Taunt_Ramps() {
+  t1_rs.go(params.gaucho_pos[rs]);
+  t1_rs.go(params.gaucho_pos[rs]+70, 1000, LINEAR, FORTHANDBACK);
+  t1_rb.go(params.gaucho_pos[rb]);
+  t1_rb.go(params.gaucho_pos[rb]-55, 1000, LINEAR, FORTHANDBACK);
+  t1_ls.go(params.gaucho_pos[ls]);
+  t1_ls.go(params.gaucho_pos[ls]-70, 1000, LINEAR, FORTHANDBACK);
+  t1_lb.go(params.gaucho_pos[lb]);
+  t1_lb.go(params.gaucho_pos[lb]+55, 1000, LINEAR, FORTHANDBACK);
+
+  t2_w.go(params.gaucho_pos[w]-95);
+  t2_w.go(params.gaucho_pos[w]+85, 1000, LINEAR, FORTHANDBACK);
+}
+
+/*
+  BENCHMARK VARIABLES
+*/
+
+// Held on the first packet after boot to run the benchmark
+#define BENCH_CHORD (BTN_SELECT | BTN_START)
+// Sweep each joint this far either side of its gaucho angle, in degrees
+#define BENCH_SWEEP 15
+// Evaluations per action, one every CONTROL_TICK ms
+#define BENCH_CYCLES 400
+// Back to rest between steps, in ms
+#define BENCH_SETTLE 300
+#define BENCH_FLUSHES 50
+#define BENCH_ADC_SAMPLES 4096
+
+struct Bench_State {
+  // Set by the chord or the console, run by loop()
+  volatile bool requested;
+  // Set while the benchmark owns the joints
+  volatile bool active;
+  // Cleared by the first packet, the only one that can carry the chord
+  bool window;
+  int step;
+};
+
+Bench_State bench = { false, false, true };
+
+// One step's figures, see Run_Bench()
+struct Bench_Step {
+  uint32_t n;
+  uint64_t cycles;
+  uint32_t max_cycles;
+  uint32_t writes;
+  uint16_t bat;
+  uint16_t bat_min;
+};
+
+// Actions run by the benchmark, in step order
+const uint8_t bench_actions[] = {
+  ACT_IDLE, ACT_FORWARD, ACT_BACKWARD, ACT_LEFT, ACT_RIGHT, ACT_SIDESTEP_LEFT, ACT_SIDESTEP_RIGHT,
+  ACT_RIGHT_SWEEP, ACT_LEFT_SWEEP, ACT_RIGHT_HOOK, ACT_LEFT_HOOK, ACT_RIGHT_SHOT, ACT_LEFT_SHOT,
+  ACT_WARMING_UP, ACT_BEHOLD, ACT_DUST_OFF, ACT_GIVE_IT_YOUR_ALL, ACT_BACK_RECOVERY, ACT_FRONT_RECOVERY
+};
+
+/*
+  CONSOLE VARIABLES
+*/
+
+#define CONSOLE_LINE 64
+#define PARAMS_NAMESPACE "bahamut"
+#define PARAMS_KEY "params"
+
+enum Param_Type {
+  PARAM_INT,
+  PARAM_BOOL
+};
+
+/**
+ * @brief One entry of the parameter registry.
  * 
- * Final beat resets body to crouch position.
+ * Locates a field of Params by byte offset, so get, set and
+ * validation are all driven by this table.
+*/
+struct Param_Def {
+  const char* name;
+  uint8_t type;
+  uint16_t offset;
+  uint8_t count;
+  int16_t min;
+  int16_t max;
+};
+
+#define PARAM(field, type, count, lo, hi) { #field, type, offsetof(Params, field), count, lo, hi }
+
+const Param_Def param_defs[] = {
+  PARAM(forward_spd, PARAM_INT, 1, 50, 2000),
+  PARAM(backward_spd, PARAM_INT, 1, 50, 2000),
+  PARAM(turn_spd, PARAM_INT, 1, 50, 2000),
+  PARAM(sidestep_spd, PARAM_INT, 1, 50, 2000),
+  PARAM(back_recovery_spd, PARAM_INT, 1, 500, 5000),
+  PARAM(front_recovery_spd, PARAM_INT, 1, 500, 5000),
+  PARAM(forward_foot, PARAM_INT, 1, 0, 60),
+  PARAM(forward_waist, PARAM_INT, 1, 0, 90),
+  PARAM(turn_lift, PARAM_INT, 1, 0, 60),
+  PARAM(turn_waist, PARAM_INT, 1, 0, 90),
+  PARAM(sidestep_reach, PARAM_INT, 1, 0, 60),
+  PARAM(forward_split, PARAM_INT, 1, 10, 90),
+  PARAM(turn_split, PARAM_INT, 1, 10, 90),
+  PARAM(sidestep_split, PARAM_INT, 1, 10, 90),
+  PARAM(sweep_w_trim, PARAM_INT, 2, -45, 45),
+  PARAM(stick_deadzone, PARAM_INT, 1, 0, 100),
+  PARAM(stick_expo, PARAM_INT, 1, 0, 100),
+  PARAM(stick_filter, PARAM_INT, 1, 1, 256),
+  PARAM(gait_hysteresis, PARAM_INT, 1, 0, 64),
+  PARAM(balance, PARAM_BOOL, 1, 0, 1),
+  PARAM(balance_margin, PARAM_INT, 1, 0, 20),
+  PARAM(low_battery, PARAM_INT, 1, 0, 4095),
+  PARAM(telemetry, PARAM_BOOL, 1, 0, 1),
+  PARAM(fast_attacks, PARAM_BOOL, 1, 0, 1),
+  PARAM(bind, PARAM_INT, BTN_COUNT, BIND_NONE, BIND_HOLD),
+  PARAM(bind_priority, PARAM_INT, BTN_COUNT, 0, 99),
+  PARAM(stick_bind, PARAM_INT, STICK_RULES * 2, 0, ACT_COUNT - 1),
+  PARAM(servo_digital, PARAM_BOOL, 9, 0, 1),
+  PARAM(servo_frame, PARAM_INT, 1, 3, 20),
+  PARAM(std_pos, PARAM_INT, 9, 0, 180),
+  PARAM(gaucho_pos, PARAM_INT, 9, 0, 180),
+  PARAM(crouch_pos, PARAM_INT, 9, 0, 180),
+};
+#define PARAM_COUNT (sizeof(param_defs) / sizeof(param_defs[0]))
+
+// Opened once in setup() and kept open, so saving at runtime
+// does not allocate a new NVS handle
+Preferences prefs;
+char console_line[CONSOLE_LINE];
+int console_len = 0;
+bool console_overflow = false;
+
+/*
+  CONSOLE FUNCTIONS
+*/
+
+/**
+ * @brief Send a console reply as a text telemetry frame.
  * 
- * @param spd The speed in milliseconds to complete the motion.
+ * Shares the telemetry stream so replies and frames never
+ * interleave mid-frame. Like the other frames it is dropped
+ * rather than blocking when the TX buffer is full.
 */
-void Front_Recovery(int spd) {
-  unsigned long curr_time = millis();
-  // Orient
-  if (curr_time < front_recovery_start + (1*spd/4)) {
-    s_rs.write(gaucho_pos[rs]+105);
-    s_ls.write(gaucho_pos[ls]-105);
-    s_rf.write(gaucho_pos[rf]-80);
-    s_lf.write(gaucho_pos[lf]+80);
-    for (int i = 0; i < 9; i++) {
-      if (i != rs && i != ls && i != rf && i != lf) joints[i].write(gaucho_pos[i]);
+void Console_Reply(const char* fmt, ...) {
+  uint8_t frame[TELEMETRY_MAX_FRAME + 1];
+  frame[0] = TELEMETRY_TEXT;
+  frame[1] = TELEMETRY_VERSION;
+
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf((char*)frame + 2, TELEMETRY_TEXT_MAX + 1, fmt, args);
+  va_end(args);
+  if (n < 0) return;
+  if (n > TELEMETRY_TEXT_MAX) n = TELEMETRY_TEXT_MAX;
+
+  frame[n + 2] = Telemetry_Checksum(frame, n + 2);
+
+  uint8_t encoded[TELEMETRY_MAX_ENCODED];
+  size_t len = Cobs_Encode(frame, n + 3, encoded);
+  if (Serial.availableForWrite() >= (int)len) Serial.write(encoded, len);
+  else telemetry.dropped++;
+}
+
+/**
+ * @brief Pointer to element i of a registered parameter.
+*/
+int* Param_Ptr(Params& p, const Param_Def& def, int i) {
+  return (int*)((uint8_t*)&p + def.offset) + i;
+}
+
+/**
+ * @brief Check every field of p against its registry range.
+*/
+bool Params_Valid(Params& p) {
+  if (p.version != PARAMS_VERSION) return false;
+  for (size_t d = 0; d < PARAM_COUNT; d++) {
+    for (int i = 0; i < param_defs[d].count; i++) {
+      int v = *Param_Ptr(p, param_defs[d], i);
+      if (v < param_defs[d].min || v > param_defs[d].max) return false;
     }
   }
-  // Swing biceps forward
-  else if (curr_time < front_recovery_start + (2*spd/4)) {
-    s_rs.write(gaucho_pos[rs]+105);
-    s_ls.write(gaucho_pos[ls]-105);
-    s_rb.write(gaucho_pos[rb]+35);
-    s_lb.write(gaucho_pos[lb]-35);
+  return true;
+}
+
+/**
+ * @brief Replace the live parameters.
+ * 
+ * Swapped under the control lock so a tick never sees half of
+ * an update, then the taunt ramps are rebuilt around the new
+ * gaucho pose.
+*/
+void Apply_Params(const Params& p) {
+  xSemaphoreTake(control_lock, portMAX_DELAY);
+  params = p;
+  Init_Taunt_Ramps();
+  Compile_Dispatch();
+  Servo_Configure();
+  xSemaphoreGive(control_lock);
+}
+
+/**
+ * @brief Read parameters from NVS.
+ * 
+ * A blob of the wrong size, version or with an out of range
+ * value is rejected.
+ * 
+ * @param out receives the stored parameters.
+ * @return true if out holds a valid set.
+*/
+bool Load_Params(Params& out) {
+  bool ok = prefs.getBytesLength(PARAMS_KEY) == sizeof(Params)
+    && prefs.getBytes(PARAMS_KEY, &out, sizeof(Params)) == sizeof(Params)
+    && Params_Valid(out);
+  return ok;
+}
+
+/**
+ * @brief Store the live parameters in NVS.
+*/
+bool Save_Params() {
+  return prefs.putBytes(PARAMS_KEY, &params, sizeof(Params)) == sizeof(Params);
+}
+
+/**
+ * @brief Find a parameter by name.
+ * 
+ * Accepts "name" or "name[i]". The index defaults to 0.
+ * 
+ * @param token name as typed, modified in place.
+ * @param index out: element index.
+ * @return the registry entry, or NULL if unknown or out of range.
+*/
+const Param_Def* Find_Param(char* token, int& index) {
+  index = 0;
+  char* bracket = strchr(token, '[');
+  if (bracket) {
+    *bracket = '\0';
+    index = atoi(bracket + 1);
+  }
+  for (size_t d = 0; d < PARAM_COUNT; d++) {
+    if (strcmp(token, param_defs[d].name) == 0) {
+      if (index < 0 || index >= param_defs[d].count) return NULL;
+      return &param_defs[d];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @brief Reply with every element of a parameter on one line.
+*/
+void Print_Param(const Param_Def& def) {
+  char values[TELEMETRY_TEXT_MAX];
+  int len = 0;
+  for (int i = 0; i < def.count && len < (int)sizeof(values); i++)
+    len += snprintf(values + len, sizeof(values) - len, i ? ",%d" : "%d", *Param_Ptr(params, def, i));
+  Console_Reply("%s=%s", def.name, values);
+}
+
+/**
+ * @brief Report how long each boot phase took to reach, in ms since
+ * reset, and what kind of reset it was.
+ * 
+ * Phases wrap onto another "boot" line rather than being cut off.
+*/
+void Report_Boot() {
+  char line[TELEMETRY_TEXT_MAX];
+  int len = snprintf(line, sizeof(line), "boot");
+  for (int p = 0; p < BOOT_COUNT; p++) {
+    if (!boot_us[p]) continue;
+    char item[32];
+    int n = snprintf(item, sizeof(item), " %s=%lu.%lu", boot_phase_names[p], (unsigned long)boot_us[p] / 1000, (unsigned long)boot_us[p] / 100 % 10);
+    if (len + n >= (int)sizeof(line)) {
+      Console_Reply("%s", line);
+      len = snprintf(line, sizeof(line), "boot");
+    }
+    memcpy(line + len, item, n + 1);
+    len += n;
+  }
+  Console_Reply("%s", line);
+  const char* reason = warm_state.reason < sizeof(reset_names) / sizeof(reset_names[0]) ? reset_names[warm_state.reason] : "?";
+  if (warm_state.warm) {
+    Console_Reply("boot %s warm=%lu streak=%u from %s pad=%s", reason, (unsigned long)warm_state.warm_boots,
+      warm_state.streak, action_names[warm_state.from_action], warm_state.from_pad ? "linked" : "away");
+  }
+  else Console_Reply("boot %s cold", reason);
+}
+
+/**
+ * @brief Report every deadline monitor and the safe pose entries.
+ * 
+ * Two lines per monitor: totals with the worst sample and what was
+ * running at the time, then the histogram in budget/8 doublings.
+*/
+void Report_Deadlines() {
+  for (int i = 0; i < DEADLINE_COUNT; i++) {
+    Deadline_Stats& d = deadlines[i];
+    Console_Reply("%s budget=%luus n=%lu over=%lu max=%luus at %lums %s%s", d.name,
+      (unsigned long)d.budget_us, (unsigned long)d.count, (unsigned long)d.overruns, (unsigned long)d.max_us,
+      (unsigned long)d.max_ms, action_names[d.max_action], d.max_display_busy ? " display" : "");
+    Console_Reply("%s hist %lu %lu %lu %lu | %lu %lu %lu %lu", d.name,
+      (unsigned long)d.hist[0], (unsigned long)d.hist[1], (unsigned long)d.hist[2], (unsigned long)d.hist[3],
+      (unsigned long)d.hist[4], (unsigned long)d.hist[5], (unsigned long)d.hist[6], (unsigned long)d.hist[7]);
+  }
+  Console_Reply("safe %s overrun=%lu starved=%lu disconnected=%lu", safe_reason_names[safe_reason],
+    (unsigned long)safe_count[SAFE_OVERRUN], (unsigned long)safe_count[SAFE_STARVED], (unsigned long)safe_count[SAFE_DISCONNECTED]);
+}
+
+/**
+ * @brief Report controller drops and how long control took to come back.
+*/
+void Report_Link() {
+  Console_Reply("link drops=%lu restored=%lu last=%lu.%lums connect=%lu.%lums min=%lums max=%lums",
+    (unsigned long)link_stats.drops, (unsigned long)link_stats.restores,
+    (unsigned long)link_stats.last_us / 1000, (unsigned long)link_stats.last_us / 100 % 10,
+    (unsigned long)link_stats.connect_us / 1000, (unsigned long)link_stats.connect_us / 100 % 10,
+    (unsigned long)link_stats.min_us / 1000, (unsigned long)link_stats.max_us / 1000);
+}
+
+/**
+ * @brief Report heap headroom and the static RAM of each subsystem.
+*/
+void Report_Memory() {
+  Console_Reply("heap free=%lu min=%lu largest=%lu setup=%lu",
+    (unsigned long)ESP.getFreeHeap(), (unsigned long)ESP.getMinFreeHeap(),
+    (unsigned long)ESP.getMaxAllocHeap(), (unsigned long)heap_after_setup);
+  Console_Reply("ram joints=%u battery=%u leds=%u timers=%u params=%u",
+    (unsigned)(sizeof(joint_cmd) + sizeof(joint_out) + sizeof(servo_pwm) + sizeof(joint_attach_ms)),
+    (unsigned)sizeof(battery_mon), (unsigned)sizeof(leds), (unsigned)sizeof(timers), (unsigned)sizeof(params));
+  Console_Reply("ram combos=%u recorder=%u deadlines=%u telemetry=%u profile=%u",
+    (unsigned)(sizeof(combos) + sizeof(combo_stats) + sizeof(combo_edge_symbol) + sizeof(combo_edge_parent)
+      + sizeof(combo_depth) + sizeof(combo_fail) + sizeof(combo_accept) + sizeof(combo_input_ms)),
+    (unsigned)(sizeof(recorder_ring) + sizeof(recorder_pose) + sizeof(recorder_sticks)),
+    (unsigned)sizeof(deadlines), (unsigned)sizeof(telemetry), (unsigned)sizeof(profile));
+  Console_Reply("ram trace=%u pack=%u dispatch=%u", (unsigned)sizeof(trace_rings), (unsigned)sizeof(motion_pack),
+    (unsigned)sizeof(dispatch));
+}
+
+/**
+ * @brief Report the latency added by stick shaping.
+ * 
+ * Follow latency is measured in packets, so it is a whole number
+ * of packet intervals. Over one control tick means the filter is
+ * set too heavy for the packet rate.
+*/
+void Report_Sticks() {
+  uint32_t mean = shaper.follows ? shaper.follow_sum_us / shaper.follows : 0;
+  Console_Reply("sticks follow n=%lu mean=%luus max=%luus suppressed=%lu %s",
+    (unsigned long)shaper.follows, (unsigned long)mean, (unsigned long)shaper.follow_max_us,
+    (unsigned long)shaper.suppressed, mean <= CONTROL_TICK * 1000 ? "ok" : "over tick");
+}
+
+/**
+ * @brief Report strike latency on both paths.
+ * 
+ * Only packets the fast path could have taken are counted, so
+ * with fast_attacks toggled between runs the two lines compare
+ * the same presses and their difference is what the fast path
+ * saves.
+*/
+void Report_Strikes() {
+  Strike_Latency snap[STRIKE_PATHS];
+  xSemaphoreTake(control_lock, portMAX_DELAY);
+  memcpy(snap, strike_latency, sizeof(snap));
+  xSemaphoreGive(control_lock);
+
+  static const char* const path_names[STRIKE_PATHS] = { "full", "fast" };
+  float mhz = ESP.getCpuFreqMHz();
+  float mean_us[STRIKE_PATHS];
+  for (int p = 0; p < STRIKE_PATHS; p++) {
+    mean_us[p] = snap[p].count ? snap[p].cycles / snap[p].count / mhz : 0;
+    Console_Reply("strikes %s n=%lu mean=%.2fus max=%.2fus", path_names[p],
+      (unsigned long)snap[p].count, mean_us[p], snap[p].max_cycles / mhz);
+  }
+  if (snap[STRIKE_FULL].count && snap[STRIKE_FAST].count) {
+    Console_Reply("strikes saved=%.2fus", mean_us[STRIKE_FULL] - mean_us[STRIKE_FAST]);
+  }
+}
+
+/**
+ * @brief Name of a binding value.
+*/
+const char* Bind_Name(int act) {
+  if (act == BIND_NONE) return "none";
+  if (act == BIND_HOLD) return "hold";
+  return action_names[act];
+}
+
+/**
+ * @brief Parse a binding value from its name, case blind.
+ * 
+ * @return the value, or BIND_NONE - 1 if the name is unknown.
+*/
+int Parse_Bind(const char* name) {
+  if (strcasecmp(name, "none") == 0) return BIND_NONE;
+  if (strcasecmp(name, "hold") == 0) return BIND_HOLD;
+  for (int a = 0; a < ACT_COUNT; a++) {
+    if (strcasecmp(name, action_names[a]) == 0) return a;
+  }
+  return BIND_NONE - 1;
+}
+
+/**
+ * @brief List the live bindings, strongest button first.
+*/
+void Report_Binds() {
+  for (int r = BTN_COUNT; r > 0; r--) {
+    for (int b = 0; b < BTN_COUNT; b++) {
+      if (!(dispatch.bound & (1UL << b)) || Dispatch_Rank(1UL << b) != r) continue;
+      Console_Reply("bind %s %s priority=%d", button_names[b], Bind_Name(dispatch.by_button[b]), params.bind_priority[b]);
+    }
+  }
+  static const char* const gait_names[] = { "none", "walk", "turn", "sidestep" };
+  static const char* const axis_names[] = { "lx", "ly", "rx", "ry" };
+  for (int r = 0; r < STICK_RULES; r++) {
+    const Stick_Rule& rule = stick_rules[r];
+    Console_Reply("stick %s %s- %s %s+ %s", gait_names[rule.gait], axis_names[rule.axis],
+      action_names[dispatch.stick[rule.gait][0]], axis_names[rule.axis], action_names[dispatch.stick[rule.gait][1]]);
+  }
+}
+
+/**
+ * @brief Rebind a button by name.
+ * 
+ * bind <button> <action|none|hold> [priority]
+*/
+void Bind_Command(const char* button, const char* value, const char* priority) {
+  int b = -1;
+  for (int i = 0; i < BTN_COUNT && button; i++) {
+    if (strcmp(button, button_names[i]) == 0) b = i;
+  }
+  if (b < 0 || ((1UL << b) & BIND_RESERVED)) {
+    Console_Reply("err unknown or reserved button");
+    return;
+  }
+  int act = value ? Parse_Bind(value) : BIND_NONE - 1;
+  if (act != BIND_NONE && act != BIND_HOLD && !Bindable(act)) {
+    Console_Reply("err unknown or unbindable action");
+    return;
+  }
+  Params p = params;
+  p.bind[b] = act;
+  if (priority) {
+    char* end;
+    long v = strtol(priority, &end, 10);
+    if (*end != '\0' || v < 0 || v > 99) {
+      Console_Reply("err priority range 0..99");
+      return;
+    }
+    p.bind_priority[b] = v;
+  }
+  Apply_Params(p);
+  Console_Reply("bind %s %s priority=%d", button_names[b], Bind_Name(act), p.bind_priority[b]);
+}
+
+/**
+ * @brief Report time spent at each control rate.
+ * 
+ * cpu is the control task's own share of the time at that rate,
+ * ticks/s how often it woke, which is what idling saves.
+*/
+void Report_Rates() {
+  // Only the control task writes the counters, unlocked, so a
+  // report racing a tick can be off by that one tick
+  Rate_State snap;
+  memcpy(&snap, (const void*)&control_rate, sizeof(snap));
+
+  uint64_t total_us = 0;
+  for (int r = 0; r < RATE_COUNT; r++) total_us += snap.resident_us[r];
+  float mhz = ESP.getCpuFreqMHz();
+  for (int r = 0; r < RATE_COUNT; r++) {
+    float share = total_us ? 100.0f * snap.resident_us[r] / total_us : 0;
+    float rate = snap.resident_us[r] ? snap.ticks[r] * 1e6f / snap.resident_us[r] : 0;
+    float cpu = snap.resident_us[r] ? 100.0f * snap.tick_cycles[r] / mhz / snap.resident_us[r] : 0;
+    Console_Reply("rates %s %ums %.1f%% ticks=%lu %.0f/s cpu=%.3f%%", rate_names[r], rate_periods[r],
+      share, (unsigned long)snap.ticks[r], rate, cpu);
+  }
+  Console_Reply("rates now=%s promotions=%lu", rate_names[snap.rate], (unsigned long)snap.promotions);
+}
+
+/**
+ * @brief Report each servo class's frame and command to pulse delay.
+ * 
+ * The delay runs from a joint's write to the wrap of its timer
+ * that latches the new duty, so writes out of step with the frame
+ * average half a frame. Writes from packets always are; writes
+ * from control ticks land just ahead of the wrap once aligned.
+*/
+void Report_Pwm() {
+  char joints[10];
+  for (int c = 0; c < SERVO_CLASS_COUNT; c++) {
+    int n = 0;
     for (int i = 0; i < 9; i++) {
-      if (i != rs && i != ls && i != rb && i != lb) joints[i].write(gaucho_pos[i]);
+      if (servo_pwm.joint_class[i] == c) joints[n++] = '0' + i;
+    }
+    joints[n] = '\0';
+    Console_Reply("pwm %s %ums joints=%s%s", servo_class_names[c], servo_pwm.frame_ms[c], n ? joints : "-",
+      c == SERVO_DIGITAL && servo_pwm.aligned ? " aligned" : "");
+    for (int src = 0; src < SERVO_SOURCE_COUNT; src++) {
+      const Servo_Delay& d = servo_pwm.delay[c][src];
+      Console_Reply("pwm %s %s n=%lu mean=%luus max=%luus", servo_class_names[c], servo_source_names[src],
+        (unsigned long)d.n, (unsigned long)(d.n ? d.sum_us / d.n : 0), (unsigned long)d.max_us);
     }
   }
-  // Swing shoulders down
-  else if (curr_time < front_recovery_start + (3*spd/4)) {
-    s_rs.write(gaucho_pos[rs]+30);
-    s_ls.write(gaucho_pos[ls]-30);
-    s_rb.write(gaucho_pos[rb]+35);
-    s_lb.write(gaucho_pos[lb]-35);
-    for (int i = 0; i < 9; i++) {
-      if (i != rs && i != ls && i != rb && i != lb) joints[i].write(gaucho_pos[i]);
+}
+
+/**
+ * @brief Forget every action's energy counters.
+*/
+void Energy_Reset() {
+  xSemaphoreTake(control_lock, portMAX_DELAY);
+  memset(energy, 0, sizeof(energy));
+  energy_last_us = 0;
+  xSemaphoreGive(control_lock);
+  Console_Reply("ok");
+}
+
+/**
+ * @brief Print every action that has run with its estimated cost.
+ * 
+ * Charge is the holding current of all nine joints over the time
+ * the action was active plus SERVO_UAS_PER_DEG per degree moved.
+ * Energy weighs both by the battery reading at the time, so a
+ * move made on a sagging pack counts for what it really drew.
+*/
+void Report_Energy() {
+  Action_Energy snap[ACT_COUNT];
+  xSemaphoreTake(control_lock, portMAX_DELAY);
+  memcpy(snap, energy, sizeof(snap));
+  xSemaphoreGive(control_lock);
+
+  double total_mas = 0;
+  for (int a = 0; a < ACT_COUNT; a++) {
+    const Action_Energy& e = snap[a];
+    if (!e.commits) continue;
+    uint32_t travel = 0;
+    for (int i = 0; i < 9; i++) travel += e.travel[i];
+
+    double hold_mas = e.active_us / 1000.0 * SERVO_HOLD_MA * 9 / 1000.0;
+    double move_mas = travel * SERVO_UAS_PER_DEG / 1000.0;
+    double mv_per_count = BATTERY_FULL_SCALE_MV / 4095.0;
+    double hold_mj = e.counts_us / 1e6 * mv_per_count * SERVO_HOLD_MA * 9 / 1000.0;
+    double move_mj = e.travel_counts * mv_per_count * SERVO_UAS_PER_DEG / 1e6;
+    total_mas += hold_mas + move_mas;
+
+    Console_Reply("energy %s ms=%lu n=%lu cmd=%lu deg=%lu mAs=%.1f mJ=%.0f",
+      action_names[a], (unsigned long)(e.active_us / 1000), (unsigned long)e.commits,
+      (unsigned long)e.commands, (unsigned long)travel, hold_mas + move_mas, hold_mj + move_mj);
+    Console_Reply("energy %s deg/joint %lu %lu %lu %lu %lu %lu %lu %lu %lu", action_names[a],
+      (unsigned long)e.travel[0], (unsigned long)e.travel[1], (unsigned long)e.travel[2],
+      (unsigned long)e.travel[3], (unsigned long)e.travel[4], (unsigned long)e.travel[5],
+      (unsigned long)e.travel[6], (unsigned long)e.travel[7], (unsigned long)e.travel[8]);
+  }
+  Console_Reply("energy total mAs=%.1f mAh=%.2f", total_mas, total_mas / 3600);
+}
+
+/**
+ * @brief Report the motion pack and list its moves.
+*/
+void Report_Pack() {
+  if (!motion_pack.header) {
+    Console_Reply("pack %s partition=%lu load=%luus", motion_pack_errors[motion_pack.status],
+      (unsigned long)motion_pack.partition_size, (unsigned long)motion_pack.load_us);
+    return;
+  }
+  const Motion_Pack_Header* h = motion_pack.header;
+  Console_Reply("pack ok v%u moves=%u keys=%u poses=%u size=%lu/%lu crc=%08lx load=%luus",
+    h->version, h->move_count, h->key_count, h->pose_count, (unsigned long)h->size,
+    (unsigned long)motion_pack.partition_size, (unsigned long)h->crc, (unsigned long)motion_pack.load_us);
+  for (int m = 0; m < h->move_count; m++) {
+    const Motion_Pack_Move& move = motion_pack.moves[m];
+    char trigger[48] = "";
+    int len = 0;
+    for (int b = 0; b < BTN_COUNT && len < (int)sizeof(trigger); b++) {
+      if (move.trigger & (1UL << b)) len += snprintf(trigger + len, sizeof(trigger) - len, "%s%s", len ? "+" : "", button_names[b]);
     }
-  }
-  // Return to crouch stance
-  else {
-    for (int i = 0; i < 9; i++) joints[i].write(crouch_pos[i]);
+    Console_Reply("pack %.*s trigger=%s keys=%u ms=%u mask=%03x", MOTION_PACK_NAME, move.name, trigger,
+      move.key_count, motion_pack.keys[move.first_key + move.key_count - 1].ms, move.mask);
   }
 }
 
-// Attacks
-
-bool In_Use_Right_Atk(int i) { return (i == rs || i == rb || i == w); }
-bool In_Use_Left_Atk(int i) { return (i == ls || i == lb || i == w); }
-
 /**
- * @brief Wide right attack.
- * 
- * Extends right arm out and swing it.
+ * @brief Index of the oldest event still held in a ring.
 */
-void Right_Sweep() {
-  s_rs.write(gaucho_pos[rs]+70);
-  s_rb.write(gaucho_pos[rb]-55);
-  s_w.write(gaucho_pos[w]+85);
-  Fix_Rest(In_Use_Right_Atk);
+uint32_t Trace_First(const Trace_Ring& ring) {
+  uint32_t head = ring.head;
+  return head > TRACE_EVENTS ? head - TRACE_EVENTS : 0;
 }
 
 /**
- * @brief Wide left attack.
- * 
- * Extends left arm out and swing it.
+ * @brief Empty both rings and start tracing.
 */
-void Left_Sweep() {
-  s_ls.write(gaucho_pos[ls]-70);
-  s_lb.write(gaucho_pos[lb]+55);
-  s_w.write(gaucho_pos[w]-95);
-  Fix_Rest(In_Use_Left_Atk);
+void Trace_Start() {
+  trace_on = false;
+  trace_dump.core = -1;
+  for (Trace_Ring& ring : trace_rings) {
+    ring.head = 0;
+    ring.synced = false;
+  }
+  trace_on = true;
+  Console_Reply("ok");
 }
 
 /**
- * @brief Low right attack.
- * 
- * Swing arm outward (half of sweep) and arc it in a 90 degree angle.
+ * @brief Print whether tracing is on and what each ring holds.
 */
-void Right_Hook() {
-  s_rs.write(gaucho_pos[rs]+30);
-  s_rb.write(gaucho_pos[rb]+35);
-  s_w.write(gaucho_pos[w]+90);
-  Fix_Rest(In_Use_Right_Atk);
+void Report_Trace() {
+  for (int c = 0; c < 2; c++) {
+    const Trace_Ring& ring = trace_rings[c];
+    uint32_t first = Trace_First(ring);
+    Console_Reply("trace %s core%d events=%lu overwritten=%lu", trace_on ? "on" : "off", c,
+      (unsigned long)(ring.head - first), (unsigned long)first);
+  }
 }
 
 /**
- * @brief Low left attack.
- * 
- * Swing arm outward (half of sweep) and arc it in a 90 degree angle.
+ * @brief Send the next part of a trace dump.
+ *
+ * Sends whole frames while the TX ring buffer has room for them
+ * and carries on from there on the next loop(), so a dump neither
+ * drops frames nor stalls the loop. Tracing is stopped when the
+ * dump is asked for, one loop() before the first frame goes out,
+ * so no event is still being written.
 */
-void Left_Hook() {
-  s_ls.write(gaucho_pos[ls]-30);
-  s_lb.write(gaucho_pos[lb]-35);
-  s_w.write(gaucho_pos[w]-90);
-  Fix_Rest(In_Use_Left_Atk);
+void Trace_Send_Dump() {
+  while (trace_dump.core >= 0) {
+    Trace_Ring& ring = trace_rings[trace_dump.core];
+    if (trace_dump.next >= ring.head) {
+      if (++trace_dump.core < 2) trace_dump.next = Trace_First(trace_rings[trace_dump.core]);
+      else {
+        trace_dump.core = -1;
+        Console_Reply("trace sent %lu events", (unsigned long)trace_dump.sent);
+      }
+      continue;
+    }
+
+    Trace_Frame frame;
+    frame.type = TELEMETRY_TRACE;
+    frame.version = TELEMETRY_VERSION;
+    frame.core = trace_dump.core;
+    frame.count = min(ring.head - trace_dump.next, (uint32_t)TRACE_FRAME_EVENTS);
+    frame.mhz = ESP.getCpuFreqMHz();
+    frame.sync_cycles = ring.sync_cycles;
+    frame.sync_us = ring.sync_us;
+    for (int i = 0; i < frame.count; i++) frame.events[i] = ring.events[(trace_dump.next + i) % TRACE_EVENTS];
+    size_t size = TRACE_FRAME_HEADER + frame.count * sizeof(Trace_Event);
+    ((uint8_t*)&frame)[size] = Telemetry_Checksum((const uint8_t*)&frame, size);
+
+    uint8_t encoded[TELEMETRY_MAX_ENCODED];
+    size_t len = Cobs_Encode((const uint8_t*)&frame, size + 1, encoded);
+    if (Serial.availableForWrite() < (int)len) return;
+    Serial.write(encoded, len);
+    trace_dump.next += frame.count;
+    trace_dump.sent += frame.count;
+  }
 }
 
-bool In_Use_Right_Shot(int i) { return (i == rs || i == rb || i == lb); }
 /**
- * @brief Right side attack.
+ * @brief Run one console command.
  * 
- * Extend arm out and swing it to the right.
+ * list                  every parameter
+ * get <name>[i]         one parameter
+ * set <name>[i] <value> change a parameter live
+ * save                  store the live parameters in NVS
+ * load                  reload the parameters stored in NVS
+ * defaults              return to the built-in parameters
+ * boot                  boot phase timings
+ * deadlines             deadline monitor statistics
+ * link                  controller drop and restore timings
+ * memory                heap headroom and static RAM per subsystem
+ * sticks                stick shaping latency
+ * balance               center of mass and softened commands
+ * energy [reset]        estimated charge per action
+ * strikes [reset]       attack input to strike pose latency
+ * rates [reset]         control task rate residency
+ * pwm [reset]           servo frames and command to pulse delay
+ * bench                 run the self-benchmark, see Run_Bench()
+ * binds                 input bindings, strongest first
+ * bind <button> <action|none|hold> [priority]
+ *                       rebind a button live, save to keep it
+ * trace [start|dump]    event trace of both cores, see trace.h
+ * pack                  motion pack status and moves
+ * combos                combo timing statistics
 */
-void Right_Shot() {
-  s_rs.write(gaucho_pos[rs]+70);
-  s_rb.write(gaucho_pos[rb]-55);
-  s_lb.write(gaucho_pos[lb]-35);
-  Fix_Rest(In_Use_Right_Shot);
+void Console_Command(char* line) {
+  char* cmd = strtok(line, " \t");
+  char* arg = strtok(NULL, " \t");
+  char* val = strtok(NULL, " \t");
+  if (!cmd) return;
+
+  if (strcmp(cmd, "list") == 0) {
+    for (size_t d = 0; d < PARAM_COUNT; d++) Print_Param(param_defs[d]);
+  }
+  else if (strcmp(cmd, "get") == 0 || strcmp(cmd, "set") == 0) {
+    int index;
+    const Param_Def* def = arg ? Find_Param(arg, index) : NULL;
+    if (!def) {
+      Console_Reply("err unknown parameter");
+      return;
+    }
+    if (cmd[0] == 's') {
+      char* end;
+      long v = val ? strtol(val, &end, 10) : 0;
+      if (!val || *end != '\0' || v < def->min || v > def->max) {
+        Console_Reply("err %s range %d..%d", def->name, def->min, def->max);
+        return;
+      }
+      Params p = params;
+      *Param_Ptr(p, *def, index) = v;
+      Apply_Params(p);
+    }
+    Print_Param(*def);
+  }
+  else if (strcmp(cmd, "save") == 0) {
+    Console_Reply(Save_Params() ? "ok saved" : "err save failed");
+  }
+  else if (strcmp(cmd, "load") == 0) {
+    Params stored;
+    if (Load_Params(stored)) {
+      Apply_Params(stored);
+      Console_Reply("ok loaded");
+    }
+    else Console_Reply("err nothing stored");
+  }
+  else if (strcmp(cmd, "defaults") == 0) {
+    Apply_Params(default_params);
+    Console_Reply("ok defaults");
+  }
+  else if (strcmp(cmd, "boot") == 0) Report_Boot();
+  else if (strcmp(cmd, "deadlines") == 0) Report_Deadlines();
+  else if (strcmp(cmd, "link") == 0) Report_Link();
+  else if (strcmp(cmd, "memory") == 0) Report_Memory();
+  else if (strcmp(cmd, "sticks") == 0) Report_Sticks();
+  else if (strcmp(cmd, "energy") == 0) {
+    if (arg && strcmp(arg, "reset") == 0) Energy_Reset();
+    else Report_Energy();
+  }
+  else if (strcmp(cmd, "strikes") == 0) {
+    if (arg && strcmp(arg, "reset") == 0) {
+      xSemaphoreTake(control_lock, portMAX_DELAY);
+      memset(strike_latency, 0, sizeof(strike_latency));
+      xSemaphoreGive(control_lock);
+      Console_Reply("ok");
+    }
+    else Report_Strikes();
+  }
+  else if (strcmp(cmd, "binds") == 0) Report_Binds();
+  else if (strcmp(cmd, "bind") == 0) Bind_Command(arg, val, strtok(NULL, " \t"));
+  else if (strcmp(cmd, "bench") == 0) {
+    bench.requested = true;
+    Console_Reply("ok bench after this loop");
+  }
+  else if (strcmp(cmd, "rates") == 0) {
+    if (arg && strcmp(arg, "reset") == 0) {
+      memset(control_rate.resident_us, 0, sizeof(control_rate.resident_us));
+      memset(control_rate.ticks, 0, sizeof(control_rate.ticks));
+      memset(control_rate.tick_cycles, 0, sizeof(control_rate.tick_cycles));
+      control_rate.promotions = 0;
+      Console_Reply("ok");
+    }
+    else Report_Rates();
+  }
+  else if (strcmp(cmd, "pwm") == 0) {
+    if (arg && strcmp(arg, "reset") == 0) {
+      xSemaphoreTake(control_lock, portMAX_DELAY);
+      memset(servo_pwm.delay, 0, sizeof(servo_pwm.delay));
+      xSemaphoreGive(control_lock);
+      Console_Reply("ok");
+    }
+    else Report_Pwm();
+  }
+  else if (strcmp(cmd, "pack") == 0) Report_Pack();
+  else if (strcmp(cmd, "trace") == 0) {
+    if (arg && strcmp(arg, "start") == 0) Trace_Start();
+    else if (arg && strcmp(arg, "dump") == 0) {
+      trace_on = false;
+      trace_dump.core = 0;
+      trace_dump.next = Trace_First(trace_rings[0]);
+      trace_dump.sent = 0;
+    }
+    else Report_Trace();
+  }
+  else if (strcmp(cmd, "balance") == 0) {
+    Console_Reply("balance com=%ld,%ldmm softened=%lu held=%lu max=%luus",
+      (long)(balance.com.x / BAL_MM), (long)(balance.com.y / BAL_MM),
+      (unsigned long)balance.softened, (unsigned long)balance.held, (unsigned long)balance.max_us);
+  }
+  else if (strcmp(cmd, "combos") == 0) {
+    for (size_t c = 0; c < COMBO_COUNT; c++) {
+      Combo_Stats& stats = combo_stats[c];
+      Console_Reply("%s count=%u last=%u min=%u max=%u late=%u", combos[c].name,
+        stats.count, stats.last_span, stats.min_span, stats.max_span, stats.max_late);
+    }
+  }
+  else Console_Reply("err unknown command");
 }
 
-bool In_Use_Left_Shot(int i) { return (i == ls || i == lb || i == rb); }
 /**
- * @brief Left side attack.
+ * @brief Read whatever serial input has arrived, without blocking.
  * 
- * Extend arm out and swing it to the left.
+ * Bytes are collected into a line buffer and each complete line
+ * is run as a command. Over-long lines are dropped whole.
 */
-void Left_Shot() {
-  s_ls.write(gaucho_pos[ls]-70);
-  s_lb.write(gaucho_pos[lb]+55);
-  s_rb.write(gaucho_pos[rb]+35);
-  Fix_Rest(In_Use_Left_Shot);
+void Poll_Console() {
+  while (Serial.available() > 0) {
+    char c = Serial.read();
+    if (c == '\n' || c == '\r') {
+      if (console_overflow) Console_Reply("err line too long");
+      else if (console_len > 0) {
+        console_line[console_len] = '\0';
+        Trace_Begin(TRACE_CONSOLE);
+        Console_Command(console_line);
+        Trace_End(TRACE_CONSOLE);
+      }
+      console_len = 0;
+      console_overflow = false;
+    }
+    else if (console_len < CONSOLE_LINE - 1) console_line[console_len++] = c;
+    else console_overflow = true;
+  }
 }
 
-// Taunts
-rampInt t1_rs;
-rampInt t1_rb;
-rampInt t1_ls;
-rampInt t1_lb;
-bool In_Use_t1(int i) { return (i == rs || i == rb || i == ls || i == lb); }
+/*
+  HUD VARIABLES
+*/
+
+#define HUD_PERIOD 100
+#define HUD_I2C_ADDR 0x3C
+// Data bytes per I2C transaction, inside the Wire buffer
+#define HUD_I2C_CHUNK 32
+// Filtered ADC count shown as a full battery
+#define HUD_BATTERY_FULL 3150
+
+Hud_Field hud_battery = { 0, 0, 8 };
+Hud_Field hud_link = { 0, 11, 10 };
+Hud_Field hud_action = { 2, 0, HUD_COLS };
+Hud_Field hud_loop = { 4, 0, HUD_COLS };
+Hud_Field hud_notify = { 5, 0, HUD_COLS };
+Hud_Field hud_status = { 7, 0, HUD_COLS };
+
+Hud_Field* const hud_fields[] = { &hud_battery, &hud_link, &hud_action, &hud_loop, &hud_notify, &hud_status };
+
+Hud_Dirty hud_dirty;
+// False until the panel has been fully redrawn with the HUD
+bool hud_valid = false;
+unsigned long hud_timeout = 0;
+
+/*
+  HUD FUNCTIONS
+*/
+
 /**
- * @brief Taunt 1
+ * @brief Write the dirty column range of each page to the panel.
  * 
- * Stretch arms, warming up for a battle.
- * Blinks led blue.
- * Toggles off crouch.
+ * Each dirty page costs one short command transaction to set the
+ * column and page window, then the changed bytes themselves.
 */
-void WARMING_UP() {
-  crouched = false;
-  led_state = BLUE;
-  s_rs.write(t1_rs.update());
-  s_rb.write(t1_rb.update());
-  s_ls.write(t1_ls.update());
-  s_lb.write(t1_lb.update());
-  Fix_Rest(In_Use_t1);
+void Hud_Flush() {
+  uint8_t* fb = lcd.getBuffer();
+  display_busy = true;
+  Trace_Begin(TRACE_DISPLAY);
+  for (int p = 0; p < HUD_PAGES; p++) {
+    int lo = hud_dirty.lo[p];
+    int hi = hud_dirty.hi[p];
+    if (lo > hi) continue;
+
+    Wire.beginTransmission(HUD_I2C_ADDR);
+    Wire.write((uint8_t)0x00);
+    Wire.write((uint8_t)SSD1306_COLUMNADDR);
+    Wire.write((uint8_t)lo);
+    Wire.write((uint8_t)hi);
+    Wire.write((uint8_t)SSD1306_PAGEADDR);
+    Wire.write((uint8_t)p);
+    Wire.write((uint8_t)p);
+    Wire.endTransmission();
+
+    for (int x = lo; x <= hi; x += HUD_I2C_CHUNK) {
+      int n = min(HUD_I2C_CHUNK, hi - x + 1);
+      Wire.beginTransmission(HUD_I2C_ADDR);
+      Wire.write((uint8_t)0x40);
+      Wire.write(fb + p * HUD_WIDTH + x, n);
+      Wire.endTransmission();
+    }
+  }
+  Trace_End(TRACE_DISPLAY);
+  display_busy = false;
+  Hud_Clean(hud_dirty);
 }
 
-rampInt t2_w;
-unsigned long t2_timeout = 0;
-bool In_Use_t2_p1(int i) { return (i == rf || i == lf || i == rs || i == ls || i == rb || i == lb); }
-bool In_Use_t2_p2(int i) { return (i == rs || i == ls || i == w); }
 /**
- * @brief Taunt 2
+ * @brief Refresh every field from live state and flush what changed.
  * 
- * Raises body in the air before crashing down
- * and stretching out arms while rotating waist 
- * back and forth.
- * Blinks led red
- * Toggles off crouch.
+ * The first call after boot or after the pairing screen clears the
+ * panel and sends it whole. After that only changed cells go out.
 */
-void BEHOLD() {
-  crouched = false;
-  led_state = RED;
-  if (millis() < t2_timeout + 350) {
-    s_rf.write(gaucho_pos[rf]+20);
-    s_lf.write(gaucho_pos[lf]-20);
-    s_rs.write(gaucho_pos[rs]+70);
-    s_ls.write(gaucho_pos[ls]-70);
-    s_rb.write(gaucho_pos[rb]-55);
-    s_lb.write(gaucho_pos[lb]+55);
-    Fix_Rest(In_Use_t2_p1);
+void Hud_Update() {
+  unsigned long ms = millis();
+  if (hud_valid && ms < hud_timeout + HUD_PERIOD) return;
+  hud_timeout = ms;
+
+  uint8_t* fb = lcd.getBuffer();
+  if (!hud_valid) {
+    lcd.clearDisplay();
+    for (Hud_Field* field : hud_fields) Hud_Invalidate(*field);
   }
+
+  char text[HUD_COLS + 1];
+
+  float voltage = Battery_Voltage();
+  if (voltage < params.low_battery) Hud_Set(fb, hud_dirty, hud_battery, ms % 1000 < 500 ? "BAT LOW" : "");
   else {
-    s_rs.write(gaucho_pos[rs]+50);
-    s_ls.write(gaucho_pos[ls]-50);
-    s_w.write(t2_w.update());
-    Fix_Rest(In_Use_t2_p2);
+    // The console allows a cutoff at or above full, which reads as full
+    int span = HUD_BATTERY_FULL - params.low_battery;
+    int pct = span > 0 ? (int)((voltage - params.low_battery) * 100 / span) : 100;
+    snprintf(text, sizeof(text), "BAT %3d%%", constrain(pct, 0, 100));
+    Hud_Set(fb, hud_dirty, hud_battery, text);
+  }
+
+  if (link_drop_us) Hud_Set(fb, hud_dirty, hud_link, "LNK  ---");
+  else {
+    snprintf(text, sizeof(text), "LNK %3lums", (unsigned long)min(link_stats.interval_us / 1000, (uint32_t)999));
+    Hud_Set(fb, hud_dirty, hud_link, text);
   }
+
+  Hud_Set(fb, hud_dirty, hud_action, action_names[action]);
+
+  snprintf(text, sizeof(text), "LOOP %6luus", (unsigned long)loop_us);
+  Hud_Set(fb, hud_dirty, hud_loop, text);
+  snprintf(text, sizeof(text), "CTRL %6luus", (unsigned long)notify_us);
+  Hud_Set(fb, hud_dirty, hud_notify, text);
+
+  if (safe_reason != SAFE_NONE) {
+    snprintf(text, sizeof(text), "SAFE %s", safe_reason_names[safe_reason]);
+    Hud_Set(fb, hud_dirty, hud_status, text);
+  }
+  else if (recorder_state == REC_PLAYBACK) Hud_Set(fb, hud_dirty, hud_status, "PLAYBACK");
+  else if (recorder_state != REC_OFF) Hud_Set(fb, hud_dirty, hud_status, "REC");
+  else Hud_Set(fb, hud_dirty, hud_status, crouched ? "CROUCH" : "");
+
+  if (!hud_valid) {
+    display_busy = true;
+    Trace_Begin(TRACE_DISPLAY);
+    lcd.display();
+    Trace_End(TRACE_DISPLAY);
+    display_busy = false;
+    Hud_Clean(hud_dirty);
+    hud_valid = true;
+  }
+  else Hud_Flush();
 }
 
-rampInt t3_rb;
-rampInt t3_lb;
-unsigned long t3_timeout;
-bool In_Use_t3(int i) { return (i == rb || i == lb); }
+/*
+  BENCHMARK FUNCTIONS
+*/
+
 /**
- * @brief Taunt 3
+ * @brief Whether the benchmark may carry on.
  * 
- * Raise fists up slowly then quickly shift them down.
- * Turns led orange.
- * Toggles off crouch.
+ * A safe pose, a dropped pad or a flat pack ends it early.
 */
-void DUST_OFF() {
-  crouched = false;
-  led_state = ALL;
-  if (millis() < t3_timeout + 500) {
-    s_rb.write(t3_rb.update());
-    s_lb.write(t3_lb.update());
-  }
-  else {
-    s_rb.write(gaucho_pos[rb]);
-    s_lb.write(gaucho_pos[lb]);
-  }
-  Fix_Rest(In_Use_t3);
+bool Bench_Ok() {
+  return safe_reason == SAFE_NONE && Battery_Voltage() >= params.low_battery;
+}
+
+void Bench_Begin(Bench_Step& st) {
+  memset(&st, 0, sizeof(st));
+  st.bat = Battery_Voltage();
+  st.bat_min = UINT16_MAX;
 }
 
-bool In_Use_t4(int i) { return (i == rs || i == ls || i == rb || i == lb || i == w); }
 /**
- * @brief Taunt 4
+ * @brief Account one timed sample to a step.
  * 
- * Beckon the opponent forward for a fight.
- * Turns led turquoise.
+ * @param cycles CPU cycles the sample took.
+ * @param reading raw battery reading taken with it.
 */
-void GIVE_IT_YOUR_ALL() {
-  led_state = TURQUOISE;
-  s_rs.write(gaucho_pos[rs]+70);
-  s_ls.write(gaucho_pos[ls]-70);
-  s_rb.write(gaucho_pos[rb]-55);
-  s_lb.write(gaucho_pos[lb]-35);
-  s_w.write(gaucho_pos[w]+85);
-  Fix_Rest(In_Use_t4);
+void Bench_Sample(Bench_Step& st, uint32_t cycles, uint16_t reading) {
+  st.n++;
+  st.cycles += cycles;
+  if (cycles > st.max_cycles) st.max_cycles = cycles;
+  if (reading < st.bat_min) st.bat_min = reading;
 }
 
-// LED Animations
 /**
- * @brief Set led to purple.
+ * @brief Send one line of benchmark output.
+ * 
+ * Waits for room in the TX buffer rather than dropping the line,
+ * the benchmark's output is the whole point of running it.
 */
-void Idle_Led() {
-  analogWrite(R, 255);
-  analogWrite(G, 0);
-  analogWrite(B, 255);
+void Bench_Line(const char* fmt, ...) {
+  char text[TELEMETRY_TEXT_MAX + 1];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(text, sizeof(text), fmt, args);
+  va_end(args);
+  while (Serial.availableForWrite() < TELEMETRY_MAX_ENCODED) delay(1);
+  Console_Reply("%s", text);
+}
+
+void Bench_Report(const char* kind, const char* name, const Bench_Step& st) {
+  float mhz = ESP.getCpuFreqMHz();
+  int sag = st.bat_min < st.bat ? st.bat - st.bat_min : 0;
+  Bench_Line("bench,%d,%s,%s,%lu,%.1f,%.1f,%lu,%u,%lu", bench.step++, kind, name,
+    (unsigned long)st.n, st.n ? st.cycles / st.n / mhz : 0.0f, st.max_cycles / mhz,
+    (unsigned long)st.writes, st.bat, (unsigned long)sag * BATTERY_FULL_SCALE_MV / 4095);
 }
 
 /**
- * @brief Turn off led
+ * @brief Back to the rest pose and let the pack recover.
 */
-void Close_Led() {
-  analogWrite(R, 0);
-  analogWrite(G, 0);
-  analogWrite(B, 0);
+void Bench_Rest() {
+  xSemaphoreTake(control_lock, portMAX_DELAY);
+  crouched = false;
+  Idle();
+  Commit_Joints();
+  xSemaphoreGive(control_lock);
+  for (int t = 0; t < BENCH_SETTLE; t += CONTROL_TICK) {
+    Sample_Battery();
+    delay(CONTROL_TICK);
+  }
 }
 
 /**
- * @brief Glows led a certain value.
- * 
- * @param r_val pointer to R led value.
- * @param g_val pointer to G led value.
- * @param b_val pointer to B led value.
- * @param timeout pointer to timeout.
- * @param r_max max value for R led [0,256]
- * @param g_max max value for G led [0,256]
- * @param b_max max value for B led [0,256]
+ * @brief Sweep one joint 0, +BENCH_SWEEP, -BENCH_SWEEP and back to 0
+ * degrees off its gaucho angle, a degree per tick.
 */
-void Glow_Led(unsigned* r_val, unsigned* g_val, unsigned* b_val, unsigned long* timeout, unsigned r_max, unsigned g_max, unsigned b_max) {
-  unsigned long ms = millis();
-  if (ms > *timeout + 1) {
-    if (r_val != NULL) (*r_val) = ((*r_val)+1)%((r_max*2)+1);
-    if (g_val != NULL) (*g_val) = ((*g_val)+1)%((g_max*2)+1);
-    if (b_val != NULL) (*b_val) = ((*b_val)+1)%((b_max*2)+1);
+void Bench_Joint(int i, Bench_Step& st) {
+  TickType_t wake = xTaskGetTickCount();
+  uint32_t writes = joint_writes;
+  for (int k = 0; k <= 4 * BENCH_SWEEP && Bench_Ok(); k++) {
+    int d = k <= BENCH_SWEEP ? k : k <= 3 * BENCH_SWEEP ? 2 * BENCH_SWEEP - k : k - 4 * BENCH_SWEEP;
+    xSemaphoreTake(control_lock, portMAX_DELAY);
+    uint32_t start = ESP.getCycleCount();
+    action = ACT_IDLE;
+    for (int j = 0; j < 9; j++) joint_cmd[j] = params.gaucho_pos[j];
+    joint_cmd[i] = constrain(params.gaucho_pos[i] + d, 0, 180);
+    Commit_Joints();
+    uint32_t cycles = ESP.getCycleCount() - start;
+    xSemaphoreGive(control_lock);
+    Bench_Sample(st, cycles, Sample_Battery());
+    vTaskDelayUntil(&wake, pdMS_TO_TICKS(CONTROL_TICK));
   }
-  analogWrite(R, (r_val != NULL) ? ( (*r_val < r_max) ? *r_val : ((r_max-1)*2)-(*r_val) ) : 0);
-  analogWrite(G, (g_val != NULL) ? ( (*g_val < g_max) ? *g_val : ((g_max-1)*2)-(*g_val) ) : 0);
-  analogWrite(B, (b_val != NULL) ? ( (*b_val < b_max) ? *b_val : ((b_max-1)*2)-(*b_val) ) : 0);
+  st.writes = joint_writes - writes;
 }
 
-unsigned long atk_led_timeout = 0;
-unsigned atk_r_val = 0;
-unsigned atk_b_val = 0;
 /**
- * @brief Glow led purple.
+ * @brief Run one action for BENCH_CYCLES evaluations from its first beat.
 */
-void Atk_Led() { Glow_Led(&atk_r_val, NULL, &atk_b_val, &atk_led_timeout, 256, 0, 256); }
+void Bench_Run_Action(uint8_t act, Bench_Step& st) {
+  xSemaphoreTake(control_lock, portMAX_DELAY);
+  Restart_Action(act);
+  xSemaphoreGive(control_lock);
+  TickType_t wake = xTaskGetTickCount();
+  uint32_t writes = joint_writes;
+  for (int c = 0; c < BENCH_CYCLES && Bench_Ok(); c++) {
+    xSemaphoreTake(control_lock, portMAX_DELAY);
+    uint32_t start = ESP.getCycleCount();
+    Run_Action(act);
+    Commit_Joints();
+    uint32_t cycles = ESP.getCycleCount() - start;
+    xSemaphoreGive(control_lock);
+    Bench_Sample(st, cycles, Sample_Battery());
+    vTaskDelayUntil(&wake, pdMS_TO_TICKS(CONTROL_TICK));
+  }
+  st.writes = joint_writes - writes;
+}
 
-unsigned long blue_led_timeout = 0;
-unsigned blue_led_val = 0;
 /**
- * @brief Glow led blue.
+ * @brief Full frame flushes back to back, writes in panel bytes.
 */
-void Blue_Led() { Glow_Led(NULL, NULL, &blue_led_val, &blue_led_timeout, 0, 0, 256); }
+void Bench_Oled_Full(Bench_Step& st) {
+  for (int f = 0; f < BENCH_FLUSHES && Bench_Ok(); f++) {
+    memset(lcd.getBuffer(), f & 1 ? 0xAA : 0x55, HUD_PAGES * HUD_WIDTH);
+    display_busy = true;
+    uint32_t start = ESP.getCycleCount();
+    lcd.display();
+    uint32_t cycles = ESP.getCycleCount() - start;
+    display_busy = false;
+    st.writes += HUD_PAGES * HUD_WIDTH;
+    Bench_Sample(st, cycles, Sample_Battery());
+  }
+}
 
-unsigned long red_led_timeout = 0;
-unsigned r_val = 255;
 /**
- * @brief Blink led red.
+ * @brief HUD sized partial flushes back to back, one field changing.
 */
-void Red_Led() {
-  unsigned long ms = millis();
-  if (ms > red_led_timeout + 50) {
-    r_val = 0;
-    red_led_timeout = ms;
+void Bench_Oled_Hud(Bench_Step& st) {
+  uint8_t* fb = lcd.getBuffer();
+  lcd.clearDisplay();
+  lcd.display();
+  Hud_Clean(hud_dirty);
+  for (Hud_Field* field : hud_fields) Hud_Invalidate(*field);
+  char text[HUD_COLS + 1];
+  for (int f = 0; f < BENCH_FLUSHES && Bench_Ok(); f++) {
+    snprintf(text, sizeof(text), "BENCH %d", f);
+    Hud_Set(fb, hud_dirty, hud_status, text);
+    for (int p = 0; p < HUD_PAGES; p++) {
+      if (hud_dirty.lo[p] <= hud_dirty.hi[p]) st.writes += hud_dirty.hi[p] - hud_dirty.lo[p] + 1;
+    }
+    uint32_t start = ESP.getCycleCount();
+    Hud_Flush();
+    Bench_Sample(st, ESP.getCycleCount() - start, Sample_Battery());
   }
-  else r_val = 255;
-  analogWrite(R, r_val);
-  analogWrite(G, 0);
-  analogWrite(B, 0);
+  hud_valid = false;
 }
 
-unsigned long all_led_timeout = 0;
-unsigned all_led_r_val = 0;
-unsigned all_led_g_val = 0;
-unsigned all_led_b_val = 0;
 /**
- * @brief Glow all colors of led.
+ * @brief Battery ADC read back to back.
 */
-void All_Led() { Glow_Led(&all_led_r_val, &all_led_g_val, &all_led_b_val, &all_led_timeout, 256, 256, 256); }
+void Bench_Adc(Bench_Step& st) {
+  for (int n = 0; n < BENCH_ADC_SAMPLES; n++) {
+    uint32_t start = ESP.getCycleCount();
+    uint16_t reading = analogRead(battery);
+    Bench_Sample(st, ESP.getCycleCount() - start, reading);
+  }
+}
 
-unsigned long turquoise_led_timeout = 0;
-unsigned turquoise_led_g_val = 0;
-unsigned turquoise_led_b_val = 0;
 /**
- * @brief Glow led turquoise.
+ * @brief Run the benchmark script and report it over serial.
+ * 
+ * Runs from loop() with the robot standing free, the controller
+ * ignored and the HUD frozen. Output is one CSV line per step,
+ * as console replies:
+ * 
+ *   bench,begin,<build date>,<build time>,<MHz>,<battery counts>
+ *   bench,<step>,<kind>,<name>,<n>,<mean us>,<max us>,<writes>,<battery counts>,<sag mV>
+ *   bench,end,<ms>,<ok|aborted>
+ * 
+ * kind is joint, action, oled or adc. A step's n timed samples are
+ * a commit per tick for joints and actions, a flush for the panel
+ * and a read for the ADC. writes are servo writes, or panel bytes
+ * for oled steps. Battery counts are the filtered reading as the
+ * step starts and sag how far the raw reading fell below it.
+ * Steps are numbered in a fixed order, so runs on different
+ * robots or builds line up row for row.
 */
-void Turquoise_Led() { Glow_Led(NULL, &turquoise_led_g_val, &turquoise_led_b_val, &turquoise_led_timeout, 256, 256, 0); }
+void Run_Bench() {
+  bench.requested = false;
+  bench.active = true;
+  bench.step = 0;
+  unsigned long start = millis();
+  Bench_Line("bench,begin,%s,%s,%lu,%u", __DATE__, __TIME__,
+    (unsigned long)ESP.getCpuFreqMHz(), (unsigned)Battery_Voltage());
+
+  Bench_Step st;
+  static const char* const bench_joint_names[9] = { "rs", "rb", "ls", "lb", "w", "rh", "rf", "lh", "lf" };
+  for (int i = 0; i < 9 && Bench_Ok(); i++) {
+    Bench_Rest();
+    Bench_Begin(st);
+    Bench_Joint(i, st);
+    Bench_Report("joint", bench_joint_names[i], st);
+  }
+  for (size_t a = 0; a < sizeof(bench_actions) / sizeof(bench_actions[0]) && Bench_Ok(); a++) {
+    Bench_Rest();
+    Bench_Begin(st);
+    Bench_Run_Action(bench_actions[a], st);
+    Bench_Report("action", action_names[bench_actions[a]], st);
+  }
+  Bench_Rest();
+  if (Bench_Ok()) {
+    Bench_Begin(st);
+    Bench_Oled_Full(st);
+    Bench_Report("oled", "full", st);
+  }
+  if (Bench_Ok()) {
+    Bench_Begin(st);
+    Bench_Oled_Hud(st);
+    Bench_Report("oled", "hud", st);
+  }
+  if (Bench_Ok()) {
+    Bench_Begin(st);
+    Bench_Adc(st);
+    Bench_Report("adc", "battery", st);
+  }
+
+  bool ok = Bench_Ok();
+  if (safe_reason == SAFE_NONE) Bench_Rest();
+  hud_valid = false;
+  pairing_phase = -1;
+  bench.active = false;
+  Bench_Line("bench,end,%lu,%s", millis() - start, ok ? "ok" : "aborted");
+}
 
 /*
   PS3 CALLBACKS
 */
-void notify() {
+void CONTROL_ATTR notify() {
+  unsigned long notify_start = micros();
+  uint32_t notify_cycles = ESP.getCycleCount();
+  bool notify_display_busy = display_busy;
   ps3_button_t btn_down = Ps3.data.button;
   ps3_analog_stick_t stick_data = Ps3.data.analog.stick;
   int lx = stick_data.lx;
   int ly = stick_data.ly;
   int rx = stick_data.rx;
   int ry = stick_data.ry;
+  uint32_t pressed = Pack_Buttons(Ps3.event.button_down);
+  uint32_t held = Pack_Buttons(btn_down);
+  Trace_Begin(TRACE_NOTIFY);
+  Deadline_Input(notify_start);
+  if (link_drop_us) Link_Restored(notify_start);
+
+  Trace_Begin(TRACE_LOCK_WAIT);
+  xSemaphoreTake(control_lock, portMAX_DELAY);
+  Trace_End(TRACE_LOCK_WAIT);
+
+  // Hold the safe pose until the control path is keeping up again
+  if (safe_reason != SAFE_NONE) {
+    if (Deadline_Sustained()) {
+      xSemaphoreGive(control_lock);
+      notify_us = micros() - notify_start;
+      Deadline_Record(DEADLINE_NOTIFY, notify_us);
+      Trace_End(TRACE_NOTIFY);
+      return;
+    }
+    safe_reason = SAFE_NONE;
+  }
+
+  // The benchmark chord only counts on the first packet after boot
+  if (bench.window) {
+    bench.window = false;
+    if (held == BENCH_CHORD) bench.requested = true;
+  }
+  // The benchmark owns the joints until it finishes
+  if (bench.requested || bench.active) {
+    xSemaphoreGive(control_lock);
+    notify_us = micros() - notify_start;
+    Deadline_Record(DEADLINE_NOTIFY, notify_us);
+    Trace_End(TRACE_NOTIFY);
+    return;
+  }
+
+  // A lone attack edge strikes before any housekeeping
+  bool strike = Strike_Eligible(pressed, held);
+  bool struck = strike && params.fast_attacks;
+  if (struck) Strike(pressed, notify_cycles);
+
+  // Recorder controls
+  if (pressed & BTN_PS) Toggle_Recording();
+  if (pressed & BTN_TRIANGLE) Toggle_Playback();
+
+  // Playback owns the joints until it finishes
+  if (recorder_state == REC_PLAYBACK) {
+    xSemaphoreGive(control_lock);
+    notify_us = micros() - notify_start;
+    Deadline_Record(DEADLINE_NOTIFY, notify_us);
+    Trace_End(TRACE_NOTIFY);
+    return;
+  }
 
   // Toggle states according to their respective buttons
   if (Ps3.event.button_down.cross) crouched = !crouched;
 
+  int shaped[4];
+  uint8_t gait = Shape_Sticks(lx, ly, rx, ry, shaped, notify_start);
+  Rate_Input(pressed, held, gait);
+
   // Check if battery low
-  float voltage = 0;
-  for (int i = 0; i < K; i++) voltage += readings[i];
-  voltage /= K;
-  if (voltage < 2550) { 
+  float voltage = Battery_Voltage();
+  if (struck) {
+    // Strike() has already dispatched and committed
+  }
+  else if (voltage < params.low_battery) { 
     led_state = CLOSED;
+    combo_active = -1;
+    pack_active = -1;
     Idle(); 
   }
   else {
-    // Adjust timeouts
-    ps3_button_t btn_pressed = Ps3.event.button_down;
-    if (btn_pressed.right) t2_timeout = millis();
-    if (btn_pressed.down) {
-      t3_timeout = millis();
-      t3_rb.go(gaucho_pos[rb]);
-      t3_rb.go(gaucho_pos[rb]+35, 500, LINEAR);
-      t3_lb.go(gaucho_pos[lb]);
-      t3_lb.go(gaucho_pos[lb]-35, 500, LINEAR);
-    }
-    if (btn_pressed.select) back_recovery_start = millis();
-    if (btn_pressed.start) front_recovery_start = millis();
-    // Check if any buttons are pressed
-    if (
-      btn_down.l1 || btn_down.l2 || btn_down.r1 || 
-      btn_down.r2 || btn_down.up || btn_down.right ||
-      btn_down.down || btn_down.left || btn_down.square ||
-      btn_down.circle || btn_down.cross || btn_down.select || btn_down.start
-    ) {
-      led_state = ATK;
+    Adjust_Timeouts(pressed);
 
-      if (btn_down.up) WARMING_UP();
-      if (btn_down.right) BEHOLD();
-      if (btn_down.down) DUST_OFF();
-      if (btn_down.left) GIVE_IT_YOUR_ALL();
-      if (btn_down.r1) Right_Hook();
-      if (btn_down.l1) Left_Hook();
-      if (btn_down.r2) Right_Sweep();
-      if (btn_down.l2) Left_Sweep();
-      if (btn_down.circle) Right_Shot();
-      if (btn_down.square) Left_Shot();
-      if (btn_down.select) Back_Recovery(2100);
-      if (btn_down.start) Front_Recovery(2100);
-    }
-    // Else check if the stick movement is above a certain threshold
-		else if (abs(lx) > 10 || abs(ly) > 10 || abs(rx) > 10 || abs(ry) > 10) {
-      led_state = ATK;
+    int bound = Dispatch_Buttons(held);
 
-      // Check which stick received the stronger signal
-    	if (abs(ry) + abs(rx) < abs(ly) + abs(lx)) {
-      	if (abs(ly) > abs(lx)) {
-					if (ly < 0) Forward(350);
-        	else Backward(350);
-      	}
-      	else {
-					if (lx < 0) Right(350);
-        	else Left(350);
-      	}
-    	}
-    	else {
-      		if (rx < 0) Sidestep_Left(250);
-      		else Sidestep_Right(250);
-    	}
-  	}
-		// No input, idle
-		else {
+    // Feed the combo automaton, a running combo owns the joints,
+    // then the motion pack's triggers
+    if (pressed) Combo_Input(pressed, millis());
+    if (pressed && combo_active < 0) Pack_Input(pressed, held);
+    if (combo_active >= 0) Run_Combo();
+    else if (pack_active >= 0) Run_Pack_Move();
+    // Otherwise the winning button binding, then the sticks
+    else if (bound != BIND_NONE) {
+      led_state = ATK;
+      if (bound != BIND_HOLD) Run_Action(bound);
+    }
+    else if (gait != GAIT_NONE) {
+      led_state = ATK;
+      Run_Action(Dispatch_Stick(gait, shaped));
+    }
+    // No input, idle
+    else {
       led_state = IDLE;
       Idle(); 
     }
   }
+
+  if (!struck) {
+    Commit_Joints();
+    if (strike) Strike_Record(STRIKE_FULL, ESP.getCycleCount() - notify_cycles);
+  }
+
+  const int8_t sticks[4] = { stick_data.lx, stick_data.ly, stick_data.rx, stick_data.ry };
+  Record_Tick(pressed, sticks);
+  xSemaphoreGive(control_lock);
+
+  Profile_Control(ESP.getCycleCount() - notify_cycles, notify_display_busy);
+  notify_us = micros() - notify_start;
+  Deadline_Record(DEADLINE_NOTIFY, notify_us);
+  Trace_End(TRACE_NOTIFY);
 }
 
 void On_Connect() {
 	lcd.setRotation(0);
 	Ps3.setPlayer(1);
   led_state = IDLE;
+  // A combo or pack move may still be playing out from before the drop
+  xSemaphoreTake(control_lock, portMAX_DELAY);
+  servo_pwm.source = SERVO_PACKET;
 	Idle();
+  Commit_Joints();
+  xSemaphoreGive(control_lock);
+  last_input_ms = millis();
+  if (!boot_us[BOOT_CONNECT]) Boot_Mark(BOOT_CONNECT);
+  if (link_drop_us) link_stats.connect_us = micros() - link_drop_us;
 }
 
-void setup() {
-  // LED Initialization
-  pinMode(R, OUTPUT);
-  pinMode(G, OUTPUT);
-  pinMode(B, OUTPUT);
+/**
+ * @brief Start timing the drop. The stack keeps listening, so the
+ * pad reconnects in the background while loop() carries on.
+*/
+void On_Disconnect() {
+  link_stats.drops++;
+  link_stats.connect_us = 0;
+  link_drop_us = micros();
+}
 
-  // Servo Initialization
-	for (int i = 0; i < 9; i++) joints[i].attach(servo_pins[i]);
+// Signalled by Init_Task once the display and filesystem are up
+SemaphoreHandle_t init_done = NULL;
 
+/**
+ * @brief Bring up the display and filesystem on core 0.
+ * 
+ * Both are slow and touch nothing the Bluetooth stack or servos
+ * need, so they run here while setup() carries on with those
+ * on core 1.
+*/
+void Init_Task(void* arg) {
   // Battery Monitoring Initialization
 	lcd.begin(SSD1306_SWITCHCAPVCC, 0x3C);
 	lcd.clearDisplay();
-	pinMode(battery, INPUT);
 
 	lcd.setRotation(1);
 	lcd.setTextSize(1);
 	lcd.setTextColor(SSD1306_WHITE);
+  Boot_Mark(BOOT_DISPLAY);
+
+  // Recorder Initialization
+  recorder_fs_ok = LittleFS.begin(true);
+  Boot_Mark(BOOT_FS);
+
+  xSemaphoreGive(init_done);
+  vTaskDelete(NULL);
+}
+
+void setup() {
+  Boot_Mark(BOOT_SETUP);
+
+  // LED Initialization
+  pinMode(R, OUTPUT);
+  pinMode(G, OUTPUT);
+  pinMode(B, OUTPUT);
+	pinMode(battery, INPUT);
+
+  // Telemetry Initialization
+  Serial.setTxBufferSize(TELEMETRY_TX_BUFFER);
+  Serial.begin(115200);
+
+  // Parameter Initialization
+  prefs.begin(PARAMS_NAMESPACE, false);
+  Params stored;
+  if (Load_Params(stored)) params = stored;
+  Boot_Mark(BOOT_PARAMS);
+
+  // Display and filesystem come up on core 0 meanwhile
+  init_done = xSemaphoreCreateBinary();
+  xTaskCreatePinnedToCore(Init_Task, "init", 4096, NULL, 1, NULL, 0);
+
+  // Control Initialization
+  esp_task_wdt_init(CONTROL_WDT_S, true);
+  // Servos are attached one by one by the control task, see Soft_Start_Tick()
+  Servo_Configure();
+  control_lock = xSemaphoreCreateMutex();
+  Compile_Combos();
+  Compile_Dispatch();
+  // After a brownout or watchdog reset the servos pick up the
+  // checkpointed pose straight away, see Warm_Boot()
+  if (!Warm_Boot()) Idle();
+  xTaskCreatePinnedToCore(Control_Task, "control", 4096, NULL, 2, &control_task, 1);
+  // Only moves started by notify() read the pack, and the pad is
+  // not up yet, so the control task need not wait for the check
+  Load_Motion_Pack();
 
 	// Ps3 Initialization
 	Ps3.attach(notify);
 	Ps3.attachOnConnect(On_Connect);
+	Ps3.attachOnDisconnect(On_Disconnect);
 	Ps3.begin("2c:81:58:3a:93:f7");
+  Boot_Mark(BOOT_BLUETOOTH);
 
   // Animation Ramps Initialization
-  t1_rs.go(gaucho_pos[rs]);
-  t1_rs.go(gaucho_pos[rs]+70, 1000, LINEAR, FORTHANDBACK);
-  t1_rb.go(gaucho_pos[rb]);
-  t1_rb.go(gaucho_pos[rb]-55, 1000, LINEAR, FORTHANDBACK);
-  t1_ls.go(gaucho_pos[ls]);
-  t1_ls.go(gaucho_pos[ls]-70, 1000, LINEAR, FORTHANDBACK);
-  t1_lb.go(gaucho_pos[lb]);
-  t1_lb.go(gaucho_pos[lb]+55, 1000, LINEAR, FORTHANDBACK);
-  
-  t2_w.go(gaucho_pos[w]-95);
-  t2_w.go(gaucho_pos[w]+85, 1000, LINEAR, FORTHANDBACK);
-}
-
-unsigned long init_timeout = 0;
-unsigned init_led_val = 0;
+  Init_Taunt_Ramps();
+
+  xSemaphoreTake(init_done, portMAX_DELAY);
+  xTaskCreatePinnedToCore(Recorder_Task, "recorder", 4096, NULL, 1, &recorder_task, 0);
+  Boot_Mark(BOOT_READY);
+  heap_after_setup = ESP.getFreeHeap();
+}
+
 void loop() {
-  while (!Ps3.isConnected()) {
-    unsigned long ms = millis();
+  // Blocks for the whole script, kept out of the loop deadline
+  if (bench.requested && !soft_start) {
+    Run_Bench();
+    return;
+  }
 
-    if (ms > init_timeout + 2) {
-      init_led_val = (init_led_val+1)%511;
-      init_timeout = ms;
+  unsigned long loop_start = micros();
+  Trace_Begin(TRACE_LOOP);
+
+  // Pairing animation while the pad is away, control carries on regardless
+  Sample_Battery();
+
+  bool connected = Ps3.isConnected();
+  if (connected != link_up) {
+    link_up = connected;
+    if (!connected) lcd.setRotation(1);
+    hud_valid = false;
+    pairing_phase = -1;
+  }
+  if (!connected) Pairing_Step();
+  else {
+    switch (led_state) {
+      case IDLE:
+        Idle_Led();
+        break;
+      case CLOSED:
+        Close_Led();
+        break;
+      case ATK:
+        Atk_Led();
+        break;
+      case BLUE:
+        Blue_Led();
+        break;
+      case RED:
+        Red_Led();
+        break;
+      case ALL:
+        All_Led();
+        break;
+      case TURQUOISE:
+        Turquoise_Led();
+        break;
     }
 
-    Waiting_To_Pair( ( ((init_led_val < 256) ? init_led_val : 510 - init_led_val)/17 ) % 4 );
-    analogWrite(R, (init_led_val < 256) ? init_led_val : 510 - init_led_val);
-    analogWrite(B, (init_led_val < 256) ? init_led_val : 510 - init_led_val);
-	}
+    Hud_Update();
+  }
 
-  switch (led_state) {
-		case IDLE:
-			Idle_Led();
-			break;
-		case CLOSED:
-			Close_Led();
-			break;
-		case ATK:
-			Atk_Led();
-			break;
-    case BLUE:
-      Blue_Led();
-      break;
-    case RED:
-      Red_Led();
-      break;
-    case ALL:
-      All_Led();
-      break;
-    case TURQUOISE:
-      Turquoise_Led();
-      break;
-	}
+  if (link_report_pending) {
+    link_report_pending = false;
+    Report_Link();
+  }
+  if (!boot_reported && boot_us[BOOT_CONNECT] && boot_us[BOOT_SERVOS]) {
+    boot_reported = true;
+    Report_Boot();
+  }
+  if (trace_dump.core >= 0) Trace_Send_Dump();
+  Poll_Console();
+
+  unsigned long ms = millis();
+  if (ms >= telemetry.timeout + TELEMETRY_PERIOD) {
+    telemetry.timeout = ms;
+    if (params.telemetry) Send_Telemetry();
+  }
+  if (ms >= profile.timeout + PROFILE_PERIOD) {
+    profile.timeout = ms;
+    Send_Profile();
+  }
 
-	Display_Voltage();
+  loop_us = micros() - loop_start;
+  Deadline_Record(DEADLINE_LOOP, loop_us);
+  Trace_End(TRACE_LOOP);
 }
\ No newline at end of file
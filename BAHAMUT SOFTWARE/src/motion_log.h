@@ -0,0 +1,126 @@
+#ifndef MOTION_LOG_H
+#define MOTION_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+  MOTION LOG FORMAT
+
+  A recording is a short header followed by variable length records,
+  one per control tick in which something changed:
+
+    byte 0     milliseconds since the previous record (saturates at 255,
+               longer gaps are padded with empty records)
+    byte 1-2   flags, little endian
+    joints     one byte per joint flagged in bits 0-8, in joint order.
+               int8 deltas from the previous pose, or absolute uint8
+               angles when MOTION_LOG_KEYFRAME is set
+    buttons    3 bytes of packed button-down events if MOTION_LOG_BUTTONS
+    sticks     lx, ly, rx, ry as int8 if MOTION_LOG_STICKS
+
+  Ticks where nothing changed only add to the next record's dt.
+*/
+
+#define MOTION_LOG_MAGIC "BML1"
+#define MOTION_LOG_HEADER 4
+
+#define MOTION_LOG_JOINTS 9
+#define MOTION_LOG_JOINT_MASK 0x01FF
+#define MOTION_LOG_STICKS   0x1000
+#define MOTION_LOG_BUTTONS  0x2000
+#define MOTION_LOG_KEYFRAME 0x4000
+
+#define MOTION_LOG_MAX_RECORD (3 + MOTION_LOG_JOINTS + 3 + 4)
+
+struct Motion_Log_State {
+  int16_t pose[MOTION_LOG_JOINTS];
+  int8_t sticks[4];
+  uint32_t buttons;
+  uint32_t ms;
+};
+
+/**
+ * @brief Encode one record.
+ * 
+ * Joints whose angle changed are stored as int8 deltas. If any
+ * delta does not fit in an int8, or keyframe is requested, every
+ * joint is stored as an absolute angle instead.
+ * 
+ * @param dst output buffer, at least MOTION_LOG_MAX_RECORD bytes.
+ * @param dt milliseconds since the previous record (0-255).
+ * @param prev pose of the previous record.
+ * @param pose pose of this record, angles 0-180.
+ * @param buttons packed button-down events, 0 if none.
+ * @param sticks stick values, NULL if unchanged.
+ * @param keyframe force absolute angles for every joint.
+ * @return number of bytes written.
+*/
+static inline size_t Motion_Log_Encode(uint8_t* dst, uint8_t dt, const int16_t* prev, const int16_t* pose, uint32_t buttons, const int8_t* sticks, bool keyframe) {
+  uint16_t flags = 0;
+  for (int i = 0; i < MOTION_LOG_JOINTS && !keyframe; i++) {
+    int delta = pose[i] - prev[i];
+    if (delta < -128 || delta > 127) keyframe = true;
+    else if (delta != 0) flags |= 1 << i;
+  }
+  if (keyframe) flags = MOTION_LOG_KEYFRAME | MOTION_LOG_JOINT_MASK;
+  if (buttons) flags |= MOTION_LOG_BUTTONS;
+  if (sticks != NULL) flags |= MOTION_LOG_STICKS;
+
+  size_t n = 0;
+  dst[n++] = dt;
+  dst[n++] = flags & 0xFF;
+  dst[n++] = flags >> 8;
+  for (int i = 0; i < MOTION_LOG_JOINTS; i++) {
+    if (!(flags & (1 << i))) continue;
+    if (keyframe) dst[n++] = (uint8_t)pose[i];
+    else dst[n++] = (uint8_t)(int8_t)(pose[i] - prev[i]);
+  }
+  if (buttons) {
+    dst[n++] = buttons & 0xFF;
+    dst[n++] = (buttons >> 8) & 0xFF;
+    dst[n++] = (buttons >> 16) & 0xFF;
+  }
+  if (sticks != NULL) {
+    for (int i = 0; i < 4; i++) dst[n++] = (uint8_t)sticks[i];
+  }
+  return n;
+}
+
+/**
+ * @brief Decode one record into the running state.
+ * 
+ * @param src encoded bytes.
+ * @param len number of bytes available.
+ * @param state running state, updated in place. buttons holds
+ * only the events of this record.
+ * @return number of bytes consumed, 0 if the record is incomplete.
+*/
+static inline size_t Motion_Log_Decode(const uint8_t* src, size_t len, Motion_Log_State* state) {
+  if (len < 3) return 0;
+  uint16_t flags = src[1] | (src[2] << 8);
+  size_t need = 3;
+  for (int i = 0; i < MOTION_LOG_JOINTS; i++) if (flags & (1 << i)) need++;
+  if (flags & MOTION_LOG_BUTTONS) need += 3;
+  if (flags & MOTION_LOG_STICKS) need += 4;
+  if (len < need) return 0;
+
+  size_t n = 3;
+  state->ms += src[0];
+  for (int i = 0; i < MOTION_LOG_JOINTS; i++) {
+    if (!(flags & (1 << i))) continue;
+    if (flags & MOTION_LOG_KEYFRAME) state->pose[i] = src[n++];
+    else state->pose[i] += (int8_t)src[n++];
+  }
+  state->buttons = 0;
+  if (flags & MOTION_LOG_BUTTONS) {
+    state->buttons = src[n] | (src[n+1] << 8) | ((uint32_t)src[n+2] << 16);
+    n += 3;
+  }
+  if (flags & MOTION_LOG_STICKS) {
+    for (int i = 0; i < 4; i++) state->sticks[i] = (int8_t)src[n++];
+  }
+  return n;
+}
+
+#endif
@@ -0,0 +1,157 @@
+#ifndef MOTION_PACK_H
+#define MOTION_PACK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+  MOTION PACK FORMAT
+
+  A pack is a set of keyframed moves flashed on its own to the
+  "motion" data partition (see partitions.csv) and read straight
+  out of the flash mapping, so every section is a packed array
+  of fixed-size records at a known offset:
+
+    header    Motion_Pack_Header
+    moves     move_count x Motion_Pack_Move
+    keys      key_count x Motion_Pack_Key, each move's keys together
+    poses     pose_count x Motion_Pack_Pose
+
+  A move runs its keys in order. Each key holds a pose, given as
+  offsets from the move's base pose, from its beat time until the
+  next key's; a next key flagged MOTION_PACK_LINEAR is eased into
+  instead. The move ends at its last key's time, so it has at
+  least two keys and the last one only matters as a target to
+  ease into. Joints outside the move's mask rest as in any
+  other action.
+
+  Multi-byte fields are little endian, like the target. crc covers
+  every byte after the header. Shared with tools/pack_build.cpp.
+*/
+
+#define MOTION_PACK_MAGIC 0x4B504D42UL  // "BMPK"
+#define MOTION_PACK_VERSION 1
+#define MOTION_PACK_JOINTS 9
+#define MOTION_PACK_NAME 12
+
+// Data partition subtype, in the custom range
+#define MOTION_PACK_SUBTYPE 0x40
+#define MOTION_PACK_PARTITION "motion"
+
+enum Motion_Pack_Base {
+  MOTION_PACK_REST,    // gaucho or crouch, whichever the robot is in
+  MOTION_PACK_STD,
+  MOTION_PACK_GAUCHO,
+  MOTION_PACK_CROUCH,
+  MOTION_PACK_BASE_COUNT
+};
+
+// Key flags
+#define MOTION_PACK_LINEAR 0x01
+
+struct __attribute__((packed)) Motion_Pack_Header {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t move_count;
+  uint16_t key_count;
+  uint16_t pose_count;
+  uint32_t size;        // whole pack, header included
+  uint32_t crc;
+};
+
+struct __attribute__((packed)) Motion_Pack_Move {
+  char name[MOTION_PACK_NAME];   // NUL padded, not always terminated
+  uint32_t trigger;              // BTN_* chord that starts the move
+  uint16_t first_key;
+  uint8_t key_count;
+  uint8_t base;
+  uint16_t mask;                 // joints driven, bit per joint
+  uint16_t reserved;
+};
+
+struct __attribute__((packed)) Motion_Pack_Key {
+  uint16_t ms;      // beat time since the move started
+  uint8_t pose;
+  uint8_t flags;
+};
+
+struct __attribute__((packed)) Motion_Pack_Pose {
+  int8_t offset[MOTION_PACK_JOINTS];
+};
+
+enum Motion_Pack_Error {
+  MOTION_PACK_OK,
+  MOTION_PACK_MISSING,
+  MOTION_PACK_BAD_MAGIC,
+  MOTION_PACK_BAD_VERSION,
+  MOTION_PACK_BAD_SIZE,
+  MOTION_PACK_BAD_CRC,
+  MOTION_PACK_BAD_MOVE,
+  MOTION_PACK_ERROR_COUNT
+};
+
+static const char* const motion_pack_errors[MOTION_PACK_ERROR_COUNT] = {
+  "ok", "missing", "magic", "version", "size", "crc", "move"
+};
+
+/**
+ * @brief CRC-32 (IEEE, reflected), as zlib computes it.
+*/
+static inline uint32_t Motion_Pack_Crc(const uint8_t* data, size_t len) {
+  uint32_t crc = 0xFFFFFFFFUL;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) crc = (crc >> 1) ^ (0xEDB88320UL & -(crc & 1));
+  }
+  return ~crc;
+}
+
+static inline const Motion_Pack_Move* Motion_Pack_Moves(const Motion_Pack_Header* h) {
+  return (const Motion_Pack_Move*)(h + 1);
+}
+
+static inline const Motion_Pack_Key* Motion_Pack_Keys(const Motion_Pack_Header* h) {
+  return (const Motion_Pack_Key*)(Motion_Pack_Moves(h) + h->move_count);
+}
+
+static inline const Motion_Pack_Pose* Motion_Pack_Poses(const Motion_Pack_Header* h) {
+  return (const Motion_Pack_Pose*)(Motion_Pack_Keys(h) + h->key_count);
+}
+
+/**
+ * @brief Validate a pack in place.
+ *
+ * Checks everything playback relies on, so a pack that passes can
+ * be read with no further bounds checks.
+ *
+ * @param data start of the pack.
+ * @param cap bytes available at data, e.g. the partition size.
+*/
+static inline Motion_Pack_Error Motion_Pack_Check(const uint8_t* data, size_t cap) {
+  const Motion_Pack_Header* h = (const Motion_Pack_Header*)data;
+  if (cap < sizeof(*h)) return MOTION_PACK_BAD_SIZE;
+  // Erased flash, nothing was ever written to the partition
+  if (h->magic == 0xFFFFFFFFUL) return MOTION_PACK_MISSING;
+  if (h->magic != MOTION_PACK_MAGIC) return MOTION_PACK_BAD_MAGIC;
+  if (h->version != MOTION_PACK_VERSION) return MOTION_PACK_BAD_VERSION;
+  size_t size = sizeof(*h) + h->move_count * sizeof(Motion_Pack_Move) +
+                h->key_count * sizeof(Motion_Pack_Key) + h->pose_count * sizeof(Motion_Pack_Pose);
+  if (h->size != size || size > cap) return MOTION_PACK_BAD_SIZE;
+  if (Motion_Pack_Crc(data + sizeof(*h), size - sizeof(*h)) != h->crc) return MOTION_PACK_BAD_CRC;
+
+  const Motion_Pack_Move* moves = Motion_Pack_Moves(h);
+  const Motion_Pack_Key* keys = Motion_Pack_Keys(h);
+  for (int m = 0; m < h->move_count; m++) {
+    const Motion_Pack_Move& move = moves[m];
+    if (move.key_count < 2 || move.first_key + move.key_count > h->key_count ||
+        move.base >= MOTION_PACK_BASE_COUNT || move.trigger == 0) return MOTION_PACK_BAD_MOVE;
+    for (int k = 0; k < move.key_count; k++) {
+      const Motion_Pack_Key& key = keys[move.first_key + k];
+      if (key.pose >= h->pose_count) return MOTION_PACK_BAD_MOVE;
+      if (k > 0 && key.ms <= keys[move.first_key + k - 1].ms) return MOTION_PACK_BAD_MOVE;
+    }
+  }
+  return MOTION_PACK_OK;
+}
+
+#endif
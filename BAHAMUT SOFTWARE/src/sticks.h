@@ -0,0 +1,119 @@
+#ifndef STICKS_H
+#define STICKS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+  STICK SHAPING
+
+  Raw pad axes run -128..127 and jitter by a few counts at rest
+  and along the diagonals. Each stick goes through:
+
+    filter     one-pole low-pass per axis, alpha/256 of each new
+               sample. Snaps straight to the input while the stick
+               is at rest and when it leaves rest, so only
+               corrections are smoothed and neither a fresh push
+               nor a release is delayed.
+    deadzone   radial, so the diagonals are not favoured over the
+               axes, then rescaled so the edge of the deadzone is 0.
+    expo       blend of linear and cubic response, 0-100 %.
+
+  Gait selection compares the shaped sticks the same way notify()
+  always has, but the gait already running wins unless a rival
+  leads by the hysteresis margin.
+
+  Shared with the host tools.
+*/
+
+#define STICK_MAX 127
+
+enum Gait {
+  GAIT_NONE,
+  GAIT_WALK,
+  GAIT_TURN,
+  GAIT_SIDESTEP
+};
+
+/**
+ * @brief Integer square root, floor(sqrt(v)).
+*/
+static inline uint32_t Stick_Isqrt(uint32_t v) {
+  uint32_t r = 0;
+  uint32_t bit = 1UL << 30;
+  while (bit > v) bit >>= 2;
+  while (bit) {
+    if (v >= r + bit) {
+      v -= r + bit;
+      r = (r >> 1) + bit;
+    }
+    else r >>= 1;
+    bit >>= 2;
+  }
+  return r;
+}
+
+/**
+ * @brief One-pole low-pass step.
+ *
+ * @param state filter state in 1/256 counts.
+ * @param x new sample.
+ * @param alpha weight of the new sample, 1-256. 256 disables the filter.
+ * @return filtered value.
+*/
+static inline int Stick_Filter(int32_t& state, int x, int alpha) {
+  state += ((int32_t)x * 256 - state) * alpha / 256;
+  return state / 256;
+}
+
+/**
+ * @brief Radial deadzone and expo on one stick.
+ *
+ * @param x, y axes in, shaped axes out, direction preserved.
+ * @param deadzone radius in counts.
+ * @param expo cubic share of the response, 0-100.
+ * @return shaped magnitude, 0 inside the deadzone.
+*/
+static inline int Stick_Shape(int& x, int& y, int deadzone, int expo) {
+  int r = Stick_Isqrt(x * x + y * y);
+  if (r <= deadzone || deadzone >= STICK_MAX) {
+    x = 0;
+    y = 0;
+    return 0;
+  }
+  // Past the edge of the deadzone, 0..STICK_MAX, clamped at the corners
+  int m = (r - deadzone) * STICK_MAX / (STICK_MAX - deadzone);
+  if (m > STICK_MAX) m = STICK_MAX;
+  m = (m * (100 - expo) + (m * m / STICK_MAX) * m / STICK_MAX * expo) / 100;
+  x = x * m / r;
+  y = y * m / r;
+  return m;
+}
+
+/**
+ * @brief Pick the gait for a pair of shaped sticks.
+ *
+ * The right stick sidesteps, the left walks or turns depending on
+ * its dominant axis. The current gait holds each comparison unless
+ * the other side leads by more than hysteresis.
+ *
+ * @param current gait already running.
+ * @return new gait, GAIT_NONE when both sticks are at rest.
+*/
+static inline uint8_t Stick_Select_Gait(uint8_t current, int lx, int ly, int rx, int ry, int hysteresis) {
+  int left = abs(lx) + abs(ly);
+  int right = abs(rx) + abs(ry);
+  if (!left && !right) return GAIT_NONE;
+
+  bool sidestep;
+  if (current == GAIT_SIDESTEP) sidestep = right + hysteresis >= left;
+  else if (current == GAIT_NONE) sidestep = right >= left;
+  else sidestep = right > left + hysteresis;
+  if (sidestep) return GAIT_SIDESTEP;
+
+  if (current == GAIT_WALK) return abs(ly) + hysteresis >= abs(lx) ? GAIT_WALK : GAIT_TURN;
+  if (current == GAIT_TURN) return abs(ly) > abs(lx) + hysteresis ? GAIT_WALK : GAIT_TURN;
+  return abs(ly) > abs(lx) ? GAIT_WALK : GAIT_TURN;
+}
+
+#endif
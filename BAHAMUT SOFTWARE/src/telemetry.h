@@ -0,0 +1,156 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+  TELEMETRY FRAME FORMAT
+
+  Frames are fixed-size packed structs, terminated by a checksum
+  byte and COBS encoded so that 0x00 only ever appears as the
+  frame delimiter on the wire. Shared with tools/telemetry_decode.cpp.
+*/
+
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_JOINTS 9
+
+enum Telemetry_Type {
+  TELEMETRY_TICK = 1,
+  TELEMETRY_PROFILE = 2,
+  TELEMETRY_TEXT = 3,
+  TELEMETRY_TRACE = 4
+};
+
+// Flag bits
+#define TELEMETRY_CROUCHED  0x01
+#define TELEMETRY_CONNECTED 0x02
+
+struct __attribute__((packed)) Telemetry_Frame {
+  uint8_t type;
+  uint8_t version;
+  uint16_t seq;
+  uint32_t ms;
+  int16_t joints[TELEMETRY_JOINTS];
+  uint8_t action;
+  uint8_t led_state;
+  uint8_t flags;
+  uint16_t battery_avg;
+  uint16_t loop_us;
+  uint16_t notify_us;
+  uint8_t checksum;
+};
+
+// Profile classes, indexing the per-class arrays below
+#define PROFILE_DISPLAY_IDLE 0
+#define PROFILE_DISPLAY_BUSY 1
+
+/*
+  Control path profile, sent once per second. notify() cycle counts
+  are split by whether the display was being flushed at the time.
+  Cycles lost to flash cache misses are the difference to the same
+  drill on a CONTROL_IN_IRAM build, see tools/telemetry_decode.cpp.
+*/
+struct __attribute__((packed)) Profile_Frame {
+  uint8_t type;
+  uint8_t version;
+  uint32_t ms;
+  uint8_t iram;
+  uint32_t samples[2];
+  uint32_t mean_cycles[2];
+  uint32_t max_cycles[2];
+  uint8_t checksum;
+};
+
+/*
+  Console reply, sent in response to a serial command. Unlike the
+  other frames it is variable length: type, version, up to
+  TELEMETRY_TEXT_MAX bytes of text without a terminator, checksum.
+*/
+#define TELEMETRY_TEXT_MAX 96
+
+// The largest frame is a full console reply, a full trace frame
+// (see trace.h) stays within it
+#define TELEMETRY_MAX_FRAME (TELEMETRY_TEXT_MAX + 3)
+
+// Worst case COBS overhead is one byte per 254, plus the delimiter
+#define TELEMETRY_MAX_ENCODED (TELEMETRY_MAX_FRAME + TELEMETRY_MAX_FRAME/254 + 2)
+
+/**
+ * @brief Checksum over a frame.
+ * 
+ * Two's complement of the byte sum, such that the sum of
+ * every byte in a valid frame (checksum included) is zero.
+ * 
+ * @param data pointer to frame bytes.
+ * @param len number of bytes to sum.
+*/
+static inline uint8_t Telemetry_Checksum(const uint8_t* data, size_t len) {
+  uint8_t sum = 0;
+  for (size_t i = 0; i < len; i++) sum += data[i];
+  return (uint8_t)(-sum);
+}
+
+/**
+ * @brief COBS encode a buffer.
+ * 
+ * Writes the encoded bytes followed by a 0x00 delimiter.
+ * dst must hold at least len + len/254 + 2 bytes.
+ * 
+ * @param src bytes to encode.
+ * @param len number of bytes to encode.
+ * @param dst output buffer.
+ * @return number of bytes written, delimiter included.
+*/
+static inline size_t Cobs_Encode(const uint8_t* src, size_t len, uint8_t* dst) {
+  size_t code_idx = 0;
+  size_t out = 1;
+  uint8_t code = 1;
+  for (size_t i = 0; i < len; i++) {
+    if (src[i] == 0) {
+      dst[code_idx] = code;
+      code_idx = out++;
+      code = 1;
+    }
+    else {
+      dst[out++] = src[i];
+      if (++code == 0xFF) {
+        dst[code_idx] = code;
+        code_idx = out++;
+        code = 1;
+      }
+    }
+  }
+  dst[code_idx] = code;
+  dst[out++] = 0;
+  return out;
+}
+
+/**
+ * @brief COBS decode a single frame.
+ * 
+ * @param src encoded bytes, delimiter excluded.
+ * @param len number of encoded bytes.
+ * @param dst output buffer.
+ * @param cap capacity of dst.
+ * @return number of decoded bytes, 0 if the input is malformed.
+*/
+static inline size_t Cobs_Decode(const uint8_t* src, size_t len, uint8_t* dst, size_t cap) {
+  size_t out = 0;
+  size_t i = 0;
+  while (i < len) {
+    uint8_t code = src[i++];
+    if (code == 0) return 0;
+    for (uint8_t j = 1; j < code; j++) {
+      if (i >= len || out >= cap) return 0;
+      dst[out++] = src[i++];
+    }
+    if (code != 0xFF && i < len) {
+      if (out >= cap) return 0;
+      dst[out++] = 0;
+    }
+  }
+  return out;
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <telemetry.h>
+
+/*
+  TRACE EVENT FORMAT
+
+  The firmware logs begin, end and instant events into one ring per
+  core, stamped with that core's cycle counter. A dump sends each
+  ring as TELEMETRY_TRACE frames, every frame carrying a recent
+  (cycles, micros) pair taken on the same core so the host can put
+  both cores on one clock. Shared with tools/trace_export.cpp.
+*/
+
+enum Trace_Kind {
+  TRACE_BEGIN,
+  TRACE_END,
+  TRACE_INSTANT
+};
+
+enum Trace_Id {
+  TRACE_NOTIFY,
+  TRACE_LOOP,
+  TRACE_CONTROL_TICK,
+  TRACE_LOCK_WAIT,
+  TRACE_DISPLAY,
+  TRACE_TELEMETRY,
+  TRACE_CONSOLE,
+  TRACE_RECORDER,
+  TRACE_COMMIT,
+  TRACE_SAFE_POSE,
+  TRACE_ID_COUNT
+};
+
+static const char* const trace_names[TRACE_ID_COUNT] = {
+  "notify",
+  "loop",
+  "control_tick",
+  "lock_wait",
+  "display",
+  "telemetry",
+  "console",
+  "recorder",
+  "commit",
+  "safe_pose"
+};
+
+struct __attribute__((packed)) Trace_Event {
+  uint32_t cycles;
+  uint8_t kind;
+  uint8_t id;
+  // Event specific, e.g. servo commands written for TRACE_COMMIT
+  uint16_t arg;
+};
+
+#define TRACE_FRAME_EVENTS 10
+
+/*
+  One chunk of a core's ring, oldest event first. Variable length
+  like the console reply: the header, count events, checksum.
+  Timestamps are valid within 2^31 cycles of the sync pair.
+*/
+struct __attribute__((packed)) Trace_Frame {
+  uint8_t type;
+  uint8_t version;
+  uint8_t core;
+  uint8_t count;
+  uint16_t mhz;
+  uint32_t sync_cycles;
+  uint32_t sync_us;
+  Trace_Event events[TRACE_FRAME_EVENTS];
+  uint8_t checksum;
+};
+
+// Bytes before the first event
+#define TRACE_FRAME_HEADER 14
+
+#endif
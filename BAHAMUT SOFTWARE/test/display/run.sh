@@ -0,0 +1,31 @@
+#!/bin/sh
+#
+# DISPLAY GOLDEN RUNNER
+#
+# Builds tools/display_check.cpp natively and compares every distinct
+# panel image of its pairing and HUD scenes with the reference PBMs
+# in this directory, see tools/display_check.cpp.
+#
+# Usage, from anywhere:
+#   test/display/run.sh            check the frames, exit 1 on any diff
+#   test/display/run.sh --update   rewrite the PBMs from the current tree
+
+set -u
+dir=$(cd "$(dirname "$0")" && pwd)
+root=$(cd "$dir/../.." && pwd)
+bin=${TMPDIR:-/tmp}/bahamut_display_check.$$
+trap 'rm -f "$bin" "$bin.log"' EXIT
+
+${CXX:-g++} -std=gnu++17 -O2 -I "$root/src" -I "$root/tools/host" \
+  "$root/tools/display_check.cpp" "$root/tools/host/host.cpp" "$root/src/main.cpp" -o "$bin" || exit 2
+
+if [ "${1:-}" = "--update" ]; then
+  rm -f "$dir"/*.pbm
+  "$bin" --snapshots "$dir" 2>&1 | tail -n 1
+  exit 0
+fi
+# Keep the image verdicts, not the bus timing report
+"$bin" --golden "$dir" 2>"$bin.log"
+status=$?
+grep -v "^ \|frames (" "$bin.log"
+exit $status
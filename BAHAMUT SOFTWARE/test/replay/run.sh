@@ -0,0 +1,40 @@
+#!/bin/sh
+#
+# REPLAY GOLDEN RUNNER
+#
+# Builds tools/replay.cpp natively and replays every trace in this
+# directory against its golden servo trace, see tools/replay.cpp.
+#
+# Usage, from anywhere:
+#   test/replay/run.sh            check every trace, exit 1 on any diff
+#   test/replay/run.sh --update   rewrite the goldens from the current tree
+#
+# <name>.csv is the input trace, <name>.golden.csv its servo trace.
+
+set -u
+dir=$(cd "$(dirname "$0")" && pwd)
+root=$(cd "$dir/../.." && pwd)
+bin=${TMPDIR:-/tmp}/bahamut_replay.$$
+trap 'rm -f "$bin" "$bin.log"' EXIT
+
+${CXX:-g++} -std=gnu++17 -O2 -I "$root/src" -I "$root/tools/host" \
+  "$root/tools/replay.cpp" "$root/tools/host/host.cpp" "$root/src/main.cpp" -o "$bin" || exit 2
+
+failed=0
+for trace in "$dir"/*.csv; do
+  case "$trace" in *.golden.csv) continue ;; esac
+  name=$(basename "$trace" .csv)
+  golden="$dir/$name.golden.csv"
+  if [ "${1:-}" = "--update" ]; then
+    "$bin" "$trace" --servo "$golden" 2>/dev/null || failed=1
+    echo "$name: updated"
+  elif "$bin" "$trace" --golden "$golden" >/dev/null 2>"$bin.log"; then
+    echo "$name: ok"
+  else
+    echo "$name: FAILED"
+    cat "$bin.log"
+    failed=1
+  fi
+  rm -f "$bin.log"
+done
+exit $failed
@@ -0,0 +1,153 @@
+/*
+  BALANCE BENCHMARK
+
+  Times the fixed-point center of mass estimate in balance.h and
+  checks it against the same model in double precision.
+
+  Build:
+    g++ -std=c++17 -O2 -I src tools/balance_bench.cpp -o balance_bench
+
+  Usage:
+    balance_bench [--poses N] [--rounds N] [--seed N]
+
+  Random poses cover the full 0-180 range of every joint, well
+  past anything the actions command. Prints the cost of one
+  estimate, of the worst case softening (one estimate plus three
+  blends), the largest error against the double model, and the
+  center of mass of each stock pose. On the robot, the console's
+  "balance" command reports the slowest check seen.
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <balance.h>
+
+static const int std_pose[GAIT_JOINTS] = GAIT_STD_POSE;
+static const int gaucho_pose[GAIT_JOINTS] = GAIT_GAUCHO_POSE;
+static const int crouch_pose[GAIT_JOINTS] = GAIT_CROUCH_POSE;
+
+#define DEG (M_PI / 180.0)
+
+/**
+ * @brief balance.h's model in double precision, in mm.
+*/
+void Reference_Com(const int16_t* pose, const int* ref, double& x, double& y) {
+  int d[GAIT_JOINTS];
+  for (int j = 0; j < GAIT_JOINTS; j++) d[j] = pose[j] - ref[j];
+
+  int lean = (d[GAIT_LF] + d[GAIT_RF]) / 2;
+  int pitch = (d[GAIT_RF] - d[GAIT_LF]) / 2 - (d[GAIT_RH] - d[GAIT_LH]) / 2;
+  int yaw = d[GAIT_W];
+
+  double mx = 0, my = 0, mz = BAL_M_TORSO * BAL_TORSO_COM;
+  int sides[2] = { -1, +1 };
+  int shoulder[2] = { d[GAIT_RS], -d[GAIT_LS] };
+  int elbow[2] = { -d[GAIT_RB], d[GAIT_LB] };
+  for (int a = 0; a < 2; a++) {
+    double p = shoulder[a] * DEG;
+    double q = (shoulder[a] + elbow[a]) * DEG;
+    mx += BAL_M_UPPER_ARM * (BAL_UPPER_ARM / 2.0 * sin(p)) +
+          BAL_M_FOREARM * (BAL_UPPER_ARM * sin(p) + BAL_FOREARM / 2.0 * sin(q));
+    my += (BAL_M_UPPER_ARM + BAL_M_FOREARM) * sides[a] * BAL_SHOULDER_HALF;
+    mz += BAL_M_UPPER_ARM * (BAL_SHOULDER_HEIGHT - BAL_UPPER_ARM / 2.0 * cos(p)) +
+          BAL_M_FOREARM * (BAL_SHOULDER_HEIGHT - BAL_UPPER_ARM * cos(p) - BAL_FOREARM / 2.0 * cos(q));
+  }
+
+  double tx = mx * cos(yaw * DEG) - my * sin(yaw * DEG);
+  double ty = mx * sin(yaw * DEG) + my * cos(yaw * DEG);
+  tx = tx * cos(pitch * DEG) + mz * sin(pitch * DEG);
+
+  double upper = BAL_M_TORSO + 2 * (BAL_M_UPPER_ARM + BAL_M_FOREARM);
+  double pelvis = BAL_LEG * sin(lean * DEG);
+  x = tx / BAL_M_TOTAL;
+  y = (ty + (upper + BAL_M_LEG) * pelvis) / BAL_M_TOTAL;
+}
+
+/**
+ * @brief Print one stock pose.
+*/
+void Print_Pose(const char* name, const int* pose) {
+  int16_t p[GAIT_JOINTS];
+  for (int j = 0; j < GAIT_JOINTS; j++) p[j] = pose[j];
+  Bal_Point c = Balance_Com(p, std_pose);
+  printf("  %-8s com %6.1f,%6.1f mm  excess %5.1f mm\n", name,
+    c.x / (double)BAL_MM, c.y / (double)BAL_MM, Balance_Excess(c, 0) / (double)BAL_MM);
+}
+
+int main(int argc, char** argv) {
+  int poses = 4096;
+  int rounds = 200;
+  unsigned seed = 1;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--poses") && i + 1 < argc) poses = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--rounds") && i + 1 < argc) rounds = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = atoi(argv[++i]);
+    else {
+      fprintf(stderr, "usage: balance_bench [--poses N] [--rounds N] [--seed N]\n");
+      return 2;
+    }
+  }
+  if (poses < 1) poses = 1;
+  if (rounds < 1) rounds = 1;
+
+  srand(seed);
+  std::vector<int16_t> table(poses * GAIT_JOINTS);
+  for (auto& a : table) a = rand() % 181;
+
+  // Accuracy
+  double worst = 0;
+  double total = 0;
+  for (int n = 0; n < poses; n++) {
+    const int16_t* p = &table[n * GAIT_JOINTS];
+    Bal_Point c = Balance_Com(p, std_pose);
+    double rx, ry;
+    Reference_Com(p, std_pose, rx, ry);
+    double err = hypot(c.x / (double)BAL_MM - rx, c.y / (double)BAL_MM - ry);
+    total += err;
+    if (err > worst) worst = err;
+  }
+
+  // Cost of one estimate plus the support check
+  volatile int32_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) {
+    for (int n = 0; n < poses; n++) {
+      Bal_Point c = Balance_Com(&table[n * GAIT_JOINTS], std_pose);
+      sink += Balance_Excess(c, 5);
+    }
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  double per = ns / ((double)rounds * poses);
+
+  // Worst case softening, the command and three blends towards the last pose
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) {
+    for (int n = 1; n < poses; n++) {
+      const int16_t* cmd = &table[n * GAIT_JOINTS];
+      const int16_t* out = &table[(n - 1) * GAIT_JOINTS];
+      sink += Balance_Excess(Balance_Com(cmd, std_pose), 5);
+      for (int q = 3; q >= 1; q--) {
+        int16_t blend[GAIT_JOINTS];
+        for (int j = 0; j < GAIT_JOINTS; j++) blend[j] = out[j] + (cmd[j] - out[j]) * q / 4;
+        sink += Balance_Excess(Balance_Com(blend, std_pose), 5);
+      }
+    }
+  }
+  ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  double soften = ns / ((double)rounds * (poses - 1 > 0 ? poses - 1 : 1));
+
+  printf("poses %d x %d rounds\n", poses, rounds);
+  printf("estimate   %7.1f ns\n", per);
+  printf("softening  %7.1f ns worst case\n", soften);
+  printf("error      %7.3f mm mean, %.3f mm max\n", total / poses, worst);
+  printf("stock poses:\n");
+  Print_Pose("std", std_pose);
+  Print_Pose("gaucho", gaucho_pose);
+  Print_Pose("crouch", crouch_pose);
+  return 0;
+}
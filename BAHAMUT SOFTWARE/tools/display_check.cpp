@@ -0,0 +1,234 @@
+/*
+  DISPLAY CHECK
+
+  Runs the firmware natively against the SSD1306 emulator in
+  tools/host and reports what every display frame costs on the
+  bus, while keeping a snapshot of what the panel shows.
+
+  Two scenes are played on the virtual clock: the pairing screen
+  while the pad is away, then the HUD once it connects, with the
+  battery sagging partway through so the HUD has something to
+  redraw.
+
+  Build:
+    g++ -std=gnu++17 -O2 -I src -I tools/host tools/display_check.cpp tools/host/host.cpp src/main.cpp -o display_check
+
+  Usage:
+    display_check [options]
+      --snapshots DIR  write each distinct panel image to DIR as
+                       NNN_scene.pbm
+      --png            write PNG next to each PBM
+      --golden DIR     compare each distinct panel image with the
+                       PBM of the same name in DIR, exit 1 on mismatch
+                       or on fewer images than DIR holds
+      --csv FILE       write one row per frame
+      --loop MS        loop() period on the virtual clock (default 30)
+      --pairing MS     time spent unpaired (default 3000)
+      --hud MS         time spent connected (default 3000)
+
+  test/display/run.sh checks against the committed reference frames.
+
+  Bus time is given at 100 kHz, 400 kHz and 1 MHz from the bit
+  count of each frame, start, stop, address and ACK bits included.
+*/
+
+#include <Arduino.h>
+#include <Adafruit_SSD1306.h>
+#include <Ps3Controller.h>
+#include <string>
+#include <vector>
+
+void Init_Task(void* arg);
+
+static const uint32_t bus_clocks[] = { 100000, 400000, 1000000 };
+#define BUS_CLOCKS (sizeof(bus_clocks) / sizeof(bus_clocks[0]))
+
+struct Options {
+  const char* snapshots = NULL;
+  const char* golden = NULL;
+  const char* csv = NULL;
+  bool png = false;
+  unsigned long loop_ms = 30;
+  unsigned long pairing_ms = 3000;
+  unsigned long hud_ms = 3000;
+};
+
+struct Scene_Stats {
+  const char* name;
+  size_t first;
+  size_t last;
+};
+
+/**
+ * @brief Run loop() on its period until ms, closing a frame after each.
+*/
+void Run_Until(unsigned long ms, const Options& opt) {
+  while (host_time_us / 1000 < ms) {
+    loop();
+    host_display_frame();
+    host_time_us += (uint64_t)opt.loop_ms * 1000;
+  }
+}
+
+/**
+ * @brief Load a PBM written by host_write_pbm back into panel RAM order.
+*/
+bool Load_Pbm(const char* path, uint8_t* ram) {
+  FILE* f = fopen(path, "rb");
+  if (f == NULL) return false;
+  int width, height;
+  bool ok = fscanf(f, "P4 %d %d", &width, &height) == 2 && fgetc(f) != EOF &&
+            width == HOST_PANEL_WIDTH && height == HOST_PANEL_PAGES * 8;
+  memset(ram, 0, HOST_PANEL_RAM);
+  for (int y = 0; ok && y < height; y++) {
+    for (int x = 0; x < width; x += 8) {
+      int b = fgetc(f);
+      if (b == EOF) {
+        ok = false;
+        break;
+      }
+      for (int i = 0; i < 8; i++) {
+        if (!(b & (0x80 >> i))) ram[(y / 8) * HOST_PANEL_WIDTH + x + i] |= 1 << (y & 7);
+      }
+    }
+  }
+  fclose(f);
+  return ok;
+}
+
+/**
+ * @brief Summarise one scene's frames on stderr.
+*/
+void Report_Scene(const Scene_Stats& scene) {
+  size_t n = scene.last - scene.first;
+  if (n == 0) {
+    fprintf(stderr, "%-8s no frames\n", scene.name);
+    return;
+  }
+  uint64_t bytes = 0, bits = 0, max_bits = 0;
+  uint32_t max_bytes = 0, full = 0;
+  for (size_t i = scene.first; i < scene.last; i++) {
+    const Host_Frame& f = host_frames[i];
+    bytes += f.bus.bytes;
+    bits += f.bus.bits;
+    if (f.bus.bytes > max_bytes) max_bytes = f.bus.bytes;
+    if (f.bus.bits > max_bits) max_bits = f.bus.bits;
+    if (f.full) full++;
+  }
+  fprintf(stderr, "%-8s %zu frames (%u full), bytes mean %llu max %u\n", scene.name, n, full,
+    (unsigned long long)(bytes / n), max_bytes);
+  for (size_t c = 0; c < BUS_CLOCKS; c++) {
+    fprintf(stderr, "         %5lu kHz  mean %8.1f us  max %8.1f us\n", (unsigned long)(bus_clocks[c] / 1000),
+      (double)bits / n * 1e6 / bus_clocks[c], (double)max_bits * 1e6 / bus_clocks[c]);
+  }
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--snapshots" && has_value) opt.snapshots = argv[++i];
+    else if (arg == "--golden" && has_value) opt.golden = argv[++i];
+    else if (arg == "--csv" && has_value) opt.csv = argv[++i];
+    else if (arg == "--png") opt.png = true;
+    else if (arg == "--loop" && has_value) opt.loop_ms = max(1L, atol(argv[++i]));
+    else if (arg == "--pairing" && has_value) opt.pairing_ms = atol(argv[++i]);
+    else if (arg == "--hud" && has_value) opt.hud_ms = atol(argv[++i]);
+    else {
+      fprintf(stderr, "unknown argument %s\n", arg.c_str());
+      return 2;
+    }
+  }
+
+  for (int i = 0; i < 40; i++) host_adc[i] = 3200;
+  host_time_us = 0;
+  setup();
+  // Tasks never start on the host, bring the display up here
+  Init_Task(NULL);
+  host_display_frame();
+
+  Scene_Stats scenes[2] = { { "pairing", 0, 0 }, { "hud", 0, 0 } };
+
+  scenes[0].first = host_frames.size();
+  Run_Until(opt.pairing_ms, opt);
+  scenes[0].last = host_frames.size();
+
+  Ps3.connected = true;
+  if (Ps3.on_connect) Ps3.on_connect();
+  scenes[1].first = host_frames.size();
+  Run_Until(opt.pairing_ms + opt.hud_ms / 2, opt);
+  for (int i = 0; i < 40; i++) host_adc[i] = 2700;
+  Run_Until(opt.pairing_ms + opt.hud_ms, opt);
+  scenes[1].last = host_frames.size();
+
+  FILE* csv = opt.csv ? fopen(opt.csv, "w") : NULL;
+  if (csv) {
+    fprintf(csv, "frame,ms,scene,full,transactions,bytes,bits");
+    for (size_t c = 0; c < BUS_CLOCKS; c++) fprintf(csv, ",us_%lukhz", (unsigned long)(bus_clocks[c] / 1000));
+    fprintf(csv, "\n");
+  }
+
+  // Snapshots and golden comparison on distinct images only
+  int mismatches = 0;
+  int distinct = 0;
+  const uint8_t* previous = NULL;
+  for (const Scene_Stats& scene : scenes) {
+    for (size_t i = scene.first; i < scene.last; i++) {
+      const Host_Frame& f = host_frames[i];
+      if (csv) {
+        fprintf(csv, "%zu,%llu,%s,%d,%u,%u,%llu", i, (unsigned long long)(f.at_us / 1000), scene.name,
+          f.full ? 1 : 0, f.bus.transactions, f.bus.bytes, (unsigned long long)f.bus.bits);
+        for (size_t c = 0; c < BUS_CLOCKS; c++) fprintf(csv, ",%.1f", f.bus.bits * 1e6 / bus_clocks[c]);
+        fprintf(csv, "\n");
+      }
+
+      if (previous && memcmp(previous, f.ram, HOST_PANEL_RAM) == 0) continue;
+      previous = f.ram;
+
+      char name[64];
+      snprintf(name, sizeof(name), "%03d_%s", distinct++, scene.name);
+      if (opt.snapshots) {
+        std::string path = std::string(opt.snapshots) + "/" + name;
+        if (!host_write_pbm((path + ".pbm").c_str(), f.ram)) fprintf(stderr, "cannot write %s.pbm\n", path.c_str());
+        if (opt.png && !host_write_png((path + ".png").c_str(), f.ram)) fprintf(stderr, "cannot write %s.png\n", path.c_str());
+      }
+      if (opt.golden) {
+        uint8_t want[HOST_PANEL_RAM];
+        std::string path = std::string(opt.golden) + "/" + name + ".pbm";
+        if (!Load_Pbm(path.c_str(), want)) {
+          fprintf(stderr, "%s: missing or unreadable\n", path.c_str());
+          mismatches++;
+        }
+        else if (memcmp(want, f.ram, HOST_PANEL_RAM) != 0) {
+          int pixels = 0;
+          for (int b = 0; b < HOST_PANEL_RAM; b++) pixels += __builtin_popcount(want[b] ^ f.ram[b]);
+          fprintf(stderr, "%s: %d pixels differ\n", name, pixels);
+          mismatches++;
+        }
+      }
+    }
+  }
+  if (csv) fclose(csv);
+
+  // A golden image past the last one shown means a frame went missing
+  if (opt.golden) {
+    for (const Scene_Stats& scene : scenes) {
+      uint8_t want[HOST_PANEL_RAM];
+      char name[64];
+      snprintf(name, sizeof(name), "%03d_%s", distinct, scene.name);
+      std::string path = std::string(opt.golden) + "/" + name + ".pbm";
+      if (!Load_Pbm(path.c_str(), want)) continue;
+      fprintf(stderr, "%s: never shown\n", name);
+      mismatches++;
+    }
+  }
+
+  for (const Scene_Stats& scene : scenes) Report_Scene(scene);
+  fprintf(stderr, "%d distinct images\n", distinct);
+  if (opt.golden) {
+    if (mismatches) fprintf(stderr, "%d images differ from %s\n", mismatches, opt.golden);
+    else fprintf(stderr, "panel images match %s\n", opt.golden);
+  }
+  return mismatches ? 1 : 0;
+}
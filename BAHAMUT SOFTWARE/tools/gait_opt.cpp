@@ -0,0 +1,508 @@
+/*
+  GAIT OPTIMIZER
+
+  Searches the walk and turn gait parameters (period, beat split
+  and offsets) on a simple rigid-body model of the robot and writes
+  the best set found as src/gait_tables.h, which the firmware uses
+  for its default params.
+
+  The gaits are evaluated through gait.h, the same code the firmware
+  runs, so only the body model is host-side.
+
+  Build:
+    g++ -std=c++17 -O2 -pthread -I src tools/gait_opt.cpp -o gait_opt
+
+  Usage:
+    gait_opt [options]
+      --samples N    random candidates per gait (default 20000)
+      --threads N    worker threads (default all cores)
+      --seed N       search seed (default 1)
+      --out FILE     write the tables to FILE (default stdout)
+      --baseline     skip the search, score the current tables and
+                     write them back unchanged
+      --scaling      time the walk search at 1, 2, 4 .. N threads
+
+  Candidates are derived from their index and the seed, never from
+  the thread that runs them, so a search gives the same tables on
+  any number of threads. Scores are printed to stderr.
+
+  BODY MODEL
+
+  Top-down, one rigid body standing on two point feet FOOT_SPAN
+  apart. Each servo slews towards its target at SERVO_SLEW. From
+  the feet offsets:
+
+    roll   mean of both feet, shifts the mass sideways. Past
+           STANCE_ROLL the body is on one foot, fully loaded at
+           LOAD_ROLL, and falls over past TIP_ROLL.
+    lift   half the difference of the feet, raises the body.
+           Past LIFT_SLIDE the feet slide instead of gripping.
+
+  Waist travel on one foot swings the body around that foot, in
+  proportion to the load. On both feet the legs turn against the
+  upper body's inertia, a little when gripping, more when sliding.
+
+  Sidesteps are not modelled. Their thrust and reset strokes both
+  run on the foot the roll loads, so on this model they cancel out;
+  telling them apart needs the load to pass to the catching leg,
+  which a two point top-down body does not have. The sidestep
+  tables pass through as tuned by hand.
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <gait.h>
+#include <gait_tables.h>
+
+#define SIM_DT 1.0          // ms per step
+#define SERVO_SLEW 0.5      // deg per ms
+#define FOOT_SPAN 90.0      // mm between the feet
+#define STANCE_ROLL 8.0     // deg of feet offset before one foot carries the body
+#define LOAD_ROLL 20.0      // deg of feet offset for a fully loaded foot
+#define TIP_ROLL 40.0       // deg of feet offset that tips the body over
+#define LIFT_SLIDE 10.0     // deg of lift before the feet slide
+#define STEP_GAIN 0.5       // body swing per unit of waist travel on one foot
+#define GRIP_GAIN 0.1       // leg turn per unit of waist travel on both feet
+#define SLIDE_GAIN 0.7      // the same, with the feet sliding
+#define DRIFT_WEIGHT 2.0    // penalty per mm/s or deg/s off the wanted motion
+
+#define WARMUP_CYCLES 1
+#define SCORE_CYCLES 4
+
+#define DEG_TO_RAD (M_PI / 180.0)
+
+/*
+  MODEL
+*/
+
+struct Motion {
+  bool fell;
+  double forward;   // mm per cycle, along the starting heading
+  double lateral;   // mm per cycle, positive to the left
+  double yaw;       // deg per cycle, positive to the left
+  double period;    // ms
+};
+
+/**
+ * @brief Rotate the point (x, y) by a around (px, py).
+*/
+void Rotate_About(double& x, double& y, double px, double py, double a) {
+  double dx = x - px;
+  double dy = y - py;
+  x = px + dx * cos(a) - dy * sin(a);
+  y = py + dx * sin(a) + dy * cos(a);
+}
+
+/**
+ * @brief Run a gait on the body model.
+ *
+ * @param g gait shape.
+ * @param base pose the gait runs on.
+ * @return motion per cycle over SCORE_CYCLES after WARMUP_CYCLES.
+*/
+Motion Simulate(const Gait_Shape& g, const int* base) {
+  Motion m = { false, 0, 0, 0, (double)g.period };
+
+  for (int b = 0; b < 2; b++) {
+    for (int j = 0; j < GAIT_JOINTS; j++) {
+      int a = base[j] + g.offset[b][j];
+      if (a < 0 || a > 180) {
+        m.fell = true;
+        return m;
+      }
+    }
+  }
+
+  double angle[GAIT_JOINTS];
+  for (int j = 0; j < GAIT_JOINTS; j++) angle[j] = base[j];
+
+  double x = 0, y = 0, yaw = 0;
+  double x0 = 0, y0 = 0, yaw0 = 0;
+  int warmup = WARMUP_CYCLES * g.period;
+  int steps = (WARMUP_CYCLES + SCORE_CYCLES) * g.period;
+
+  for (int t = 0; t < steps; t++) {
+    if (t == warmup) {
+      x0 = x;
+      y0 = y;
+      yaw0 = yaw;
+    }
+
+    int target[GAIT_JOINTS];
+    Gait_Pose(g, base, t, target);
+
+    double travel[GAIT_JOINTS];
+    for (int j = 0; j < GAIT_JOINTS; j++) {
+      double d = target[j] - angle[j];
+      double step = SERVO_SLEW * SIM_DT;
+      if (d > step) d = step;
+      if (d < -step) d = -step;
+      angle[j] += d;
+      travel[j] = d * DEG_TO_RAD;
+    }
+
+    double lf_off = angle[GAIT_LF] - base[GAIT_LF];
+    double rf_off = angle[GAIT_RF] - base[GAIT_RF];
+    double roll = (lf_off + rf_off) / 2;
+    double lift = (rf_off - lf_off) / 2;
+    if (fabs(roll) > TIP_ROLL) {
+      m.fell = true;
+      return m;
+    }
+
+    double load = (fabs(roll) - STANCE_ROLL) / (LOAD_ROLL - STANCE_ROLL);
+    if (load > 1) load = 1;
+
+    if (load > 0) {
+      // On one foot, positive roll loads the left
+      int side = roll > 0 ? 1 : -1;
+      double px = x - sin(yaw) * side * FOOT_SPAN / 2;
+      double py = y + cos(yaw) * side * FOOT_SPAN / 2;
+      double a = STEP_GAIN * load * travel[GAIT_W];
+      Rotate_About(x, y, px, py, a);
+      yaw += a;
+    }
+    else {
+      yaw -= (lift > LIFT_SLIDE ? SLIDE_GAIN : GRIP_GAIN) * travel[GAIT_W];
+    }
+  }
+
+  double dx = x - x0;
+  double dy = y - y0;
+  m.forward = (dx * cos(yaw0) + dy * sin(yaw0)) / SCORE_CYCLES;
+  m.lateral = (-dx * sin(yaw0) + dy * cos(yaw0)) / SCORE_CYCLES;
+  m.yaw = (yaw - yaw0) / DEG_TO_RAD / SCORE_CYCLES;
+  return m;
+}
+
+/**
+ * @brief Per second rate of a per cycle motion.
+*/
+double Rate(const Motion& m, double per_cycle) {
+  return per_cycle * 1000.0 / m.period;
+}
+
+/*
+  GAITS
+*/
+
+enum Gait_Kind {
+  KIND_WALK,
+  KIND_TURN,
+  KIND_SIDESTEP,
+  KIND_COUNT
+};
+
+// One searched parameter
+struct Range {
+  const char* name;
+  int lo;
+  int hi;
+};
+
+// Candidate gait, values in the order of the kind's ranges
+struct Candidate {
+  int v[4];
+};
+
+struct Kind_Def {
+  const char* name;
+  const char* prefix;
+  // Whether the body model can score it, see the header
+  bool modelled;
+  int count;
+  Range ranges[4];
+  Candidate current;
+};
+
+static const Kind_Def kinds[KIND_COUNT] = {
+  { "walk", "WALK", true, 4,
+    { { "PERIOD", 150, 800 }, { "SPLIT", 25, 75 }, { "FOOT", 0, 60 }, { "WAIST", 0, 90 } },
+    { { GAIT_WALK_PERIOD, GAIT_WALK_SPLIT, GAIT_WALK_FOOT, GAIT_WALK_WAIST } } },
+  { "turn", "TURN", true, 4,
+    { { "PERIOD", 150, 800 }, { "SPLIT", 25, 75 }, { "LIFT", 0, 60 }, { "WAIST", 0, 90 } },
+    { { GAIT_TURN_PERIOD, GAIT_TURN_SPLIT, GAIT_TURN_LIFT, GAIT_TURN_WAIST } } },
+  { "sidestep", "SIDESTEP", false, 3,
+    { { "PERIOD", 100, 800 }, { "SPLIT", 25, 75 }, { "REACH", 0, 60 } },
+    { { GAIT_SIDESTEP_PERIOD, GAIT_SIDESTEP_SPLIT, GAIT_SIDESTEP_REACH } } }
+};
+
+static const int std_pose[GAIT_JOINTS] = GAIT_STD_POSE;
+static const int gaucho_pose[GAIT_JOINTS] = GAIT_GAUCHO_POSE;
+
+struct Score {
+  double value;
+  // Headline rate, mm/s or deg/s, and per cycle motion
+  double rate;
+  double per_cycle;
+};
+
+/**
+ * @brief Score a candidate, higher is better, -HUGE_VAL if it falls.
+ *
+ * Walks score the slower of forward and backward, since both run
+ * on the same offsets. Turns score the right side, the left is its
+ * mirror. Motion off the wanted axis is penalised. Only modelled
+ * kinds are scored.
+*/
+Score Evaluate(int kind, const Candidate& c) {
+  Score s = { -HUGE_VAL, 0, 0 };
+  if (kind == KIND_WALK) {
+    Motion fwd = Simulate(Gait_Walk(c.v[0], c.v[1], c.v[2], c.v[3], +1), std_pose);
+    Motion back = Simulate(Gait_Walk(c.v[0], c.v[1], c.v[2], c.v[3], -1), std_pose);
+    if (fwd.fell || back.fell) return s;
+    double f = Rate(fwd, fwd.forward);
+    double b = -Rate(back, back.forward);
+    s.rate = f < b ? f : b;
+    s.per_cycle = f < b ? fwd.forward : -back.forward;
+    double drift = fabs(Rate(fwd, fwd.yaw)) + fabs(Rate(back, back.yaw)) +
+                   fabs(Rate(fwd, fwd.lateral)) + fabs(Rate(back, back.lateral));
+    s.value = s.rate - DRIFT_WEIGHT * drift;
+  }
+  else if (kind == KIND_TURN) {
+    Motion m = Simulate(Gait_Turn(c.v[0], c.v[1], c.v[2], c.v[3]), gaucho_pose);
+    if (m.fell) return s;
+    s.rate = -Rate(m, m.yaw);
+    s.per_cycle = -m.yaw;
+    s.value = s.rate - DRIFT_WEIGHT * (fabs(Rate(m, m.forward)) + fabs(Rate(m, m.lateral)));
+  }
+  return s;
+}
+
+/*
+  PARALLEL SEARCH
+*/
+
+int threads = 0;
+
+/**
+ * @brief splitmix64, a stateless hash for per-index candidates.
+*/
+uint64_t Mix(uint64_t z) {
+  z += 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+/**
+ * @brief Evaluate count candidates on all threads, keep the best.
+ *
+ * Threads pull indices from a shared counter. Ties go to the lower
+ * index, so the result does not depend on the thread count.
+ *
+ * @param make builds candidate i.
+ * @return index of the best candidate, -1 if every one fell.
+*/
+long Parallel_Best(int kind, long count, const std::function<Candidate(long)>& make, Score* best_score) {
+  struct Best {
+    long index;
+    Score score;
+  };
+  std::atomic<long> next(0);
+  std::vector<Best> best(threads, Best{ -1, { -HUGE_VAL, 0, 0 } });
+  std::vector<std::thread> pool;
+
+  for (int t = 0; t < threads; t++) {
+    pool.emplace_back([&, t]() {
+      const long chunk = 64;
+      for (;;) {
+        long start = next.fetch_add(chunk);
+        if (start >= count) break;
+        long end = start + chunk < count ? start + chunk : count;
+        for (long i = start; i < end; i++) {
+          Score s = Evaluate(kind, make(i));
+          if (s.value > best[t].score.value ||
+              (s.value == best[t].score.value && best[t].index >= 0 && i < best[t].index)) {
+            best[t] = Best{ i, s };
+          }
+        }
+      }
+    });
+  }
+  for (auto& th : pool) th.join();
+
+  Best result = { -1, { -HUGE_VAL, 0, 0 } };
+  for (auto& b : best) {
+    if (b.index < 0) continue;
+    if (result.index < 0 || b.score.value > result.score.value ||
+        (b.score.value == result.score.value && b.index < result.index)) result = b;
+  }
+  if (best_score) *best_score = result.score;
+  return result.index;
+}
+
+/**
+ * @brief Random candidate i of a kind.
+*/
+Candidate Random_Candidate(int kind, uint64_t seed, long i) {
+  const Kind_Def& k = kinds[kind];
+  Candidate c = k.current;
+  uint64_t h = Mix(seed * 1000003ULL + kind * 7919ULL + (uint64_t)i);
+  for (int d = 0; d < k.count; d++) {
+    h = Mix(h);
+    c.v[d] = k.ranges[d].lo + (int)(h % (uint64_t)(k.ranges[d].hi - k.ranges[d].lo + 1));
+  }
+  return c;
+}
+
+/**
+ * @brief Random search followed by a shrinking local refinement.
+ *
+ * The current tables are candidate 0, so the result never scores
+ * below them.
+*/
+Candidate Search(int kind, long samples, uint64_t seed, Score* score) {
+  const Kind_Def& k = kinds[kind];
+  auto random = [&](long i) { return i == 0 ? k.current : Random_Candidate(kind, seed, i); };
+  long idx = Parallel_Best(kind, samples, random, score);
+  Candidate best = idx < 0 ? k.current : random(idx);
+  if (idx < 0) return best;
+
+  // Neighbours: every dimension moved by -step, 0 or +step
+  long count = 1;
+  for (int d = 0; d < k.count; d++) count *= 3;
+  for (int step = 16; step >= 1; step /= 2) {
+    for (;;) {
+      auto neighbour = [&](long i) {
+        Candidate c = best;
+        for (int d = 0; d < k.count; d++) {
+          c.v[d] += ((int)(i % 3) - 1) * step;
+          i /= 3;
+          if (c.v[d] < k.ranges[d].lo) c.v[d] = k.ranges[d].lo;
+          if (c.v[d] > k.ranges[d].hi) c.v[d] = k.ranges[d].hi;
+        }
+        return c;
+      };
+      Score s;
+      long n = Parallel_Best(kind, count, neighbour, &s);
+      if (n < 0 || s.value <= score->value) break;
+      best = neighbour(n);
+      *score = s;
+    }
+  }
+  return best;
+}
+
+/*
+  OUTPUT
+*/
+
+/**
+ * @brief Write the tables header.
+*/
+void Write_Tables(FILE* out, const Candidate* tuned, const Score* scores, bool baseline) {
+  fprintf(out, "#ifndef GAIT_TABLES_H\n#define GAIT_TABLES_H\n\n");
+  fprintf(out, "/*\n  GAIT TABLES\n\n");
+  if (baseline) {
+    fprintf(out, "  Hand-tuned values, scored on the body model by\n");
+    fprintf(out, "  tools/gait_opt.cpp --baseline. A search run rewrites them.\n");
+  }
+  else {
+    fprintf(out, "  Generated by tools/gait_opt.cpp, do not edit by hand. Sidestep\n");
+    fprintf(out, "  values are not searched and pass through as tuned by hand.\n");
+  }
+  fprintf(out, "\n  Model rates:\n");
+  for (int kind = 0; kind < KIND_COUNT; kind++) {
+    if (!kinds[kind].modelled) {
+      fprintf(out, "    %-9s not modelled\n", kinds[kind].name);
+      continue;
+    }
+    const char* unit = kind == KIND_TURN ? "deg" : "mm";
+    fprintf(out, "    %-9s %7.1f %s/s, %6.1f %s per cycle\n",
+      kinds[kind].name, scores[kind].rate, unit, scores[kind].per_cycle, unit);
+  }
+  fprintf(out, "*/\n");
+  for (int kind = 0; kind < KIND_COUNT; kind++) {
+    const Kind_Def& k = kinds[kind];
+    fprintf(out, "\n");
+    for (int d = 0; d < k.count; d++) {
+      fprintf(out, "#define GAIT_%s_%s %d\n", k.prefix, k.ranges[d].name, tuned[kind].v[d]);
+    }
+  }
+  fprintf(out, "\n#endif\n");
+}
+
+/**
+ * @brief Time the walk search at 1, 2, 4 .. max threads.
+*/
+void Scaling(long samples, uint64_t seed, int max_threads) {
+  double single = 0;
+  for (int n = 1; ; n *= 2) {
+    if (n > max_threads) n = max_threads;
+    threads = n;
+    auto start = std::chrono::steady_clock::now();
+    Score s;
+    Search(KIND_WALK, samples, seed, &s);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (n == 1) single = ms;
+    fprintf(stderr, "%3d threads %9.1f ms  %5.2fx\n", n, ms, single / ms);
+    if (n == max_threads) break;
+  }
+}
+
+int main(int argc, char** argv) {
+  long samples = 20000;
+  uint64_t seed = 1;
+  const char* out_path = NULL;
+  bool baseline = false;
+  bool scaling = false;
+
+  threads = std::thread::hardware_concurrency();
+  if (threads < 1) threads = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--samples") && i + 1 < argc) samples = atol(argv[++i]);
+    else if (!strcmp(argv[i], "--threads") && i + 1 < argc) threads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = strtoull(argv[++i], NULL, 10);
+    else if (!strcmp(argv[i], "--out") && i + 1 < argc) out_path = argv[++i];
+    else if (!strcmp(argv[i], "--baseline")) baseline = true;
+    else if (!strcmp(argv[i], "--scaling")) scaling = true;
+    else {
+      fprintf(stderr, "usage: gait_opt [--samples N] [--threads N] [--seed N] [--out FILE] [--baseline] [--scaling]\n");
+      return 2;
+    }
+  }
+  if (threads < 1) threads = 1;
+  if (samples < 1) samples = 1;
+
+  if (scaling) {
+    Scaling(samples, seed, threads);
+    return 0;
+  }
+
+  Candidate tuned[KIND_COUNT];
+  Score scores[KIND_COUNT];
+  for (int kind = 0; kind < KIND_COUNT; kind++) {
+    const Kind_Def& k = kinds[kind];
+    tuned[kind] = k.current;
+    if (!k.modelled) {
+      fprintf(stderr, "%-9s not modelled, kept as tuned by hand\n", k.name);
+      continue;
+    }
+    Score current = Evaluate(kind, k.current);
+    scores[kind] = current;
+    if (!baseline) tuned[kind] = Search(kind, samples, seed, &scores[kind]);
+
+    fprintf(stderr, "%-9s current %8.1f/s ->", k.name, current.rate);
+    for (int d = 0; d < k.count; d++) fprintf(stderr, " %s=%d", k.ranges[d].name, tuned[kind].v[d]);
+    fprintf(stderr, "  %8.1f/s\n", scores[kind].rate);
+  }
+
+  FILE* out = out_path ? fopen(out_path, "w") : stdout;
+  if (!out) {
+    perror(out_path);
+    return 1;
+  }
+  Write_Tables(out, tuned, scores, baseline);
+  if (out != stdout) fclose(out);
+  return 0;
+}
@@ -0,0 +1,106 @@
+#ifndef HOST_ADAFRUIT_SSD1306_H
+#define HOST_ADAFRUIT_SSD1306_H
+
+#include <Arduino.h>
+#include <Wire.h>
+#include <Adafruit_GFX.h>
+#include <vector>
+
+/*
+  HOST SSD1306 EMULATOR
+
+  Adafruit_SSD1306 draws into its framebuffer as the library does
+  and display() sends it over the host Wire in the library's own
+  transactions, so byte counts and bus time match the target. On
+  the other end of the bus host_panel decodes the command and data
+  stream into its own display RAM, which is what a real panel would
+  show, including anything written to it with raw Wire calls.
+
+  A frame is the panel traffic between two snapshots. display()
+  closes one itself, host tools close the rest with
+  host_display_frame(), and every frame keeps a copy of the panel
+  RAM that can be written out as PBM or PNG.
+*/
+
+#define SSD1306_SWITCHCAPVCC 0x02
+#define SSD1306_BLACK 0
+#define SSD1306_WHITE 1
+#define SSD1306_INVERSE 2
+#define SSD1306_MEMORYMODE 0x20
+#define SSD1306_COLUMNADDR 0x21
+#define SSD1306_PAGEADDR 0x22
+#define SSD1306_DISPLAYOFF 0xAE
+#define SSD1306_DISPLAYON 0xAF
+
+#define HOST_PANEL_WIDTH 128
+#define HOST_PANEL_PAGES 8
+#define HOST_PANEL_RAM (HOST_PANEL_WIDTH * HOST_PANEL_PAGES)
+
+/**
+ * @brief The panel end of the bus.
+*/
+class Host_Ssd1306_Panel : public Host_I2C_Device {
+public:
+  void receive(const uint8_t* data, size_t len);
+
+  uint8_t ram[HOST_PANEL_RAM] = {};
+  bool on = false;
+
+private:
+  void command(uint8_t c);
+  void data(uint8_t d);
+
+  uint8_t col = 0, col_start = 0, col_end = HOST_PANEL_WIDTH - 1;
+  uint8_t page = 0, page_start = 0, page_end = HOST_PANEL_PAGES - 1;
+  uint8_t pending = 0;
+  uint8_t args_needed = 0;
+  uint8_t args_got = 0;
+  uint8_t args[6];
+};
+
+/**
+ * @brief Panel traffic and contents at the end of a frame.
+*/
+struct Host_Frame {
+  uint64_t at_us;
+  bool full;             // sent by display()
+  Host_I2C_Stats bus;    // traffic since the previous frame
+  uint8_t ram[HOST_PANEL_RAM];
+};
+
+extern Host_Ssd1306_Panel host_panel;
+extern std::vector<Host_Frame> host_frames;
+
+/**
+ * @brief Close the current frame if the bus carried anything since the last.
+ *
+ * @return true if a frame was recorded.
+*/
+bool host_display_frame(bool full = false);
+
+// Write panel RAM as an image, lit pixels white
+bool host_write_pbm(const char* path, const uint8_t* ram);
+bool host_write_png(const char* path, const uint8_t* ram);
+
+class Adafruit_SSD1306 : public Adafruit_GFX {
+public:
+  Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire* twi, int8_t rst_pin, uint32_t clk_during = 400000, uint32_t clk_after = 100000)
+    : Adafruit_GFX(w, h), wire(twi), clk_during(clk_during), clk_after(clk_after) {}
+  bool begin(uint8_t switchvcc, uint8_t i2caddr);
+  void clearDisplay() { memset(buffer, 0, sizeof(buffer)); }
+  void display();
+  void drawPixel(int16_t x, int16_t y, uint16_t color);
+  void ssd1306_command(uint8_t c);
+  uint8_t* getBuffer() { return buffer; }
+
+private:
+  void command_list(const uint8_t* c, uint8_t n);
+
+  TwoWire* wire;
+  uint32_t clk_during;
+  uint32_t clk_after;
+  uint8_t addr = 0x3C;
+  uint8_t buffer[HOST_PANEL_RAM] = {};
+};
+
+#endif
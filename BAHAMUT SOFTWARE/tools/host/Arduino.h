@@ -0,0 +1,178 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/*
+  HOST ARDUINO SHIM
+
+  Just enough of the Arduino-ESP32 core for src/main.cpp to build
+  and run natively. Time is virtual and only advances when a host
+  tool moves host_time_us (or the firmware calls delay()).
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+
+using std::min;
+using std::max;
+using std::abs;
+
+#define PROGMEM
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define LOW 0
+#define HIGH 1
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// Virtual clock in microseconds
+extern uint64_t host_time_us;
+// Value returned by analogRead() per pin
+extern int host_adc[40];
+// Last value passed to analogWrite() per pin
+extern int host_pwm[40];
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+
+void setup();
+void loop();
+
+/*
+  RESET SHIM
+
+  RTC_NOINIT_ATTR variables share one section, so a tool can save
+  them at the end of a run and put them back before the next one
+  to play a reset that keeps RTC memory.
+*/
+
+#define RTC_NOINIT_ATTR __attribute__((section("rtc_noinit")))
+
+typedef enum {
+  ESP_RST_UNKNOWN,
+  ESP_RST_POWERON,
+  ESP_RST_EXT,
+  ESP_RST_SW,
+  ESP_RST_PANIC,
+  ESP_RST_INT_WDT,
+  ESP_RST_TASK_WDT,
+  ESP_RST_WDT,
+  ESP_RST_DEEPSLEEP,
+  ESP_RST_BROWNOUT,
+  ESP_RST_SDIO
+} esp_reset_reason_t;
+
+// Returned by esp_reset_reason(), power-on unless a tool sets it
+extern esp_reset_reason_t host_reset_reason;
+esp_reset_reason_t esp_reset_reason();
+
+// Start and size of RTC_NOINIT memory
+uint8_t* host_rtc_noinit(size_t* size);
+
+/**
+ * @brief Cycle counter backed by the host's monotonic clock at 240 MHz.
+*/
+class EspClass {
+public:
+  uint32_t getCycleCount();
+  uint32_t getCpuFreqMHz() { return 240; }
+  uint32_t getFreeHeap() { return 0; }
+  uint32_t getMinFreeHeap() { return 0; }
+  uint32_t getMaxAllocHeap() { return 0; }
+};
+
+extern EspClass ESP;
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buf, size_t len) {
+    for (size_t i = 0; i < len; i++) write(buf[i]);
+    return len;
+  }
+  size_t write(const char* str) { return write((const uint8_t*)str, strlen(str)); }
+  size_t print(const char* str) { return write(str); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(int v) { return print((long)v); }
+  size_t print(unsigned v) { return print((unsigned long)v); }
+  size_t print(long v);
+  size_t print(unsigned long v);
+  size_t print(double v, int digits = 2);
+  size_t println() { return write("\r\n"); }
+  template <class T> size_t println(T v) { size_t n = print(v); return n + println(); }
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long baud) {}
+  size_t setTxBufferSize(size_t size) { return size; }
+  size_t setRxBufferSize(size_t size) { return size; }
+  int available();
+  int read();
+  int availableForWrite() { return 1024; }
+  size_t write(uint8_t c);
+  size_t write(const uint8_t* buf, size_t len);
+  using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+// Bytes queued here are returned by Serial.read()
+void host_serial_input(const char* text);
+// When set, everything written to Serial is copied here
+extern FILE* host_serial_output;
+
+/*
+  FREERTOS SHIM
+
+  Tasks are never started on the host. Host tools call task
+  bodies or their per-tick functions directly when needed.
+*/
+
+typedef void* TaskHandle_t;
+typedef void* SemaphoreHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFF
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void*), const char* name, uint32_t stack, void* arg, int prio, TaskHandle_t* handle, int core);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+void xTaskNotifyGive(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t* previous_wake, TickType_t ticks);
+TickType_t xTaskGetTickCount();
+void vTaskDelete(TaskHandle_t task);
+
+// Core the firmware believes it runs on, set by host tools
+extern int host_core;
+BaseType_t xPortGetCoreID();
+#define portDISABLE_INTERRUPTS()
+#define portENABLE_INTERRUPTS()
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateBinary();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+
+#endif
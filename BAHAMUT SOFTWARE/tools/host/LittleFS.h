@@ -0,0 +1,28 @@
+#ifndef HOST_LITTLEFS_H
+#define HOST_LITTLEFS_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Filesystem that never mounts, so file features stay disabled.
+*/
+class File {
+public:
+  operator bool() const { return false; }
+  size_t write(const uint8_t* buf, size_t len) { return 0; }
+  int read(uint8_t* buf, size_t len) { return 0; }
+  size_t size() { return 0; }
+  void close() {}
+};
+
+class LittleFSFS {
+public:
+  bool begin(bool format_on_fail = false) { return false; }
+  File open(const char* path, const char* mode = "r") { return File(); }
+  bool remove(const char* path) { return false; }
+  bool exists(const char* path) { return false; }
+};
+
+extern LittleFSFS LittleFS;
+
+#endif
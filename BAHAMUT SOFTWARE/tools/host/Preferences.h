@@ -0,0 +1,34 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <Arduino.h>
+#include <string.h>
+#include <vector>
+
+/**
+ * @brief In-memory NVS stand-in holding a single blob.
+ * 
+ * Starts empty, so the firmware boots on its defaults just as
+ * it does on a freshly erased board.
+*/
+class Preferences {
+public:
+  bool begin(const char* name, bool read_only = false) { return true; }
+  void end() {}
+  size_t getBytesLength(const char* key) { return blob.size(); }
+  size_t getBytes(const char* key, void* buf, size_t len) {
+    if (blob.empty() || len < blob.size()) return 0;
+    memcpy(buf, blob.data(), blob.size());
+    return blob.size();
+  }
+  size_t putBytes(const char* key, const void* buf, size_t len) {
+    blob.assign((const uint8_t*)buf, (const uint8_t*)buf + len);
+    return len;
+  }
+  bool remove(const char* key) { blob.clear(); return true; }
+
+private:
+  std::vector<uint8_t> blob;
+};
+
+#endif
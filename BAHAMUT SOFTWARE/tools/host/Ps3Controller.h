@@ -0,0 +1,73 @@
+#ifndef HOST_PS3_CONTROLLER_H
+#define HOST_PS3_CONTROLLER_H
+
+#include <Arduino.h>
+
+typedef struct {
+  uint8_t select : 1;
+  uint8_t l3 : 1;
+  uint8_t r3 : 1;
+  uint8_t start : 1;
+  uint8_t up : 1;
+  uint8_t right : 1;
+  uint8_t down : 1;
+  uint8_t left : 1;
+  uint8_t l2 : 1;
+  uint8_t r2 : 1;
+  uint8_t l1 : 1;
+  uint8_t r1 : 1;
+  uint8_t triangle : 1;
+  uint8_t circle : 1;
+  uint8_t cross : 1;
+  uint8_t square : 1;
+  uint8_t ps : 1;
+} ps3_button_t;
+
+typedef struct {
+  int8_t lx;
+  int8_t ly;
+  int8_t rx;
+  int8_t ry;
+} ps3_analog_stick_t;
+
+typedef struct {
+  ps3_analog_stick_t stick;
+} ps3_analog_t;
+
+typedef struct {
+  ps3_analog_t analog;
+  ps3_button_t button;
+} ps3_t;
+
+typedef struct {
+  ps3_button_t button_down;
+  ps3_button_t button_up;
+} ps3_event_t;
+
+/**
+ * @brief Controller whose state is set directly by host tools.
+*/
+class Ps3Class {
+public:
+  typedef void (*callback_t)();
+
+  bool begin(const char* mac = NULL) { return true; }
+  bool end() { return true; }
+  void attach(callback_t cb) { on_packet = cb; }
+  void attachOnConnect(callback_t cb) { on_connect = cb; }
+  void attachOnDisconnect(callback_t cb) { on_disconnect = cb; }
+  bool isConnected() { return connected; }
+  void setPlayer(int player) {}
+
+  ps3_t data = {};
+  ps3_event_t event = {};
+
+  bool connected = false;
+  callback_t on_packet = NULL;
+  callback_t on_connect = NULL;
+  callback_t on_disconnect = NULL;
+};
+
+extern Ps3Class Ps3;
+
+#endif
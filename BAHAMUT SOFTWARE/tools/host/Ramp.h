@@ -0,0 +1,46 @@
+#ifndef HOST_RAMP_H
+#define HOST_RAMP_H
+
+#include <Arduino.h>
+
+enum ramp_mode { NONE, LINEAR };
+enum loop_mode { ONCEFORWARD, LOOPFORWARD, FORTHANDBACK, ONCEBACKWARD, LOOPBACKWARD, BACKANDFORTH };
+
+/**
+ * @brief Linear-only stand-in for Ramp's rampInt, driven by millis().
+*/
+class rampInt {
+public:
+  int go(int target, unsigned long duration = 0, ramp_mode mode = NONE, loop_mode loop = ONCEFORWARD) {
+    origin = value;
+    this->target = target;
+    this->duration = duration;
+    this->loop = loop;
+    start = millis();
+    if (duration == 0) origin = value = target;
+    return value;
+  }
+
+  int update() {
+    if (duration == 0) return value;
+    unsigned long t = millis() - start;
+    bool forth_and_back = loop == FORTHANDBACK || loop == BACKANDFORTH;
+    if (loop == ONCEFORWARD && t >= duration) value = target;
+    else {
+      t %= forth_and_back ? 2 * duration : duration;
+      if (t > duration) t = 2 * duration - t;
+      value = origin + (long)(target - origin) * (long)t / (long)duration;
+    }
+    return value;
+  }
+
+private:
+  int origin = 0;
+  int target = 0;
+  int value = 0;
+  unsigned long duration = 0;
+  unsigned long start = 0;
+  loop_mode loop = ONCEFORWARD;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include <Arduino.h>
+
+/*
+  HOST I2C SHIM
+
+  Transactions are delivered whole to whichever emulated device
+  has attached at the address, and every one is accounted as it
+  would cross the bus: a start bit, the address byte and each data
+  byte with its ACK bit, and a stop bit. Bus time follows from the
+  bit count at whatever clock is set when the transaction ends.
+*/
+
+// Same transmit buffer as the ESP32 Arduino core
+#define I2C_BUFFER_LENGTH 128
+
+/**
+ * @brief Emulated peripheral on the host bus.
+*/
+class Host_I2C_Device {
+public:
+  virtual ~Host_I2C_Device() {}
+  virtual void receive(const uint8_t* data, size_t len) = 0;
+};
+
+/**
+ * @brief Running totals of bus traffic.
+*/
+struct Host_I2C_Stats {
+  uint32_t transactions;
+  uint32_t bytes;       // address bytes included
+  uint64_t bits;        // start, stop and ACK bits included
+  double bus_us;        // at the clock each transaction ran at
+};
+
+class TwoWire {
+public:
+  bool begin() { return true; }
+  void setClock(uint32_t freq) { clock = freq; }
+  uint32_t getClock() { return clock; }
+  void beginTransmission(uint8_t addr);
+  size_t write(uint8_t c);
+  size_t write(const uint8_t* buf, size_t len);
+  uint8_t endTransmission(bool stop = true);
+
+  // Route transactions for addr to dev
+  void attachDevice(uint8_t addr, Host_I2C_Device* dev);
+
+  Host_I2C_Stats stats = {};
+
+private:
+  uint32_t clock = 100000;
+  uint8_t address = 0;
+  size_t length = 0;
+  bool overflow = false;
+  uint8_t buffer[I2C_BUFFER_LENGTH];
+  Host_I2C_Device* devices[128] = {};
+};
+
+extern TwoWire Wire;
+
+/**
+ * @brief Bits a transaction of len data bytes puts on the bus.
+*/
+static inline uint32_t Host_I2C_Bits(size_t len) {
+  return 1 + 9 * (uint32_t)(len + 1) + 1;
+}
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef HOST_DRIVER_LEDC_H
+#define HOST_DRIVER_LEDC_H
+
+#include <Arduino.h>
+
+/*
+  HOST LEDC SHIM
+
+  Records what the firmware asks of the LED PWM peripheral: timer
+  dividers, which timer each channel runs from and the last duty
+  set. Nothing is generated, pulse timing is the firmware's to
+  model.
+*/
+
+#define ESP_OK 0
+
+typedef int esp_err_t;
+
+typedef enum {
+  LEDC_HIGH_SPEED_MODE,
+  LEDC_LOW_SPEED_MODE,
+  LEDC_SPEED_MODE_MAX
+} ledc_mode_t;
+
+typedef enum {
+  LEDC_TIMER_0,
+  LEDC_TIMER_1,
+  LEDC_TIMER_2,
+  LEDC_TIMER_3,
+  LEDC_TIMER_MAX
+} ledc_timer_t;
+
+typedef enum {
+  LEDC_CHANNEL_0,
+  LEDC_CHANNEL_1,
+  LEDC_CHANNEL_2,
+  LEDC_CHANNEL_3,
+  LEDC_CHANNEL_4,
+  LEDC_CHANNEL_5,
+  LEDC_CHANNEL_6,
+  LEDC_CHANNEL_7,
+  LEDC_CHANNEL_MAX
+} ledc_channel_t;
+
+typedef int ledc_timer_bit_t;
+
+typedef enum {
+  LEDC_AUTO_CLK,
+  LEDC_USE_REF_TICK,
+  LEDC_USE_APB_CLK,
+  LEDC_USE_RTC8M_CLK
+} ledc_clk_cfg_t;
+
+typedef enum {
+  LEDC_REF_CLK,
+  LEDC_APB_CLK
+} ledc_clk_src_t;
+
+typedef enum {
+  LEDC_INTR_DISABLE,
+  LEDC_INTR_FADE_END
+} ledc_intr_type_t;
+
+typedef struct {
+  ledc_mode_t speed_mode;
+  ledc_timer_bit_t duty_resolution;
+  ledc_timer_t timer_num;
+  uint32_t freq_hz;
+  ledc_clk_cfg_t clk_cfg;
+} ledc_timer_config_t;
+
+typedef struct {
+  int gpio_num;
+  ledc_mode_t speed_mode;
+  ledc_channel_t channel;
+  ledc_intr_type_t intr_type;
+  ledc_timer_t timer_sel;
+  uint32_t duty;
+  int hpoint;
+} ledc_channel_config_t;
+
+struct Host_Ledc_Timer {
+  uint32_t freq_hz;
+  // Clock divider with 8 fractional bits, 0 until ledc_timer_set()
+  uint32_t divider;
+  uint32_t bits;
+  uint32_t resets;
+};
+
+struct Host_Ledc_Channel {
+  int gpio;
+  int timer;
+  uint32_t duty;
+  uint32_t updates;
+};
+
+extern Host_Ledc_Timer host_ledc_timers[LEDC_SPEED_MODE_MAX][LEDC_TIMER_MAX];
+extern Host_Ledc_Channel host_ledc_channels[LEDC_SPEED_MODE_MAX][LEDC_CHANNEL_MAX];
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t* timer_conf);
+esp_err_t ledc_timer_set(ledc_mode_t speed_mode, ledc_timer_t timer_sel, uint32_t clock_divider,
+  uint32_t duty_resolution, ledc_clk_src_t clk_src);
+esp_err_t ledc_timer_rst(ledc_mode_t speed_mode, ledc_timer_t timer_sel);
+esp_err_t ledc_channel_config(const ledc_channel_config_t* ledc_conf);
+esp_err_t ledc_bind_channel_timer(ledc_mode_t speed_mode, ledc_channel_t channel, ledc_timer_t timer_sel);
+esp_err_t ledc_set_duty(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t duty);
+esp_err_t ledc_update_duty(ledc_mode_t speed_mode, ledc_channel_t channel);
+
+#endif
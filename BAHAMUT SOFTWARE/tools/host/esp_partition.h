@@ -0,0 +1,50 @@
+#ifndef HOST_ESP_PARTITION_H
+#define HOST_ESP_PARTITION_H
+
+#include <Arduino.h>
+#include <vector>
+
+/*
+  HOST PARTITION SHIM
+
+  A single data partition whose contents are host_partition_data,
+  found by any label and subtype while host_partition_data is not
+  empty. Mapping hands out a pointer into the vector, which is as
+  zero-copy as the target's cache mapping.
+*/
+
+#define ESP_OK 0
+#define ESP_ERR_NOT_FOUND 0x105
+
+typedef int esp_err_t;
+typedef uint32_t spi_flash_mmap_handle_t;
+
+typedef enum {
+  ESP_PARTITION_TYPE_APP = 0x00,
+  ESP_PARTITION_TYPE_DATA = 0x01
+} esp_partition_type_t;
+
+typedef int esp_partition_subtype_t;
+
+typedef enum {
+  SPI_FLASH_MMAP_DATA,
+  SPI_FLASH_MMAP_INST
+} spi_flash_mmap_memory_t;
+
+typedef struct {
+  esp_partition_type_t type;
+  esp_partition_subtype_t subtype;
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+} esp_partition_t;
+
+// Contents of the emulated partition, empty means absent
+extern std::vector<uint8_t> host_partition_data;
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char* label);
+esp_err_t esp_partition_mmap(const esp_partition_t* partition, size_t offset, size_t size,
+  spi_flash_mmap_memory_t memory, const void** out_ptr, spi_flash_mmap_handle_t* out_handle);
+void spi_flash_munmap(spi_flash_mmap_handle_t handle);
+
+#endif
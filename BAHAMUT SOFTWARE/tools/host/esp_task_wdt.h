@@ -0,0 +1,15 @@
+#ifndef HOST_ESP_TASK_WDT_H
+#define HOST_ESP_TASK_WDT_H
+
+#include <Arduino.h>
+
+/**
+ * @brief Task watchdog that is never armed on the host.
+*/
+typedef int esp_err_t;
+
+static inline esp_err_t esp_task_wdt_init(uint32_t timeout, bool panic) { return 0; }
+static inline esp_err_t esp_task_wdt_add(TaskHandle_t task) { return 0; }
+static inline esp_err_t esp_task_wdt_reset() { return 0; }
+
+#endif
@@ -0,0 +1,576 @@
+/*
+  HOST SHIM DEFINITIONS
+*/
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include <string>
+#include <chrono>
+#include <Wire.h>
+#include <Adafruit_SSD1306.h>
+#include <hud.h>
+#include <Ps3Controller.h>
+#include <LittleFS.h>
+#include <esp_partition.h>
+#include <driver/ledc.h>
+
+uint64_t host_time_us = 0;
+int host_adc[40];
+int host_pwm[40];
+FILE* host_serial_output = NULL;
+
+HardwareSerial Serial;
+EspClass ESP;
+TwoWire Wire;
+Ps3Class Ps3;
+LittleFSFS LittleFS;
+
+static std::string serial_input;
+
+unsigned long millis() { return (unsigned long)(host_time_us / 1000); }
+unsigned long micros() { return (unsigned long)host_time_us; }
+void delay(uint32_t ms) { host_time_us += (uint64_t)ms * 1000; }
+void delayMicroseconds(uint32_t us) { host_time_us += us; }
+
+uint32_t EspClass::getCycleCount() {
+  auto ns = std::chrono::steady_clock::now().time_since_epoch();
+  return (uint32_t)(std::chrono::duration_cast<std::chrono::nanoseconds>(ns).count() * 240 / 1000);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+void digitalWrite(uint8_t pin, uint8_t val) {}
+int analogRead(uint8_t pin) { return host_adc[pin % 40]; }
+void analogWrite(uint8_t pin, int value) { host_pwm[pin % 40] = value; }
+
+size_t Print::print(long v) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%ld", v);
+  return write(buf);
+}
+
+size_t Print::print(unsigned long v) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%lu", v);
+  return write(buf);
+}
+
+size_t Print::print(double v, int digits) {
+  char buf[40];
+  snprintf(buf, sizeof(buf), "%.*f", digits, v);
+  return write(buf);
+}
+
+size_t Print::printf(const char* fmt, ...) {
+  char buf[256];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, args);
+  va_end(args);
+  return write(buf);
+}
+
+int HardwareSerial::available() { return serial_input.size(); }
+
+int HardwareSerial::read() {
+  if (serial_input.empty()) return -1;
+  int c = (uint8_t)serial_input[0];
+  serial_input.erase(0, 1);
+  return c;
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (host_serial_output != NULL) fputc(c, host_serial_output);
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t* buf, size_t len) {
+  if (host_serial_output != NULL) fwrite(buf, 1, len, host_serial_output);
+  return len;
+}
+
+void host_serial_input(const char* text) { serial_input += text; }
+
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void*), const char* name, uint32_t stack, void* arg, int prio, TaskHandle_t* handle, int core) {
+  if (handle != NULL) *handle = NULL;
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) { return 0; }
+void xTaskNotifyGive(TaskHandle_t task) {}
+void vTaskDelay(TickType_t ticks) { host_time_us += (uint64_t)ticks * 1000; }
+TickType_t xTaskGetTickCount() { return millis(); }
+void vTaskDelete(TaskHandle_t task) {}
+
+int host_core = 1;
+BaseType_t xPortGetCoreID() { return host_core; }
+
+void vTaskDelayUntil(TickType_t* previous_wake, TickType_t ticks) {
+  *previous_wake += ticks;
+  if (millis() < *previous_wake) host_time_us = (uint64_t)*previous_wake * 1000;
+}
+
+// Everything runs on one host thread, so a mutex never contends
+static int host_mutex;
+SemaphoreHandle_t xSemaphoreCreateMutex() { return &host_mutex; }
+SemaphoreHandle_t xSemaphoreCreateBinary() { return &host_mutex; }
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) { return pdTRUE; }
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) { return pdTRUE; }
+
+/*
+  PARTITIONS
+*/
+
+std::vector<uint8_t> host_partition_data;
+static esp_partition_t host_partition;
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char* label) {
+  if (host_partition_data.empty() || type != ESP_PARTITION_TYPE_DATA) return NULL;
+  host_partition.type = type;
+  host_partition.subtype = subtype;
+  host_partition.size = host_partition_data.size();
+  snprintf(host_partition.label, sizeof(host_partition.label), "%s", label ? label : "");
+  return &host_partition;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t* partition, size_t offset, size_t size,
+  spi_flash_mmap_memory_t memory, const void** out_ptr, spi_flash_mmap_handle_t* out_handle) {
+  if (partition != &host_partition || offset + size > host_partition_data.size()) return ESP_ERR_NOT_FOUND;
+  *out_ptr = host_partition_data.data() + offset;
+  *out_handle = 1;
+  return ESP_OK;
+}
+
+void spi_flash_munmap(spi_flash_mmap_handle_t handle) {}
+
+/*
+  LEDC
+*/
+
+Host_Ledc_Timer host_ledc_timers[LEDC_SPEED_MODE_MAX][LEDC_TIMER_MAX];
+Host_Ledc_Channel host_ledc_channels[LEDC_SPEED_MODE_MAX][LEDC_CHANNEL_MAX];
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t* timer_conf) {
+  Host_Ledc_Timer& t = host_ledc_timers[timer_conf->speed_mode][timer_conf->timer_num];
+  t.freq_hz = timer_conf->freq_hz;
+  t.bits = timer_conf->duty_resolution;
+  return ESP_OK;
+}
+
+esp_err_t ledc_timer_set(ledc_mode_t speed_mode, ledc_timer_t timer_sel, uint32_t clock_divider,
+    uint32_t duty_resolution, ledc_clk_src_t clk_src) {
+  Host_Ledc_Timer& t = host_ledc_timers[speed_mode][timer_sel];
+  t.divider = clock_divider;
+  t.bits = duty_resolution;
+  return ESP_OK;
+}
+
+esp_err_t ledc_timer_rst(ledc_mode_t speed_mode, ledc_timer_t timer_sel) {
+  host_ledc_timers[speed_mode][timer_sel].resets++;
+  return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t* ledc_conf) {
+  Host_Ledc_Channel& c = host_ledc_channels[ledc_conf->speed_mode][ledc_conf->channel];
+  c.gpio = ledc_conf->gpio_num;
+  c.timer = ledc_conf->timer_sel;
+  c.duty = ledc_conf->duty;
+  return ESP_OK;
+}
+
+esp_err_t ledc_bind_channel_timer(ledc_mode_t speed_mode, ledc_channel_t channel, ledc_timer_t timer_sel) {
+  host_ledc_channels[speed_mode][channel].timer = timer_sel;
+  return ESP_OK;
+}
+
+esp_err_t ledc_set_duty(ledc_mode_t speed_mode, ledc_channel_t channel, uint32_t duty) {
+  host_ledc_channels[speed_mode][channel].duty = duty;
+  return ESP_OK;
+}
+
+esp_err_t ledc_update_duty(ledc_mode_t speed_mode, ledc_channel_t channel) {
+  host_ledc_channels[speed_mode][channel].updates++;
+  return ESP_OK;
+}
+
+/*
+  RESET
+*/
+
+esp_reset_reason_t host_reset_reason = ESP_RST_POWERON;
+
+esp_reset_reason_t esp_reset_reason() { return host_reset_reason; }
+
+// Placed by the linker around the rtc_noinit section
+extern uint8_t __start_rtc_noinit[];
+extern uint8_t __stop_rtc_noinit[];
+
+uint8_t* host_rtc_noinit(size_t* size) {
+  *size = __stop_rtc_noinit - __start_rtc_noinit;
+  return __start_rtc_noinit;
+}
+
+/*
+  I2C
+*/
+
+void TwoWire::beginTransmission(uint8_t addr) {
+  address = addr & 0x7F;
+  length = 0;
+  overflow = false;
+}
+
+size_t TwoWire::write(uint8_t c) {
+  if (length >= I2C_BUFFER_LENGTH) {
+    overflow = true;
+    return 0;
+  }
+  buffer[length++] = c;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t* buf, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (!write(buf[i])) return i;
+  }
+  return len;
+}
+
+uint8_t TwoWire::endTransmission(bool stop) {
+  if (overflow) return 1;
+  uint32_t bits = Host_I2C_Bits(length);
+  stats.transactions++;
+  stats.bytes += length + 1;
+  stats.bits += bits;
+  stats.bus_us += bits * 1e6 / clock;
+  if (devices[address] == NULL) return 2;
+  devices[address]->receive(buffer, length);
+  return 0;
+}
+
+void TwoWire::attachDevice(uint8_t addr, Host_I2C_Device* dev) { devices[addr & 0x7F] = dev; }
+
+/*
+  SSD1306
+*/
+
+Host_Ssd1306_Panel host_panel;
+std::vector<Host_Frame> host_frames;
+static Host_I2C_Stats frame_start = {};
+
+void Host_Ssd1306_Panel::receive(const uint8_t* buf, size_t len) {
+  if (len == 0) return;
+  // Control byte: D/C# picks data or commands for the rest
+  bool is_data = buf[0] & 0x40;
+  for (size_t i = 1; i < len; i++) {
+    if (is_data) data(buf[i]);
+    else command(buf[i]);
+  }
+}
+
+void Host_Ssd1306_Panel::command(uint8_t c) {
+  if (args_needed) {
+    args[args_got++] = c;
+    if (args_got < args_needed) return;
+    args_needed = 0;
+    switch (pending) {
+      case SSD1306_COLUMNADDR:
+        col_start = args[0] & 0x7F;
+        col_end = args[1] & 0x7F;
+        col = col_start;
+        break;
+      case SSD1306_PAGEADDR:
+        page_start = args[0] & 0x07;
+        page_end = args[1] & 0x07;
+        page = page_start;
+        break;
+    }
+    return;
+  }
+
+  pending = c;
+  args_got = 0;
+  switch (c) {
+    case SSD1306_COLUMNADDR:
+    case SSD1306_PAGEADDR:
+    case 0xA3:
+      args_needed = 2;
+      break;
+    case SSD1306_MEMORYMODE:
+    case 0x81: case 0x8D: case 0xA8: case 0xD3:
+    case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+      args_needed = 1;
+      break;
+    case 0x26: case 0x27:
+      args_needed = 6;
+      break;
+    case 0x29: case 0x2A:
+      args_needed = 5;
+      break;
+    case SSD1306_DISPLAYOFF:
+      on = false;
+      break;
+    case SSD1306_DISPLAYON:
+      on = true;
+      break;
+  }
+}
+
+void Host_Ssd1306_Panel::data(uint8_t d) {
+  // Horizontal addressing, wrapping inside the column and page window
+  ram[page * HOST_PANEL_WIDTH + col] = d;
+  if (col < col_end) col++;
+  else {
+    col = col_start;
+    page = page < page_end ? page + 1 : page_start;
+  }
+}
+
+bool host_display_frame(bool full) {
+  Host_I2C_Stats now = Wire.stats;
+  if (now.transactions == frame_start.transactions) return false;
+
+  Host_Frame frame;
+  frame.at_us = host_time_us;
+  frame.full = full;
+  frame.bus.transactions = now.transactions - frame_start.transactions;
+  frame.bus.bytes = now.bytes - frame_start.bytes;
+  frame.bus.bits = now.bits - frame_start.bits;
+  frame.bus.bus_us = now.bus_us - frame_start.bus_us;
+  memcpy(frame.ram, host_panel.ram, sizeof(frame.ram));
+  host_frames.push_back(frame);
+  frame_start = now;
+  return true;
+}
+
+static bool Lit(const uint8_t* ram, int x, int y) {
+  return ram[(y / 8) * HOST_PANEL_WIDTH + x] & (1 << (y & 7));
+}
+
+bool host_write_pbm(const char* path, const uint8_t* ram) {
+  FILE* f = fopen(path, "wb");
+  if (f == NULL) return false;
+  fprintf(f, "P4\n%d %d\n", HOST_PANEL_WIDTH, HOST_PANEL_PAGES * 8);
+  // PBM ink is 1, so lit pixels are written as 0
+  for (int y = 0; y < HOST_PANEL_PAGES * 8; y++) {
+    for (int x = 0; x < HOST_PANEL_WIDTH; x += 8) {
+      uint8_t b = 0;
+      for (int i = 0; i < 8; i++) if (!Lit(ram, x + i, y)) b |= 0x80 >> i;
+      fputc(b, f);
+    }
+  }
+  return fclose(f) == 0;
+}
+
+static uint32_t Crc32(uint32_t crc, const uint8_t* p, size_t n) {
+  crc = ~crc;
+  for (size_t i = 0; i < n; i++) {
+    crc ^= p[i];
+    for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+  }
+  return ~crc;
+}
+
+static void Put32(std::string& s, uint32_t v) {
+  for (int i = 3; i >= 0; i--) s += (char)(v >> (8 * i));
+}
+
+static void Png_Chunk(FILE* f, const char* type, const std::string& body) {
+  std::string c;
+  Put32(c, body.size());
+  c += type;
+  c += body;
+  Put32(c, Crc32(0, (const uint8_t*)c.data() + 4, c.size() - 4));
+  fwrite(c.data(), 1, c.size(), f);
+}
+
+bool host_write_png(const char* path, const uint8_t* ram) {
+  FILE* f = fopen(path, "wb");
+  if (f == NULL) return false;
+  const int width = HOST_PANEL_WIDTH;
+  const int height = HOST_PANEL_PAGES * 8;
+  fwrite("\x89PNG\r\n\x1a\n", 1, 8, f);
+
+  std::string ihdr;
+  Put32(ihdr, width);
+  Put32(ihdr, height);
+  ihdr += (char)1;    // bit depth
+  ihdr += (char)0;    // greyscale
+  ihdr += std::string(3, '\0');
+  Png_Chunk(f, "IHDR", ihdr);
+
+  // Scanlines, filter 0, one bit per pixel, lit pixels white
+  std::string raw;
+  for (int y = 0; y < height; y++) {
+    raw += (char)0;
+    for (int x = 0; x < width; x += 8) {
+      uint8_t b = 0;
+      for (int i = 0; i < 8; i++) if (Lit(ram, x + i, y)) b |= 0x80 >> i;
+      raw += (char)b;
+    }
+  }
+
+  // zlib stream of one stored deflate block, the image is well under 64 KB
+  std::string z;
+  z += (char)0x78;
+  z += (char)0x01;
+  z += (char)1;
+  z += (char)(raw.size() & 0xFF);
+  z += (char)(raw.size() >> 8);
+  z += (char)(~raw.size() & 0xFF);
+  z += (char)((~raw.size() >> 8) & 0xFF);
+  z += raw;
+  uint32_t a = 1, b = 0;
+  for (unsigned char c : raw) {
+    a = (a + c) % 65521;
+    b = (b + a) % 65521;
+  }
+  Put32(z, (b << 16) | a);
+  Png_Chunk(f, "IDAT", z);
+  Png_Chunk(f, "IEND", "");
+  return fclose(f) == 0;
+}
+
+bool Adafruit_SSD1306::begin(uint8_t switchvcc, uint8_t i2caddr) {
+  addr = i2caddr;
+  wire->attachDevice(addr, &host_panel);
+  clearDisplay();
+  // Library init sequence for a 128x64 panel on the charge pump
+  static const uint8_t init[] = {
+    SSD1306_DISPLAYOFF, 0xD5, 0x80, 0xA8, 63, 0xD3, 0x00, 0x40, 0x8D, 0x14,
+    SSD1306_MEMORYMODE, 0x00, 0xA1, 0xC8, 0xDA, 0x12, 0x81, 0xCF, 0xD9, 0xF1,
+    0xDB, 0x40, 0xA4, 0xA6, 0x2E, SSD1306_DISPLAYON
+  };
+  wire->setClock(clk_during);
+  command_list(init, sizeof(init));
+  wire->setClock(clk_after);
+  return true;
+}
+
+void Adafruit_SSD1306::command_list(const uint8_t* c, uint8_t n) {
+  wire->beginTransmission(addr);
+  wire->write((uint8_t)0x00);
+  uint16_t out = 1;
+  while (n--) {
+    if (out >= I2C_BUFFER_LENGTH) {
+      wire->endTransmission();
+      wire->beginTransmission(addr);
+      wire->write((uint8_t)0x00);
+      out = 1;
+    }
+    wire->write(*c++);
+    out++;
+  }
+  wire->endTransmission();
+}
+
+void Adafruit_SSD1306::ssd1306_command(uint8_t c) {
+  wire->beginTransmission(addr);
+  wire->write((uint8_t)0x00);
+  wire->write(c);
+  wire->endTransmission();
+}
+
+void Adafruit_SSD1306::display() {
+  // Same transactions as the library: window, then the buffer in
+  // as many data writes as the Wire buffer needs
+  wire->setClock(clk_during);
+  static const uint8_t window[] = { SSD1306_PAGEADDR, 0, 0xFF, SSD1306_COLUMNADDR, 0 };
+  command_list(window, sizeof(window));
+  ssd1306_command(WIDTH - 1);
+
+  const uint8_t* p = buffer;
+  uint16_t count = WIDTH * ((HEIGHT + 7) / 8);
+  wire->beginTransmission(addr);
+  wire->write((uint8_t)0x40);
+  uint16_t out = 1;
+  while (count--) {
+    if (out >= I2C_BUFFER_LENGTH) {
+      wire->endTransmission();
+      wire->beginTransmission(addr);
+      wire->write((uint8_t)0x40);
+      out = 1;
+    }
+    wire->write(*p++);
+    out++;
+  }
+  wire->endTransmission();
+  wire->setClock(clk_after);
+  host_display_frame(true);
+}
+
+void Adafruit_SSD1306::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  if (x < 0 || x >= width() || y < 0 || y >= height()) return;
+  int16_t t;
+  switch (rotation) {
+    case 1:
+      t = x; x = y; y = t;
+      x = WIDTH - x - 1;
+      break;
+    case 2:
+      x = WIDTH - x - 1;
+      y = HEIGHT - y - 1;
+      break;
+    case 3:
+      t = x; x = y; y = t;
+      y = HEIGHT - y - 1;
+      break;
+  }
+  uint8_t& byte = buffer[x + (y / 8) * WIDTH];
+  uint8_t bit = 1 << (y & 7);
+  if (color == SSD1306_WHITE) byte |= bit;
+  else if (color == SSD1306_BLACK) byte &= ~bit;
+  else if (color == SSD1306_INVERSE) byte ^= bit;
+}
+
+/*
+  GFX
+*/
+
+void Adafruit_GFX::setRotation(uint8_t r) {
+  rotation = r & 3;
+  _width = (rotation & 1) ? HEIGHT : WIDTH;
+  _height = (rotation & 1) ? WIDTH : HEIGHT;
+}
+
+void Adafruit_GFX::drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint16_t bg, uint8_t size) {
+  if (x >= _width || y >= _height || x + 6 * size - 1 < 0 || y + 8 * size - 1 < 0) return;
+  // The classic font, hud.h carries its printable range
+  const uint8_t* glyph = (c >= HUD_FIRST_CHAR && c <= HUD_LAST_CHAR) ? hud_font[c - HUD_FIRST_CHAR] : NULL;
+  for (int i = 0; i < 6; i++) {
+    uint8_t line = (glyph && i < 5) ? glyph[i] : 0;
+    for (int j = 0; j < 8; j++, line >>= 1) {
+      uint16_t ink;
+      if (line & 1) ink = color;
+      else if (bg != color) ink = bg;
+      else continue;
+      for (int sx = 0; sx < size; sx++) {
+        for (int sy = 0; sy < size; sy++) drawPixel(x + i * size + sx, y + j * size + sy, ink);
+      }
+    }
+  }
+}
+
+void Adafruit_GFX::drawBitmap(int16_t x, int16_t y, const uint8_t* bitmap, int16_t w, int16_t h, uint16_t color) {
+  int16_t byte_width = (w + 7) / 8;
+  for (int16_t j = 0; j < h; j++) {
+    for (int16_t i = 0; i < w; i++) {
+      if (bitmap[j * byte_width + i / 8] & (0x80 >> (i & 7))) drawPixel(x + i, y + j, color);
+    }
+  }
+}
+
+size_t Adafruit_GFX::write(uint8_t c) {
+  if (c == '\n') {
+    cursor_x = 0;
+    cursor_y += textsize * 8;
+  }
+  else if (c != '\r') {
+    if (wrap && cursor_x + textsize * 6 > _width) {
+      cursor_x = 0;
+      cursor_y += textsize * 8;
+    }
+    drawChar(cursor_x, cursor_y, c, textcolor, textbgcolor, textsize);
+    cursor_x += textsize * 6;
+  }
+  return 1;
+}
@@ -0,0 +1,294 @@
+/*
+  MOTION PACK BUILDER
+
+  Host-side tool that compiles a text description of moves into
+  a motion pack (see src/motion_pack.h) ready to flash to the
+  "motion" partition, or checks and lists an existing pack.
+
+  Build:
+    g++ -std=c++17 -O2 -I src tools/pack_build.cpp -o pack_build
+
+  Usage:
+    pack_build moves.txt pack.bin   compile
+    pack_build --dump pack.bin      check and list a pack
+
+  Flash the result on its own with
+    esptool.py write_flash 0x3E0000 pack.bin
+
+  The text is one statement per line, # starts a comment:
+
+    pose <name> [<joint>=<offset> ...]
+        offsets in degrees from the move's base pose, joints
+        rs rb ls lb w rh rf lh lf, unlisted joints 0
+    move <name> <trigger> <base> <joints>
+        trigger is a chord of buttons joined by +, e.g. l3+r1,
+        base is rest, std, gaucho or crouch, joints the ones the
+        move drives joined by commas, the rest stay at rest
+    key <ms> <pose> [linear]
+        a key of the last move, at ms since the move started;
+        linear eases into it from the previous key
+
+  Poses are shared between moves. Triangle and PS are taken by
+  the recorder and cannot trigger a move.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <buttons.h>
+#include <motion_pack.h>
+
+static const char* joint_names[MOTION_PACK_JOINTS] = { "rs", "rb", "ls", "lb", "w", "rh", "rf", "lh", "lf" };
+static const char* base_names[MOTION_PACK_BASE_COUNT] = { "rest", "std", "gaucho", "crouch" };
+
+struct Source {
+  std::vector<std::string> pose_names;
+  std::vector<Motion_Pack_Pose> poses;
+  std::vector<Motion_Pack_Move> moves;
+  std::vector<Motion_Pack_Key> keys;
+};
+
+int Find(const char* const* names, int count, const std::string& name) {
+  for (int i = 0; i < count; i++) {
+    if (name == names[i]) return i;
+  }
+  return -1;
+}
+
+/**
+ * @brief Parse a chord like l3+r1 into BTN_* bits.
+ *
+ * @return the bits, 0 if a name is unknown or reserved.
+*/
+uint32_t Parse_Trigger(const std::string& text) {
+  uint32_t bits = 0;
+  size_t start = 0;
+  while (start <= text.size()) {
+    size_t end = text.find('+', start);
+    if (end == std::string::npos) end = text.size();
+    int b = Find(button_names, BTN_COUNT, text.substr(start, end - start));
+    if (b < 0 || (1UL << b) == BTN_TRIANGLE || (1UL << b) == BTN_PS) return 0;
+    bits |= 1UL << b;
+    start = end + 1;
+  }
+  return bits;
+}
+
+/**
+ * @brief Parse a comma separated joint list into a mask.
+ *
+ * @return the mask, 0 if a name is unknown.
+*/
+uint16_t Parse_Mask(const std::string& text) {
+  uint16_t mask = 0;
+  size_t start = 0;
+  while (start <= text.size()) {
+    size_t end = text.find(',', start);
+    if (end == std::string::npos) end = text.size();
+    int j = Find(joint_names, MOTION_PACK_JOINTS, text.substr(start, end - start));
+    if (j < 0) return 0;
+    mask |= 1 << j;
+    start = end + 1;
+  }
+  return mask;
+}
+
+/**
+ * @brief Parse one statement.
+ *
+ * @return an error message, NULL if the line is fine.
+*/
+const char* Parse_Line(Source& src, char* line) {
+  char* hash = strchr(line, '#');
+  if (hash) *hash = '\0';
+  std::vector<std::string> words;
+  for (char* w = strtok(line, " \t\r\n"); w; w = strtok(NULL, " \t\r\n")) words.push_back(w);
+  if (words.empty()) return NULL;
+
+  if (words[0] == "pose") {
+    if (words.size() < 2) return "pose needs a name";
+    for (const std::string& n : src.pose_names) {
+      if (n == words[1]) return "pose defined twice";
+    }
+    Motion_Pack_Pose pose = {};
+    for (size_t i = 2; i < words.size(); i++) {
+      size_t eq = words[i].find('=');
+      int j = eq == std::string::npos ? -1 : Find(joint_names, MOTION_PACK_JOINTS, words[i].substr(0, eq));
+      if (j < 0) return "expected joint=offset";
+      char* end;
+      long v = strtol(words[i].c_str() + eq + 1, &end, 10);
+      if (*end != '\0' || v < -128 || v > 127) return "offset out of -128..127";
+      pose.offset[j] = v;
+    }
+    if (src.poses.size() == 256) return "more than 256 poses";
+    src.pose_names.push_back(words[1]);
+    src.poses.push_back(pose);
+  }
+  else if (words[0] == "move") {
+    if (words.size() != 5) return "move <name> <trigger> <base> <joints>";
+    if (words[1].size() > MOTION_PACK_NAME) return "move name longer than 12";
+    Motion_Pack_Move move = {};
+    memcpy(move.name, words[1].data(), words[1].size());
+    move.trigger = Parse_Trigger(words[2]);
+    if (!move.trigger) return "unknown or reserved trigger button";
+    int base = Find(base_names, MOTION_PACK_BASE_COUNT, words[3]);
+    if (base < 0) return "base must be rest, std, gaucho or crouch";
+    move.base = base;
+    move.mask = Parse_Mask(words[4]);
+    if (!move.mask) return "unknown joint";
+    for (const Motion_Pack_Move& m : src.moves) {
+      if (m.trigger == move.trigger) return "trigger already used";
+    }
+    move.first_key = src.keys.size();
+    src.moves.push_back(move);
+  }
+  else if (words[0] == "key") {
+    if (src.moves.empty()) return "key before any move";
+    if (words.size() < 3 || words.size() > 4) return "key <ms> <pose> [linear]";
+    Motion_Pack_Move& move = src.moves.back();
+    char* end;
+    long ms = strtol(words[1].c_str(), &end, 10);
+    if (*end != '\0' || ms < 0 || ms > 0xFFFF) return "ms out of 0..65535";
+    if (move.key_count && ms <= src.keys.back().ms) return "keys must go forward in time";
+    if (move.key_count == 255) return "more than 255 keys in a move";
+    int pose = -1;
+    for (size_t p = 0; p < src.pose_names.size(); p++) {
+      if (src.pose_names[p] == words[2]) pose = p;
+    }
+    if (pose < 0) return "unknown pose";
+    Motion_Pack_Key key = {};
+    key.ms = ms;
+    key.pose = pose;
+    if (words.size() == 4) {
+      if (words[3] != "linear") return "expected linear";
+      key.flags |= MOTION_PACK_LINEAR;
+    }
+    src.keys.push_back(key);
+    move.key_count++;
+  }
+  else return "expected pose, move or key";
+  return NULL;
+}
+
+/**
+ * @brief Print a pack that passed Motion_Pack_Check().
+*/
+void Dump(const uint8_t* data) {
+  const Motion_Pack_Header* h = (const Motion_Pack_Header*)data;
+  const Motion_Pack_Move* moves = Motion_Pack_Moves(h);
+  const Motion_Pack_Key* keys = Motion_Pack_Keys(h);
+  const Motion_Pack_Pose* poses = Motion_Pack_Poses(h);
+  printf("pack v%u, %u moves, %u keys, %u poses, %u bytes, crc %08x\n",
+    h->version, h->move_count, h->key_count, h->pose_count, h->size, h->crc);
+  for (int m = 0; m < h->move_count; m++) {
+    const Motion_Pack_Move& move = moves[m];
+    std::string trigger, joints;
+    for (int b = 0; b < BTN_COUNT; b++) {
+      if (move.trigger & (1UL << b)) trigger += (trigger.empty() ? "" : "+") + std::string(button_names[b]);
+    }
+    for (int j = 0; j < MOTION_PACK_JOINTS; j++) {
+      if (move.mask & (1 << j)) joints += (joints.empty() ? "" : ",") + std::string(joint_names[j]);
+    }
+    printf("move %.*s %s %s %s\n", MOTION_PACK_NAME, move.name, trigger.c_str(), base_names[move.base], joints.c_str());
+    for (int k = 0; k < move.key_count; k++) {
+      const Motion_Pack_Key& key = keys[move.first_key + k];
+      printf("  key %5u  pose %3u %s", key.ms, key.pose, (key.flags & MOTION_PACK_LINEAR) ? "linear" : "      ");
+      for (int j = 0; j < MOTION_PACK_JOINTS; j++) {
+        if (move.mask & (1 << j)) printf(" %s=%+d", joint_names[j], poses[key.pose].offset[j]);
+      }
+      printf("\n");
+    }
+  }
+}
+
+/**
+ * @brief Read a whole file.
+*/
+bool Read_File(const char* path, std::vector<uint8_t>& out) {
+  FILE* f = fopen(path, "rb");
+  if (f == NULL) return false;
+  int c;
+  while ((c = fgetc(f)) != EOF) out.push_back((uint8_t)c);
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (argc == 3 && strcmp(argv[1], "--dump") == 0) {
+    std::vector<uint8_t> data;
+    if (!Read_File(argv[2], data)) {
+      fprintf(stderr, "cannot open %s\n", argv[2]);
+      return 1;
+    }
+    Motion_Pack_Error err = Motion_Pack_Check(data.data(), data.size());
+    if (err != MOTION_PACK_OK) {
+      fprintf(stderr, "%s: bad pack (%s)\n", argv[2], motion_pack_errors[err]);
+      return 1;
+    }
+    Dump(data.data());
+    return 0;
+  }
+  if (argc != 3) {
+    fprintf(stderr, "usage: pack_build moves.txt pack.bin | pack_build --dump pack.bin\n");
+    return 2;
+  }
+
+  FILE* in = fopen(argv[1], "r");
+  if (in == NULL) {
+    fprintf(stderr, "cannot open %s\n", argv[1]);
+    return 1;
+  }
+  Source src;
+  char line[256];
+  int line_no = 0;
+  int errors = 0;
+  while (fgets(line, sizeof(line), in)) {
+    line_no++;
+    const char* err = Parse_Line(src, line);
+    if (err) {
+      fprintf(stderr, "%s:%d: %s\n", argv[1], line_no, err);
+      errors++;
+    }
+  }
+  fclose(in);
+  for (const Motion_Pack_Move& m : src.moves) {
+    if (m.key_count < 2) {
+      fprintf(stderr, "%s: move %.*s needs at least two keys\n", argv[1], MOTION_PACK_NAME, m.name);
+      errors++;
+    }
+  }
+  if (errors) return 1;
+
+  Motion_Pack_Header h = {};
+  h.magic = MOTION_PACK_MAGIC;
+  h.version = MOTION_PACK_VERSION;
+  h.move_count = src.moves.size();
+  h.key_count = src.keys.size();
+  h.pose_count = src.poses.size();
+  std::vector<uint8_t> body;
+  auto append = [&body](const void* p, size_t n) { body.insert(body.end(), (const uint8_t*)p, (const uint8_t*)p + n); };
+  append(src.moves.data(), src.moves.size() * sizeof(Motion_Pack_Move));
+  append(src.keys.data(), src.keys.size() * sizeof(Motion_Pack_Key));
+  append(src.poses.data(), src.poses.size() * sizeof(Motion_Pack_Pose));
+  h.size = sizeof(h) + body.size();
+  h.crc = Motion_Pack_Crc(body.data(), body.size());
+
+  std::vector<uint8_t> pack((const uint8_t*)&h, (const uint8_t*)&h + sizeof(h));
+  pack.insert(pack.end(), body.begin(), body.end());
+  if (Motion_Pack_Check(pack.data(), pack.size()) != MOTION_PACK_OK) {
+    fprintf(stderr, "internal error: built pack does not check\n");
+    return 1;
+  }
+
+  FILE* out = fopen(argv[2], "wb");
+  if (out == NULL || fwrite(pack.data(), 1, pack.size(), out) != pack.size()) {
+    fprintf(stderr, "cannot write %s\n", argv[2]);
+    return 1;
+  }
+  fclose(out);
+  fprintf(stderr, "%s: %zu moves, %zu keys, %zu poses, %zu bytes\n", argv[2],
+    src.moves.size(), src.keys.size(), src.poses.size(), pack.size());
+  return 0;
+}
@@ -0,0 +1,564 @@
+/*
+  INPUT TRACE REPLAY HARNESS
+
+  Runs the firmware natively against the shims in tools/host and
+  feeds a recorded controller trace into notify() on a virtual clock,
+  so a match replays in a fraction of real time with identical results
+  every run. The control task ticks at whatever rate the firmware
+  picks, promotions and servo frame lock included, from the moment
+  setup() returns. Every run ends with the boot phase times, so a
+  --save-rtc run followed by a --warm run shows what a warm restart
+  saves.
+
+  Build:
+    g++ -std=gnu++17 -O2 -I src -I tools/host tools/replay.cpp tools/host/host.cpp src/main.cpp -o replay
+
+  Usage:
+    replay [options] trace.csv
+      --servo FILE     write the per-packet servo trace (default stdout)
+      --timing FILE    write per-call notify() execution times
+      --golden FILE    diff the servo trace against FILE, exit 1 on mismatch
+      --packet MS      packet period used between trace rows (default 10)
+      --loop MS        loop() period on the virtual clock (default 30)
+      --adc COUNTS     battery ADC reading (default 3200)
+      --save-rtc FILE  save RTC_NOINIT memory at the end of the run
+      --warm FILE      restore RTC_NOINIT memory from FILE and boot as
+                       after a brownout, see Warm_Boot()
+      --servo-digital JOINTS
+                       run these joints (e.g. rh,lh or all) on the
+                       digital frame, reports "pwm" at the end
+      --servo-frame MS digital frame, reports "pwm" at the end
+    replay [options] --storm SECONDS
+      synthetic 1 kHz packet storm with random input, reports the
+      worst-case notify() cost
+
+  test/replay/run.sh replays the committed traces against their
+  goldens.
+
+  Trace format, one row per input change, '#' starts a comment:
+    ms,lx,ly,rx,ry,buttons
+  where buttons are the held buttons joined by '|' (e.g. r1|l2), or
+  empty. Button-down events are derived from changes between rows.
+*/
+
+#include <Arduino.h>
+#include <Ps3Controller.h>
+#include <actions.h>
+#include <buttons.h>
+#include <telemetry.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+void notify();
+void Control_Tick();
+uint32_t Control_Period();
+TickType_t Servo_Frame_Lock(TickType_t target, TickType_t period);
+extern int16_t joint_out[9];
+extern enum Action action;
+extern volatile uint32_t boot_us[];
+extern const char* boot_phase_names[];
+
+struct Trace_Row {
+  unsigned long ms;
+  int8_t sticks[4];
+  uint32_t buttons;
+};
+
+struct Options {
+  const char* trace = NULL;
+  const char* servo = NULL;
+  const char* timing = NULL;
+  const char* golden = NULL;
+  unsigned long packet_ms = 10;
+  unsigned long loop_ms = 30;
+  int adc = 3200;
+  const char* save_rtc = NULL;
+  const char* warm = NULL;
+  // Joints on the digital frame, bit per joint
+  uint16_t servo_digital = 0;
+  int servo_frame = 0;
+  double storm_s = 0;
+};
+
+/**
+ * @brief Unpack BTN_* bits into a PS3 button struct.
+*/
+ps3_button_t Unpack_Buttons(uint32_t bits) {
+  ps3_button_t b = {};
+  b.select = !!(bits & BTN_SELECT);
+  b.l3 = !!(bits & BTN_L3);
+  b.r3 = !!(bits & BTN_R3);
+  b.start = !!(bits & BTN_START);
+  b.up = !!(bits & BTN_UP);
+  b.right = !!(bits & BTN_RIGHT);
+  b.down = !!(bits & BTN_DOWN);
+  b.left = !!(bits & BTN_LEFT);
+  b.l2 = !!(bits & BTN_L2);
+  b.r2 = !!(bits & BTN_R2);
+  b.l1 = !!(bits & BTN_L1);
+  b.r1 = !!(bits & BTN_R1);
+  b.triangle = !!(bits & BTN_TRIANGLE);
+  b.circle = !!(bits & BTN_CIRCLE);
+  b.cross = !!(bits & BTN_CROSS);
+  b.square = !!(bits & BTN_SQUARE);
+  b.ps = !!(bits & BTN_PS);
+  return b;
+}
+
+/**
+ * @brief Parse a '|' separated list of button names.
+ *
+ * @return packed BTN_* bits, or -1 if a name is unknown.
+*/
+long Parse_Buttons(const std::string& field) {
+  uint32_t bits = 0;
+  size_t start = 0;
+  while (start < field.size()) {
+    size_t end = field.find('|', start);
+    if (end == std::string::npos) end = field.size();
+    std::string name = field.substr(start, end - start);
+    bool found = name.empty();
+    for (int i = 0; i < BTN_COUNT && !found; i++) {
+      if (name == button_names[i]) {
+        bits |= 1UL << i;
+        found = true;
+      }
+    }
+    if (!found) return -1;
+    start = end + 1;
+  }
+  return bits;
+}
+
+/**
+ * @brief Load a trace file.
+ *
+ * @return false if the file cannot be read or a row is malformed.
+*/
+bool Load_Trace(const char* path, std::vector<Trace_Row>& rows) {
+  FILE* f = fopen(path, "r");
+  if (f == NULL) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return false;
+  }
+  char line[256];
+  int line_no = 0;
+  while (fgets(line, sizeof(line), f)) {
+    line_no++;
+    char* hash = strchr(line, '#');
+    if (hash) *hash = 0;
+    line[strcspn(line, "\r\n")] = 0;
+    if (strspn(line, " \t") == strlen(line)) continue;
+
+    Trace_Row row;
+    int lx, ly, rx, ry, consumed = 0;
+    if (sscanf(line, "%lu,%d,%d,%d,%d%n", &row.ms, &lx, &ly, &rx, &ry, &consumed) != 5) {
+      fprintf(stderr, "%s:%d: expected ms,lx,ly,rx,ry,buttons\n", path, line_no);
+      fclose(f);
+      return false;
+    }
+    std::string rest = line + consumed;
+    if (!rest.empty() && rest[0] == ',') rest.erase(0, 1);
+    long bits = Parse_Buttons(rest);
+    if (bits < 0) {
+      fprintf(stderr, "%s:%d: unknown button in '%s'\n", path, line_no, rest.c_str());
+      fclose(f);
+      return false;
+    }
+    row.sticks[0] = constrain(lx, -128, 127);
+    row.sticks[1] = constrain(ly, -128, 127);
+    row.sticks[2] = constrain(rx, -128, 127);
+    row.sticks[3] = constrain(ry, -128, 127);
+    row.buttons = bits;
+    if (!rows.empty() && row.ms < rows.back().ms) {
+      fprintf(stderr, "%s:%d: timestamps must not decrease\n", path, line_no);
+      fclose(f);
+      return false;
+    }
+    rows.push_back(row);
+  }
+  fclose(f);
+  return true;
+}
+
+unsigned long next_loop_ms = 0;
+unsigned long next_tick_ms = 0;
+
+/**
+ * @brief Advance the virtual clock.
+ * 
+ * Runs loop() and the control task's tick on their own periods,
+ * in time order, up to and including ms.
+*/
+void Advance_To(unsigned long ms, const Options& opt) {
+  // A promotion in the last packet wakes the control task at once
+  if (Control_Period() == 0) next_tick_ms = min(next_tick_ms, (unsigned long)(host_time_us / 1000));
+  while (next_loop_ms <= ms || next_tick_ms <= ms) {
+    if (next_tick_ms <= next_loop_ms) {
+      host_time_us = (uint64_t)next_tick_ms * 1000;
+      Control_Tick();
+      unsigned long period = Control_Period();
+      next_tick_ms += period + Servo_Frame_Lock(next_tick_ms + period, period);
+    }
+    else {
+      host_time_us = (uint64_t)next_loop_ms * 1000;
+      loop();
+      next_loop_ms += opt.loop_ms;
+    }
+  }
+  host_time_us = (uint64_t)ms * 1000;
+}
+
+/**
+ * @brief Deliver one controller packet and time the callback.
+ *
+ * @return wall-clock nanoseconds spent in notify().
+*/
+long long Send_Packet(const int8_t* sticks, uint32_t held, uint32_t prev_held) {
+  Ps3.data.analog.stick.lx = sticks[0];
+  Ps3.data.analog.stick.ly = sticks[1];
+  Ps3.data.analog.stick.rx = sticks[2];
+  Ps3.data.analog.stick.ry = sticks[3];
+  Ps3.data.button = Unpack_Buttons(held);
+  Ps3.event.button_down = Unpack_Buttons(held & ~prev_held);
+  Ps3.event.button_up = Unpack_Buttons(prev_held & ~held);
+
+  auto start = std::chrono::steady_clock::now();
+  notify();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+/**
+ * @brief Copy RTC_NOINIT memory to or from a file.
+ *
+ * @return false if the file cannot be opened or is the wrong size.
+*/
+bool Transfer_Rtc(const char* path, bool save) {
+  size_t size;
+  uint8_t* rtc = host_rtc_noinit(&size);
+  FILE* f = fopen(path, save ? "wb" : "rb");
+  if (f == NULL) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return false;
+  }
+  size_t n = save ? fwrite(rtc, 1, size, f) : fread(rtc, 1, size, f);
+  fclose(f);
+  if (n != size) fprintf(stderr, "%s: expected %zu bytes of RTC memory\n", path, size);
+  return n == size;
+}
+
+/**
+ * @brief Index of a boot phase by name, -1 if there is none.
+*/
+int Boot_Phase_Index(const char* name) {
+  // "connect" is the last phase
+  for (int p = 0; ; p++) {
+    if (strcmp(boot_phase_names[p], name) == 0) return p;
+    if (strcmp(boot_phase_names[p], "connect") == 0) return -1;
+  }
+}
+
+/**
+ * @brief Print when the control task first ticked and when the
+ * servos held a pose, in virtual microseconds since reset.
+ *
+ * The virtual clock charges nothing for setup() itself, so the
+ * difference between a cold and a warm boot is soft start. Servos
+ * at 0 have not finished soft start by the end of the run.
+*/
+void Report_Boot(const Options& opt) {
+  int control = Boot_Phase_Index("control");
+  int servos = Boot_Phase_Index("servos");
+  if (control < 0 || servos < 0) return;
+  // A warm boot has the servos holding the checkpointed pose before
+  // the first tick
+  bool warm = boot_us[servos] && boot_us[servos] <= boot_us[control];
+  fprintf(stderr, "boot %s %s: control at %u us, servos at %u us\n", opt.warm ? "brownout" : "poweron",
+    warm ? "warm" : "cold", boot_us[control], boot_us[servos]);
+}
+
+static const char* const joint_names[9] = { "rs", "rb", "ls", "lb", "w", "rh", "rf", "lh", "lf" };
+
+/**
+ * @brief Parse a ',' separated list of joint names, or "all".
+ *
+ * @return bit per joint, or -1 if a name is unknown.
+*/
+long Parse_Joints(const std::string& field) {
+  if (field == "all") return 0x1FF;
+  long bits = 0;
+  size_t start = 0;
+  while (start < field.size()) {
+    size_t end = field.find(',', start);
+    if (end == std::string::npos) end = field.size();
+    std::string name = field.substr(start, end - start);
+    int i = 0;
+    while (i < 9 && name != joint_names[i]) i++;
+    if (i == 9) return -1;
+    bits |= 1L << i;
+    start = end + 1;
+  }
+  return bits;
+}
+
+/**
+ * @brief Run one console command and print its replies to stderr.
+*/
+void Console(const char* command) {
+  FILE* out = tmpfile();
+  if (out == NULL) return;
+  host_serial_output = out;
+  host_serial_input(command);
+  host_serial_input("\n");
+  loop();
+  host_serial_output = NULL;
+
+  rewind(out);
+  std::vector<uint8_t> enc;
+  int c;
+  while ((c = fgetc(out)) != EOF) {
+    if (c != 0) {
+      enc.push_back((uint8_t)c);
+      continue;
+    }
+    uint8_t raw[TELEMETRY_MAX_FRAME];
+    size_t n = Cobs_Decode(enc.data(), enc.size(), raw, sizeof(raw));
+    if (n >= 3 && raw[0] == TELEMETRY_TEXT && Telemetry_Checksum(raw, n) == 0) {
+      fprintf(stderr, "> %.*s\n", (int)(n - 3), (const char*)raw + 2);
+    }
+    enc.clear();
+  }
+  fclose(out);
+}
+
+/**
+ * @brief Boot the firmware, prime the battery filter and connect the pad.
+*/
+bool Boot(const Options& opt) {
+  for (int i = 0; i < 40; i++) host_adc[i] = opt.adc;
+  host_time_us = 0;
+  if (opt.warm) {
+    if (!Transfer_Rtc(opt.warm, false)) return false;
+    host_reset_reason = ESP_RST_BROWNOUT;
+  }
+  setup();
+  // Servo options go in before the first tick, as if stored
+  if (opt.servo_frame) {
+    char line[32];
+    snprintf(line, sizeof(line), "set servo_frame %d", opt.servo_frame);
+    Console(line);
+  }
+  for (int i = 0; i < 9; i++) {
+    if (!(opt.servo_digital & (1 << i))) continue;
+    char line[32];
+    snprintf(line, sizeof(line), "set servo_digital[%d] 1", i);
+    Console(line);
+  }
+  // The control task starts ticking as soon as setup() creates it
+  next_tick_ms = host_time_us / 1000;
+  next_loop_ms = next_tick_ms;
+  Advance_To(next_tick_ms, opt);
+  Ps3.connected = true;
+  if (Ps3.on_connect) Ps3.on_connect();
+  // Fill the battery filter so the first packets do not see an empty pack
+  for (int i = 0; i < 100; i++) loop();
+  return true;
+}
+
+/**
+ * @brief Print mean, percentiles and max of a set of call times.
+*/
+void Report_Timing(const char* label, std::vector<long long> ns) {
+  if (ns.empty()) return;
+  long long sum = 0;
+  for (long long v : ns) sum += v;
+  std::sort(ns.begin(), ns.end());
+  fprintf(stderr, "%s: %zu calls, mean %lld ns, p50 %lld ns, p99 %lld ns, max %lld ns\n",
+    label, ns.size(), sum / (long long)ns.size(), ns[ns.size() / 2], ns[ns.size() * 99 / 100], ns.back());
+}
+
+/**
+ * @brief Compare the produced servo trace with a golden file.
+ *
+ * @return number of differing lines.
+*/
+int Diff_Golden(const std::vector<std::string>& lines, const char* path) {
+  FILE* f = fopen(path, "r");
+  if (f == NULL) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return 1;
+  }
+  std::vector<std::string> golden;
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    line[strcspn(line, "\r\n")] = 0;
+    golden.push_back(line);
+  }
+  fclose(f);
+
+  int diffs = 0;
+  size_t n = max(lines.size(), golden.size());
+  for (size_t i = 0; i < n; i++) {
+    const char* got = i < lines.size() ? lines[i].c_str() : "<missing>";
+    const char* want = i < golden.size() ? golden[i].c_str() : "<missing>";
+    if (strcmp(got, want) == 0) continue;
+    if (diffs < 10) fprintf(stderr, "line %zu:\n  golden: %s\n  actual: %s\n", i + 1, want, got);
+    diffs++;
+  }
+  if (diffs) fprintf(stderr, "%d lines differ from %s\n", diffs, path);
+  else fprintf(stderr, "servo trace matches %s\n", path);
+  return diffs;
+}
+
+/**
+ * @brief Replay a trace file.
+*/
+int Replay(const Options& opt) {
+  std::vector<Trace_Row> rows;
+  if (!Load_Trace(opt.trace, rows)) return 2;
+  if (rows.empty()) {
+    fprintf(stderr, "%s: empty trace\n", opt.trace);
+    return 2;
+  }
+
+  if (!Boot(opt)) return 2;
+
+  std::vector<std::string> lines;
+  std::vector<long long> times;
+  lines.push_back("ms,rs,rb,ls,lb,w,rh,rf,lh,lf,action");
+
+  FILE* timing = NULL;
+  if (opt.timing) {
+    timing = fopen(opt.timing, "w");
+    if (timing) fprintf(timing, "ms,notify_ns\n");
+  }
+
+  // Packets arrive on the packet period and at every trace row
+  uint32_t held = 0;
+  size_t next_row = 0;
+  unsigned long t = rows[0].ms;
+  const Trace_Row* current = &rows[0];
+  while (next_row < rows.size() || t <= rows.back().ms + opt.packet_ms) {
+    unsigned long row_ms = next_row < rows.size() ? rows[next_row].ms : (unsigned long)-1;
+    unsigned long packet_ms = min(t, row_ms);
+    if (packet_ms == row_ms) current = &rows[next_row++];
+    if (packet_ms == t) t += opt.packet_ms;
+
+    // Settle every row landing on the same millisecond before sending
+    while (next_row < rows.size() && rows[next_row].ms == packet_ms) current = &rows[next_row++];
+
+    Advance_To(packet_ms, opt);
+    long long ns = Send_Packet(current->sticks, current->buttons, held);
+    held = current->buttons;
+    times.push_back(ns);
+
+    char line[128];
+    int n = snprintf(line, sizeof(line), "%lu", packet_ms);
+    for (int i = 0; i < 9; i++) n += snprintf(line + n, sizeof(line) - n, ",%d", joint_out[i]);
+    snprintf(line + n, sizeof(line) - n, ",%s", action_names[action]);
+    lines.push_back(line);
+    if (timing) fprintf(timing, "%lu,%lld\n", packet_ms, ns);
+  }
+  if (timing) fclose(timing);
+
+  FILE* out = opt.servo ? fopen(opt.servo, "w") : stdout;
+  if (out == NULL) {
+    fprintf(stderr, "cannot open %s\n", opt.servo);
+    return 2;
+  }
+  for (const std::string& l : lines) fprintf(out, "%s\n", l.c_str());
+  if (out != stdout) fclose(out);
+
+  Report_Timing("notify", times);
+  Report_Boot(opt);
+  if (opt.servo_digital || opt.servo_frame) Console("pwm");
+  if (opt.save_rtc && !Transfer_Rtc(opt.save_rtc, true)) return 2;
+  if (opt.golden) return Diff_Golden(lines, opt.golden) ? 1 : 0;
+  return 0;
+}
+
+/**
+ * @brief Drive notify() with a synthetic 1 kHz packet storm.
+ *
+ * Inputs come from a fixed-seed generator so storms are repeatable.
+ * Every packet flips a few buttons and moves the sticks, which keeps
+ * edge-triggered paths (taunt and recovery restarts) busy.
+*/
+int Storm(const Options& opt) {
+  if (!Boot(opt)) return 2;
+
+  uint32_t seed = 0x2C81583A;
+  auto next = [&seed]() {
+    seed = seed * 1664525 + 1013904223;
+    return seed >> 8;
+  };
+
+  std::vector<long long> times;
+  uint32_t held = 0;
+  uint32_t worst_buttons = 0;
+  long long worst = -1;
+  unsigned long packets = opt.storm_s * 1000;
+  for (unsigned long i = 0; i < packets; i++) {
+    uint32_t buttons = held ^ (1UL << (next() % BTN_COUNT));
+    if (next() % 4 == 0) buttons = 0;
+    // Keep the recorder and playback toggles out of the storm
+    buttons &= ~(BTN_PS | BTN_TRIANGLE);
+    int8_t sticks[4];
+    for (int j = 0; j < 4; j++) sticks[j] = (int8_t)(next() & 0xFF);
+
+    Advance_To(i, opt);
+    long long ns = Send_Packet(sticks, buttons, held);
+    held = buttons;
+    times.push_back(ns);
+    if (ns > worst) {
+      worst = ns;
+      worst_buttons = buttons;
+    }
+  }
+
+  Report_Timing("storm", times);
+  fprintf(stderr, "worst packet held:");
+  for (int i = 0; i < BTN_COUNT; i++) if (worst_buttons & (1UL << i)) fprintf(stderr, " %s", button_names[i]);
+  fprintf(stderr, "\n");
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--servo" && has_value) opt.servo = argv[++i];
+    else if (arg == "--timing" && has_value) opt.timing = argv[++i];
+    else if (arg == "--golden" && has_value) opt.golden = argv[++i];
+    else if (arg == "--packet" && has_value) opt.packet_ms = max(1L, atol(argv[++i]));
+    else if (arg == "--loop" && has_value) opt.loop_ms = max(1L, atol(argv[++i]));
+    else if (arg == "--adc" && has_value) opt.adc = atoi(argv[++i]);
+    else if (arg == "--save-rtc" && has_value) opt.save_rtc = argv[++i];
+    else if (arg == "--warm" && has_value) opt.warm = argv[++i];
+    else if (arg == "--servo-digital" && has_value) {
+      long bits = Parse_Joints(argv[++i]);
+      if (bits < 0) {
+        fprintf(stderr, "unknown joint in '%s'\n", argv[i]);
+        return 2;
+      }
+      opt.servo_digital = bits;
+    }
+    else if (arg == "--servo-frame" && has_value) opt.servo_frame = atoi(argv[++i]);
+    else if (arg == "--storm" && has_value) opt.storm_s = atof(argv[++i]);
+    else if (arg[0] != '-' && opt.trace == NULL) opt.trace = argv[i];
+    else {
+      fprintf(stderr, "unknown argument %s\n", arg.c_str());
+      return 2;
+    }
+  }
+
+  if (opt.storm_s > 0) return Storm(opt);
+  if (opt.trace == NULL) {
+    fprintf(stderr, "usage: replay [options] trace.csv | replay --storm SECONDS\n");
+    return 2;
+  }
+  return Replay(opt);
+}
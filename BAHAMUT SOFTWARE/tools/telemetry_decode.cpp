@@ -0,0 +1,212 @@
+/*
+  TELEMETRY DECODER
+
+  Host-side tool that turns a raw serial capture of the telemetry
+  stream into CSV for offline analysis.
+
+  Build:
+    g++ -std=c++17 -O2 -I src tools/telemetry_decode.cpp -o telemetry_decode
+
+  Usage:
+    telemetry_decode [--profile profile.csv] [--baseline iram.csv] [capture.bin] > match.csv
+
+  Reads stdin when no file is given. Tick frames go to stdout.
+  Control path profile frames go to the --profile file, or are
+  summarised on stderr. Flash cache stalls are only reported
+  against --baseline, the --profile output of a CONTROL_IN_IRAM
+  build put through the same drill: the stall is the mean cost
+  above the baseline's, per display state, so the work itself
+  cancels out. Console replies are printed to stderr prefixed
+  with "> ". Trace dumps are only counted, see
+  tools/trace_export.cpp. Frames that fail COBS decoding, have the
+  wrong size or fail the checksum are skipped and counted.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <actions.h>
+#include <telemetry.h>
+#include <trace.h>
+
+static const char* joint_names[TELEMETRY_JOINTS] = { "rs", "rb", "ls", "lb", "w", "rh", "rf", "lh", "lf" };
+
+FILE* profile_out = NULL;
+bool have_baseline = false;
+// Mean cycles per profile class of the IRAM-resident baseline
+double baseline_cycles[2];
+unsigned long frames_ok = 0;
+unsigned long frames_bad = 0;
+unsigned long frames_lost = 0;
+unsigned long frames_trace = 0;
+bool have_seq = false;
+uint16_t last_seq = 0;
+
+/**
+ * @brief Print a tick frame as a CSV row.
+*/
+void Print_Tick(const Telemetry_Frame& frame) {
+  if (have_seq) frames_lost += (uint16_t)(frame.seq - last_seq - 1);
+  have_seq = true;
+  last_seq = frame.seq;
+
+  printf("%u,%u", frame.seq, frame.ms);
+  for (int i = 0; i < TELEMETRY_JOINTS; i++) printf(",%d", frame.joints[i]);
+  printf(",%s,%u,%d,%d,%u,%u,%u\n",
+    frame.action < ACT_COUNT ? action_names[frame.action] : "?",
+    frame.led_state,
+    (frame.flags & TELEMETRY_CROUCHED) ? 1 : 0,
+    (frame.flags & TELEMETRY_CONNECTED) ? 1 : 0,
+    frame.battery_avg, frame.loop_us, frame.notify_us);
+}
+
+/**
+ * @brief Load the mean cost per display state from a --profile CSV.
+ * 
+ * Windows are weighted by their sample counts.
+*/
+bool Load_Baseline(const char* path) {
+  FILE* f = fopen(path, "r");
+  if (f == NULL) return false;
+  char line[256];
+  double cycles[2] = { 0, 0 };
+  double samples[2] = { 0, 0 };
+  unsigned iram = 1;
+  // Skip the header
+  if (fgets(line, sizeof(line), f) == NULL) {
+    fclose(f);
+    return false;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    unsigned ms, on, n[2], mean[2], max[2];
+    if (sscanf(line, "%u,%u,%u,%u,%u,%*[^,],%u,%u,%u", &ms, &on, &n[0], &mean[0], &max[0], &n[1], &mean[1], &max[1]) != 8) continue;
+    iram &= on;
+    for (int c = 0; c < 2; c++) {
+      cycles[c] += (double)mean[c] * n[c];
+      samples[c] += n[c];
+    }
+  }
+  fclose(f);
+  if (!iram) fprintf(stderr, "warning: %s has profile windows from a flash control build\n", path);
+  for (int c = 0; c < 2; c++) baseline_cycles[c] = samples[c] ? cycles[c] / samples[c] : 0;
+  return samples[PROFILE_DISPLAY_IDLE] + samples[PROFILE_DISPLAY_BUSY] > 0;
+}
+
+/**
+ * @brief Print a control path profile frame.
+ * 
+ * Stall is the mean cost above the --baseline's, per display
+ * state, and is left out without one.
+*/
+void Print_Profile(const Profile_Frame& frame) {
+  char stall[2][16];
+  for (int c = 0; c < 2; c++) {
+    if (have_baseline && frame.samples[c]) snprintf(stall[c], sizeof(stall[c]), "%ld", lround(frame.mean_cycles[c] - baseline_cycles[c]));
+    else snprintf(stall[c], sizeof(stall[c]), "-");
+  }
+
+  if (profile_out != NULL) {
+    fprintf(profile_out, "%u,%u,%u,%u,%u,%s,%u,%u,%u,%s\n", frame.ms, frame.iram,
+      frame.samples[PROFILE_DISPLAY_IDLE], frame.mean_cycles[PROFILE_DISPLAY_IDLE], frame.max_cycles[PROFILE_DISPLAY_IDLE], stall[PROFILE_DISPLAY_IDLE],
+      frame.samples[PROFILE_DISPLAY_BUSY], frame.mean_cycles[PROFILE_DISPLAY_BUSY], frame.max_cycles[PROFILE_DISPLAY_BUSY], stall[PROFILE_DISPLAY_BUSY]);
+    return;
+  }
+  fprintf(stderr, "profile %u ms (%s): display idle mean %u stall %s (max %u), display busy mean %u stall %s (max %u)\n",
+    frame.ms, frame.iram ? "iram" : "flash",
+    frame.mean_cycles[PROFILE_DISPLAY_IDLE], stall[PROFILE_DISPLAY_IDLE], frame.max_cycles[PROFILE_DISPLAY_IDLE],
+    frame.mean_cycles[PROFILE_DISPLAY_BUSY], stall[PROFILE_DISPLAY_BUSY], frame.max_cycles[PROFILE_DISPLAY_BUSY]);
+}
+
+/**
+ * @brief Decode one COBS frame and dispatch it by type.
+ * 
+ * @param enc encoded bytes, delimiter excluded.
+ * @param len number of encoded bytes.
+*/
+void Decode_Frame(const uint8_t* enc, size_t len) {
+  uint8_t raw[TELEMETRY_MAX_ENCODED];
+  size_t n = Cobs_Decode(enc, len, raw, sizeof(raw));
+  if (n < 2 || Telemetry_Checksum(raw, n) != 0 || raw[1] != TELEMETRY_VERSION) {
+    frames_bad++;
+    return;
+  }
+
+  if (raw[0] == TELEMETRY_TICK && n == sizeof(Telemetry_Frame)) {
+    Telemetry_Frame frame;
+    memcpy(&frame, raw, sizeof(frame));
+    Print_Tick(frame);
+  }
+  else if (raw[0] == TELEMETRY_PROFILE && n == sizeof(Profile_Frame)) {
+    Profile_Frame frame;
+    memcpy(&frame, raw, sizeof(frame));
+    Print_Profile(frame);
+  }
+  else if (raw[0] == TELEMETRY_TEXT && n - 3 <= TELEMETRY_TEXT_MAX) {
+    fprintf(stderr, "> %.*s\n", (int)(n - 3), (const char*)raw + 2);
+  }
+  else if (raw[0] == TELEMETRY_TRACE && n > TRACE_FRAME_HEADER && n <= sizeof(Trace_Frame)) {
+    frames_trace++;
+  }
+  else {
+    frames_bad++;
+    return;
+  }
+  frames_ok++;
+}
+
+int main(int argc, char** argv) {
+  FILE* in = stdin;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+      profile_out = fopen(argv[++i], "w");
+      if (profile_out == NULL) {
+        fprintf(stderr, "cannot open %s\n", argv[i]);
+        return 1;
+      }
+      fprintf(profile_out, "ms,iram,idle_samples,idle_mean,idle_max,idle_stall,busy_samples,busy_mean,busy_max,busy_stall\n");
+    }
+    else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc) {
+      have_baseline = Load_Baseline(argv[++i]);
+      if (!have_baseline) {
+        fprintf(stderr, "cannot read a profile from %s\n", argv[i]);
+        return 1;
+      }
+    }
+    else {
+      in = fopen(argv[i], "rb");
+      if (in == NULL) {
+        fprintf(stderr, "cannot open %s\n", argv[i]);
+        return 1;
+      }
+    }
+  }
+
+  printf("seq,ms");
+  for (int i = 0; i < TELEMETRY_JOINTS; i++) printf(",%s", joint_names[i]);
+  printf(",action,led_state,crouched,connected,battery,loop_us,notify_us\n");
+
+  // Bytes seen before the first delimiter may be a partial frame
+  bool synced = false;
+  std::vector<uint8_t> frame;
+  int c;
+  while ((c = fgetc(in)) != EOF) {
+    if (c != 0) {
+      if (frame.size() < TELEMETRY_MAX_ENCODED) frame.push_back((uint8_t)c);
+      else {
+        frame.clear();
+        synced = false;
+      }
+      continue;
+    }
+    if (synced && !frame.empty()) Decode_Frame(frame.data(), frame.size());
+    synced = true;
+    frame.clear();
+  }
+
+  if (in != stdin) fclose(in);
+  if (profile_out != NULL) fclose(profile_out);
+  fprintf(stderr, "%lu frames, %lu bad, %lu lost\n", frames_ok, frames_bad, frames_lost);
+  if (frames_trace) fprintf(stderr, "%lu trace frames, convert with trace_export\n", frames_trace);
+  return 0;
+}
@@ -0,0 +1,220 @@
+/*
+  TRACE EXPORT
+
+  Host-side tool that turns a raw serial capture holding a trace
+  dump ("trace start", then "trace dump" on the console) into
+  Chrome trace JSON, which chrome://tracing and ui.perfetto.dev
+  both open. Each core is one track, so notify() on the Bluetooth
+  core can be seen side by side with loop() and the display flush
+  on the other.
+
+  Build:
+    g++ -std=c++17 -O2 -I src tools/trace_export.cpp -o trace_export
+
+  Usage:
+    trace_export [--out trace.json] [capture.bin]
+
+  Reads stdin when no file is given and writes JSON to stdout
+  unless --out is given. Cycle stamps are put on a common clock
+  through the sync pair each frame carries. Begin and end events
+  are paired per core and event id into complete slices; an end
+  whose begin was overwritten is dropped, a begin left open runs
+  to the core's last event. A summary of each event id per core
+  goes to stderr, with how many notify() calls overlapped a
+  display flush on the other core.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include <trace.h>
+
+struct Stamped {
+  double us;
+  Trace_Event event;
+};
+
+struct Slice {
+  int core;
+  int id;
+  double start;
+  double end;
+  uint16_t arg;
+  bool open;
+};
+
+struct Id_Stats {
+  unsigned long count;
+  double total;
+  double max;
+};
+
+std::vector<Stamped> cores[2];
+unsigned long frames_ok = 0;
+unsigned long frames_bad = 0;
+
+/**
+ * @brief Decode one COBS frame, keeping trace events and echoing replies.
+*/
+void Decode_Frame(const uint8_t* enc, size_t len) {
+  uint8_t raw[TELEMETRY_MAX_ENCODED];
+  size_t n = Cobs_Decode(enc, len, raw, sizeof(raw));
+  if (n < 2 || Telemetry_Checksum(raw, n) != 0 || raw[1] != TELEMETRY_VERSION) {
+    frames_bad++;
+    return;
+  }
+  if (raw[0] == TELEMETRY_TEXT && n - 3 <= TELEMETRY_TEXT_MAX) {
+    fprintf(stderr, "> %.*s\n", (int)(n - 3), (const char*)raw + 2);
+    return;
+  }
+  if (raw[0] != TELEMETRY_TRACE) return;
+
+  Trace_Frame frame;
+  if (n < TRACE_FRAME_HEADER + 1) {
+    frames_bad++;
+    return;
+  }
+  memcpy(&frame, raw, TRACE_FRAME_HEADER);
+  if (frame.core > 1 || frame.count > TRACE_FRAME_EVENTS || frame.mhz == 0 ||
+      n != TRACE_FRAME_HEADER + frame.count * sizeof(Trace_Event) + 1) {
+    frames_bad++;
+    return;
+  }
+  memcpy(frame.events, raw + TRACE_FRAME_HEADER, frame.count * sizeof(Trace_Event));
+
+  for (int i = 0; i < frame.count; i++) {
+    Stamped s;
+    s.event = frame.events[i];
+    s.us = frame.sync_us + (double)(int32_t)(s.event.cycles - frame.sync_cycles) / frame.mhz;
+    cores[frame.core].push_back(s);
+  }
+  frames_ok++;
+}
+
+/**
+ * @brief Pair one core's begin and end events into slices.
+*/
+void Build_Slices(int core, std::vector<Slice>& slices, std::vector<Slice>& instants, unsigned long& orphans) {
+  std::vector<Stamped>& events = cores[core];
+  std::stable_sort(events.begin(), events.end(), [](const Stamped& a, const Stamped& b) { return a.us < b.us; });
+  if (events.empty()) return;
+
+  std::vector<double> open[TRACE_ID_COUNT];
+  for (const Stamped& s : events) {
+    int id = s.event.id;
+    if (id >= TRACE_ID_COUNT) continue;
+    if (s.event.kind == TRACE_BEGIN) open[id].push_back(s.us);
+    else if (s.event.kind == TRACE_END) {
+      if (open[id].empty()) {
+        orphans++;
+        continue;
+      }
+      slices.push_back({ core, id, open[id].back(), s.us, 0, false });
+      open[id].pop_back();
+    }
+    else instants.push_back({ core, id, s.us, s.us, s.event.arg, false });
+  }
+
+  double last = events.back().us;
+  for (int id = 0; id < TRACE_ID_COUNT; id++) {
+    for (double start : open[id]) slices.push_back({ core, id, start, last, 0, true });
+  }
+}
+
+int main(int argc, char** argv) {
+  FILE* in = stdin;
+  FILE* out = stdout;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+      out = fopen(argv[++i], "w");
+      if (out == NULL) {
+        fprintf(stderr, "cannot open %s\n", argv[i]);
+        return 1;
+      }
+    }
+    else {
+      in = fopen(argv[i], "rb");
+      if (in == NULL) {
+        fprintf(stderr, "cannot open %s\n", argv[i]);
+        return 1;
+      }
+    }
+  }
+
+  bool synced = false;
+  std::vector<uint8_t> frame;
+  int c;
+  while ((c = fgetc(in)) != EOF) {
+    if (c != 0) {
+      if (frame.size() < TELEMETRY_MAX_ENCODED) frame.push_back((uint8_t)c);
+      else {
+        frame.clear();
+        synced = false;
+      }
+      continue;
+    }
+    if (synced && !frame.empty()) Decode_Frame(frame.data(), frame.size());
+    synced = true;
+    frame.clear();
+  }
+  if (in != stdin) fclose(in);
+
+  std::vector<Slice> slices, instants;
+  unsigned long orphans = 0;
+  for (int core = 0; core < 2; core++) Build_Slices(core, slices, instants, orphans);
+
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+  fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"BAHAMUT\"}},\n");
+  fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"core 0 (Bluetooth, recorder)\"}},\n");
+  fprintf(out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"core 1 (loop, control)\"}}");
+  for (const Slice& s : slices) {
+    fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f%s}",
+      trace_names[s.id], s.core, s.start, s.end - s.start, s.open ? ",\"args\":{\"unfinished\":true}" : "");
+  }
+  for (const Slice& s : instants) {
+    fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"arg\":%u}}",
+      trace_names[s.id], s.core, s.start, s.arg);
+  }
+  fprintf(out, "\n]}\n");
+  if (out != stdout) fclose(out);
+
+  // Summary per core and event id
+  Id_Stats stats[2][TRACE_ID_COUNT] = {};
+  for (const Slice& s : slices) {
+    Id_Stats& st = stats[s.core][s.id];
+    double d = s.end - s.start;
+    st.count++;
+    st.total += d;
+    if (d > st.max) st.max = d;
+  }
+  for (const Slice& s : instants) stats[s.core][s.id].count++;
+  for (int core = 0; core < 2; core++) {
+    if (cores[core].empty()) continue;
+    fprintf(stderr, "core %d: %zu events over %.1f ms\n", core, cores[core].size(),
+      (cores[core].back().us - cores[core].front().us) / 1000);
+    for (int id = 0; id < TRACE_ID_COUNT; id++) {
+      const Id_Stats& st = stats[core][id];
+      if (!st.count) continue;
+      if (st.total > 0) fprintf(stderr, "  %-13s %5lu  mean %8.1f us  max %8.1f us\n", trace_names[id],
+        st.count, st.total / st.count, st.max);
+      else fprintf(stderr, "  %-13s %5lu\n", trace_names[id], st.count);
+    }
+  }
+
+  // notify() calls that ran while the other core was flushing the display
+  unsigned long notifies = 0, overlapped = 0;
+  for (const Slice& n : slices) {
+    if (n.id != TRACE_NOTIFY) continue;
+    notifies++;
+    for (const Slice& d : slices) {
+      if (d.id == TRACE_DISPLAY && d.core != n.core && d.start < n.end && n.start < d.end) {
+        overlapped++;
+        break;
+      }
+    }
+  }
+  fprintf(stderr, "notify during display flush on the other core: %lu of %lu\n", overlapped, notifies);
+  fprintf(stderr, "%lu trace frames, %lu bad, %lu unmatched ends\n", frames_ok, frames_bad, orphans);
+  return 0;
+}